@@ -3,213 +3,228 @@
 #include <iostream>
 #include <string>
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <functional>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <deque>
 #include <map>
-#include <regex>
+#include <mutex>
+#include <shared_mutex>
 #include <thread>
 #include <vector>
 
 #include "vendor/include/noise/noise.h"
 #include "vendor/include/noise/noiseutils.h"
+
+// Builds with -DNOISELANG_HEADLESS leave out the viewer, and with it every use of SDL
+#ifndef NOISELANG_HEADLESS
 #include "vendor/include/SDL2/SDL.h"
+#endif
+
+#include "NoiseLangBlock.hpp"
+#include "NoiseLangCodegen.hpp"
+#include "NoiseLangExport.hpp"
+#include "NoiseLangFrameStats.hpp"
+#include "NoiseLangPalette.hpp"
+#include "NoiseLangParser.hpp"
+#include "NoiseLangProfile.hpp"
+#include "NoiseLangProgram.hpp"
+#include "NoiseLangRegistry.hpp"
+#include "NoiseLangTileCache.hpp"
+#include "NoiseLangView.hpp"
+#include "NoiseLangWorkers.hpp"
 
 namespace NoiseLang {
 
 	int Ok = 0;
 	int Error = 1;
 
-	class ImageColor {
-		public:
-			Uint8 r, g, b, a;
-			ImageColor(Uint8 r, Uint8 g, Uint8 b, Uint8 a){
-				this->r = r;
-				this->g = g;
-				this->b = b;
-				this->a = a;
-			}
-			ImageColor(int r, int g, int b, int a){
-				this->r = static_cast<Uint8>(r);
-				this->g = static_cast<Uint8>(g);
-				this->b = static_cast<Uint8>(b);
-				this->a = static_cast<Uint8>(a);
-			}
-			ImageColor(double r, double g, double b, double a){
-				this->r = static_cast<Uint8>(static_cast<int>(r));
-				this->g = static_cast<Uint8>(static_cast<int>(g));
-				this->b = static_cast<Uint8>(static_cast<int>(b));
-				this->a = static_cast<Uint8>(static_cast<int>(a));
-			}
-	};
-	
+#ifndef NOISELANG_HEADLESS
 	class Image {
 		public:
-			bool rendering;
-			std::function<double(unsigned int)> scaleX;
-			std::function<double(unsigned int)> scaleY;
-			std::function<ImageColor(double)> color;
-			float noiseX, noiseY, noiseZ;
+			// Frames are split into square tiles of this size and spread over the worker pool
+			static const unsigned int TileSize = 64;
+
+			std::atomic<bool> rendering;
+			// Called on the evaluation thread once a frame is queued, to move on to the next one.
+			// Space in the window pauses it.
 			std::function<void(double)> OnRender;
 
+			// Frames evaluated ahead of the one on screen. The workers evaluate these while the
+			// current frame is converted and presented, and wait once this many are done.
+			static const size_t PipelineDepth = 2;
+
 		private:
-			std::shared_ptr<noise::module::Module> noiseSampler;
+			std::shared_ptr<const NoiseLang::Program> program;
+			std::shared_ptr<const NoiseLang::Palette> palette;
+			std::shared_ptr<std::shared_mutex> graphMutex;
 			SDL_Window* window;
 			SDL_Renderer* renderer;
 			SDL_GLContext context;
 			SDL_Event event;
 			SDL_Texture* texture;
-			unsigned int width, height;
-			float fps;
+			unsigned int textureWidth, textureHeight;
+			std::vector<Uint8> framebuffer;
+			std::atomic<unsigned int> width, height;
+			std::atomic<float> fps;
 			std::thread thread;
 			bool is_dead;
 
+			// Changed by PollEvents and the REPL, read once per frame by the evaluation thread
+			std::mutex viewMutex;
+			NoiseLang::View view;
+			std::atomic<bool> paused;
+
+			// A frame's samples on their way from the evaluation workers to the window
+			class Frame {
+				public:
+					unsigned int width, height;
+					std::vector<float> samples;
+					// Where it looks, as it was when the frame started
+					NoiseLang::View view;
+					// Seconds the workers spent on it
+					double evaluation;
+			};
+
+			// The evaluation thread takes free frames and hands back ready ones, the render thread the other way round
+			std::thread evaluator;
+			std::mutex pipelineMutex;
+			std::condition_variable frameReady, frameFree;
+			std::deque<std::unique_ptr<NoiseLang::Image::Frame>> readyFrames, freeFrames;
+
+			// Frame times for the `stats` command, and whether PollEvents keeps them in the window title
+			NoiseLang::FrameStats stats;
+			std::atomic<bool> statsInTitle;
+			bool titleShowsStats;
+			std::chrono::steady_clock::time_point titleUpdated;
+
+			// Per worker buffers, so tiles never share a register file
+			class TileScratch {
+				public:
+					NoiseLang::ProgramEvaluator evaluator;
+					std::vector<double> xs, ys, zs, values;
+					std::vector<float> tile;
+
+					// Node outputs read back from, and recorded for, the node cache
+					NoiseLang::NodeBuffers nodes;
+					std::vector<NoiseLang::NodeCache::Tile> reused;
+					std::vector<std::vector<double>> recorded;
+			};
+
+			std::shared_ptr<NoiseLang::WorkerPool> workers;
+			std::shared_ptr<NoiseLang::TileCache> cache;
+			std::shared_ptr<NoiseLang::NodeCache> nodeCache;
+			std::vector<NoiseLang::Image::TileScratch> scratch;
+			std::vector<double> columns, rows;
+
+			// The last frame evaluated and where it was, so a frame of the same view moved by whole
+			// pixels copies what the two share and evaluates only the strips it exposes
+			class Previous {
+				public:
+					std::vector<float> samples;
+					unsigned int width = 0, height = 0;
+					NoiseLang::View view;
+					std::uint64_t programKey = 0;
+			};
+			NoiseLang::Image::Previous previous;
+
+			// A rectangle of the frame to evaluate, [x0, x1) by [y0, y1)
+			class Region {
+				public:
+					unsigned int x0, y0, x1, y1;
+			};
+
 			auto internal_render() -> void;
+			auto internal_evaluate() -> void;
+			// Regions that a pan exposed are never asked for again at the same place, so they leave
+			// both caches alone when `cacheable` is false. Node outputs are only looked up and recorded
+			// when `still`, while z animates no tile is asked for twice.
+			auto render_tile(const std::shared_ptr<const NoiseLang::Program>& program, std::uint64_t programKey, NoiseLang::Image::Frame& frame, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, NoiseLang::Image::TileScratch& scratch, bool cacheable = true, bool still = true) -> void;
+			// Copies what `frame` shares with the previous one, and returns the regions it still needs
+			auto ReusePrevious(NoiseLang::Image::Frame& frame, const NoiseLang::View& view, std::uint64_t programKey) -> std::vector<NoiseLang::Image::Region>;
+			auto ResizeTexture(unsigned int width, unsigned int height) -> void;
 
 		public:
 			Image(unsigned int width, unsigned int height);
 			~Image();
 			auto InitSDL() -> void;
 			auto SetSampler(std::shared_ptr<noise::module::Module> noiseSampler) -> void;
+			auto SetProgram(std::shared_ptr<const NoiseLang::Program> program) -> void;
+			auto SetPalette(std::shared_ptr<const NoiseLang::Palette> palette) -> void;
+			auto SetWorkerPool(std::shared_ptr<NoiseLang::WorkerPool> workers) -> void;
+			auto SetGraphMutex(std::shared_ptr<std::shared_mutex> graphMutex) -> void;
+			auto SetTileCache(std::shared_ptr<NoiseLang::TileCache> cache) -> void;
+			auto SetNodeCache(std::shared_ptr<NoiseLang::NodeCache> nodeCache) -> void;
 			auto SetFPS(float fps) -> void;
 			auto GetFPS() -> float;
+			auto GetFrameStats() -> NoiseLang::FrameSummary;
+			auto SetStatsInTitle(bool statsInTitle) -> void;
+			auto GetView() -> NoiseLang::View;
+			auto SetView(const NoiseLang::View& view) -> void;
+			// Moves the view's z by `dz`, what OnRender animates
+			auto MoveZ(double dz) -> void;
+			auto IsPaused() -> bool;
+			auto GetSize(unsigned int& width, unsigned int& height) -> void;
 			auto PollEvents() -> bool;
 			auto StartRenderer() -> void;
 			auto StopRenderer() -> void;
 			auto IsDead() -> bool;
 	};
-
-	class Argument {
-		public:
-			std::string identifier;
-			double number;
-
-			Argument(std::string arg){
-				std::regex number_re("-?\\d*\\.\\d+");
-				std::regex identifier_re("([a-zA-z]{1}[a-zA-z0-9]*)");
-
-				if (std::regex_match(arg, number_re)){
-					std::stringstream ss(arg);
-					ss >> this->number;
-					this->identifier = "";
-				} else if (std::regex_match(arg, identifier_re)){
-					this->number = 0;
-					this->identifier = arg;
-				}
-			}
-
-			auto GetType() -> std::string {
-
-				return this->identifier == "" ? "number" : "identifier";
-
-			}
-	};
-
-	class Assignment {
-		public:
-			std::string identifier;
-			std::string module;
-			std::vector<std::string> arguments;
-	};
-
-	class Method {
-		public:
-			std::string identifier;
-			std::string method;
-			std::vector<NoiseLang::Argument> arguments;
-
-			auto Print() -> void {
-				std::cout << "(IDENTIFIER: \"" << this->identifier << "\") -> (METHOD: \"" << this->method << "\") (ARGUMENTS: [";
-				for (auto& arg : this->arguments){
-					if (arg.GetType() == "number")
-						std::cout << arg.number << ", ";
-					else
-						std::cout << "\"" << arg.identifier << "\", ";
-				}
-				std::cout << "]);" << std::endl;
-			}
-	};
-
-	class Out {
-		public:
-			std::string identifier;
-	};
-
-	class Save {
-		public:
-			std::string filename;
-	};
-
-	class Load {
-		public:
-			std::string filename;
-	};
-
-	class Show {
-		public:
-			int width;
-			int height;
-	};
+#endif
 
 	class Interpreter {
 		
 		private:
-			std::map<std::string, std::pair<std::string, std::shared_ptr<noise::module::Module>>> modules;
+			std::map<std::string, std::pair<const NoiseLang::ModuleSpec*, std::shared_ptr<noise::module::Module>>> modules;
 			std::string output_module = "";
 			std::deque<std::string> errors;
-			std::regex assignment;
-			std::regex method;
-			std::regex out;
-			std::regex save;
-			std::regex load;
-			std::regex show;
-			std::regex exit;
-
-			std::regex assignment_iter;
-			std::regex method_iter;
-			std::regex out_iter;
-			std::regex save_load_iter;
-			std::regex show_iter;
+			NoiseLang::Parser parser;
+			NoiseLang::Statement statement;
 
 			std::vector<std::string> lines;
 
 			int reading_status;
 			std::shared_ptr<std::thread> reading_thread = nullptr;
 
+#ifndef NOISELANG_HEADLESS
 			std::unique_ptr<NoiseLang::Image> image = nullptr;
+#endif
+			std::shared_ptr<NoiseLang::WorkerPool> workers = nullptr;
+			size_t memory_budget = NoiseLang::Stream::DefaultMemoryBudget;
 
-			std::map<std::string, std::vector<std::pair<std::string, std::vector<std::string>>>> methods = {
-				{"abs", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"add", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"billow", {{"SetFrequency", {"number"}}, {"SetLacunarity", {"number"}}, {"SetNoiseQuality", {"number"}}, {"SetOctaveCount", {"number"}}, {"SetPersistence", {"number"}}, {"SetSeed", {"number"}}}},
-				{"blend", {{"SetSourceModule", {"number", "identifier"}}, {"SetControlModule", {"identifier"}}}},
-				{"cache", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"checkerboard", {}},
-				{"clamp", {{"SetSourceModule", {"number", "identifier"}}, {"SetBounds", {"number", "number"}}}},
-				{"const", {{"SetConstValue", {"number"}}}},
-				{"curve", {{"SetSourceModule", {"number", "identifier"}}, {"AddControlPoint", {"number", "number"}}, {"ClearAllControlPoints", {}}}},
-				{"cylinders", {{"SetFrequency", {"number"}}}},
-				{"displace", {{"SetSourceModule", {"number", "identifier"}}, {"SetDisplaceModules", {"identifier", "identifier", "identifier"}}, {"SetXDisplaceModule", {"identifier"}}, {"SetYDisplaceModule", {"identifier"}}, {"SetZDisplaceModule", {"identifier"}}}},
-				{"exponent", {{"SetSourceModule", {"number", "identifier"}}, {"SetExponent", {"number"}}}},
-				{"invert", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"max", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"min", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"multiply", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"perlin", {{"SetFrequency", {"number"}}, {"SetLacunarity", {"number"}}, {"SetNoiseQuality", {"number"}}, {"SetOctaveCount", {"number"}}, {"SetPersistence", {"number"}}, {"SetSeed", {"number"}}}},
-				{"power", {{"SetSourceModule", {"number", "identifier"}}}},
-				{"ridgedmulti", {{"SetFrequency", {"number"}}, {"SetLacunarity", {"number"}}, {"SetNoiseQuality", {"number"}}, {"SetOctaveCount", {"number"}}, {"SetSeed", {"number"}}}},
-				{"rotatepoint", {{"SetSourceModule", {"number", "identifier"}}, {"SetAngles", {"number", "number", "number"}}, {"SetXAngle", {"number"}}, {"SetYAngle", {"number"}}, {"SetZAngle", {"number"}}}},
-				{"scalebias", {{"SetSourceModule", {"number", "identifier"}}, {"SetBias", {"number"}}, {"SetScale", {"number"}}}},
-				{"scalepoint", {{"SetSourceModule", {"number", "identifier"}}, {"SetScale", {"number", "number", "number"}}, {"SetXScale", {"number"}}, {"SetYScale", {"number"}}, {"SetZScale", {"number"}}}},
-				{"select", {{"SetSourceModule", {"number", "identifier"}}, {"SetControlModule", {"identifier"}}, {"SetBounds", {"number", "number"}}, {"SetEdgeFalloff", {"number"}}}},
-				{"spheres", {{"SetFrequency", {"number"}}}},
-				{"terrace", {{"SetSourceModule", {"number", "identifier"}}, {"InvertTerraces", {}}, {"MakeControlPoints", {"number"}}, {"AddControlPoint", {"number"}}, {"ClearAllControlPoints", {}}}},
-				{"translatepoint", {{"SetSourceModule", {"number", "identifier"}}, {"SetTranslation", {"number", "number", "number"}}, {"SetXTranslation", {"number"}}, {"SetYTranslation", {"number"}}, {"SetZTranslation", {"number"}}}},
-				{"turbulence", {{"SetSourceModule", {"number", "identifier"}}, {"SetFrequency", {"number"}}, {"SetPower", {"number"}}, {"SetRoughness", {"number"}}, {"SetSeed", {"number"}}}},
-				{"voronoi", {{"EnableDistance", {}}, {"DisableDistance", {}}, {"SetFrequency", {"number"}}, {"SetDisplacement", {"number"}}, {"SetSeed", {"number"}}}},
-			};
+			// What `show` paces the viewer to, 0 for as fast as it renders
+			int frame_rate = 60;
+
+			// Where `show` starts looking. The viewer pans and zooms its own copy, `view` reads it back.
+			NoiseLang::View view;
+
+			// What every program is compiled for: `precision float` trades exactness for SIMD lanes,
+			// `lut` curves and terraces for lookup tables
+			NoiseLang::CompileOptions compile_options;
+
+			// How the viewer and .ppm renders color samples. Replaced rather than changed, since the
+			// viewer's render thread may be reading it.
+			std::shared_ptr<const NoiseLang::Palette> palette = std::make_shared<NoiseLang::Palette>();
+
+			// Evaluated viewer tiles, keyed by program so edits never see stale tiles
+			std::shared_ptr<NoiseLang::TileCache> tile_cache = std::make_shared<NoiseLang::TileCache>();
+
+			// Each instruction's output per tile, so an edit only re-evaluates what it changed
+			std::shared_ptr<NoiseLang::NodeCache> node_cache = std::make_shared<NoiseLang::NodeCache>(256 * 1024 * 1024);
+
+			// Held exclusively while RunLine changes `modules`, and shared while workers evaluate them
+			std::shared_ptr<std::shared_mutex> graph_mutex = std::make_shared<std::shared_mutex>();
+
+			// Bumped on every change to the graph, the compiled program is rebuilt when it falls behind
+			unsigned long graph_version = 0;
+			unsigned long program_version = 0;
+			std::shared_ptr<const NoiseLang::Program> program = nullptr;
+			NoiseLang::OptimizerReport program_report;
 
 		public:
 			Interpreter();
@@ -226,6 +241,8 @@ namespace NoiseLang {
 
 			auto GetDefaultOutModule() -> std::shared_ptr<noise::module::Module>;
 
+			auto GetProgram() -> std::shared_ptr<const NoiseLang::Program>;
+
 			auto StartReading() -> void;
 			auto StopReading() -> void;
 
@@ -234,12 +251,12 @@ namespace NoiseLang {
 
 			auto CheckIdentifierArgs(std::vector<std::string> args) -> bool;
 
-			auto ParseAssignment(const std::string& line) -> NoiseLang::Assignment;
-			auto ParseMethod(const std::string& line) -> NoiseLang::Method;
-			auto ParseOut(const std::string& line) -> NoiseLang::Out;
-			auto ParseSave(const std::string& line) -> NoiseLang::Save;
-			auto ParseLoad(const std::string& line) -> NoiseLang::Load;
-			auto ParseShow(const std::string& show) -> NoiseLang::Show;
+			auto GraphChanged() -> void;
+
+			auto StreamToFile(std::shared_ptr<const NoiseLang::Program> program, const NoiseLang::Render& r, const NoiseLang::Bounds& bounds) -> int;
+			auto WriteTiles(std::shared_ptr<const NoiseLang::Program> program, const NoiseLang::Render& r, const NoiseLang::Bounds& bounds) -> int;
+			auto Profile(const NoiseLang::Render& r) -> int;
+
 
 			auto InternalRead() -> void;
 			auto InternalThreadedRead() -> void;
@@ -249,21 +266,10 @@ namespace NoiseLang {
 }
 
 NoiseLang::Interpreter::Interpreter() {
-	this->assignment = std::regex("^([a-zA-z]{1}[a-zA-z0-9]*)([ \t]*)(=)([ \t]*)(abs|add|billow|blend|cache|checkerboard|clamp|const|curve|cylinders|displace|exponent|invert|max|min|multiply|perlin|power|ridgedmulti|rotatepoint|scalebias|scalepoint|select|spheres|terrace|translatepoint|turbulence|voronoi)(\\()(([a-zA-z]{1}[a-zA-z0-9]*([ \t]*),([ \t]*))*([a-zA-z]{1}[a-zA-z0-9]*([ \t]*)){1})?(\\))$");
-	this->method = std::regex("^([a-zA-Z]{1}[a-zA-Z0-9]*)(->)([A-Z]{1}[a-zA-z]*)(\\()((((-?\\d*\\.?\\d+)|([a-zA-Z]{1}[a-zA-Z0-9]*))([ \t]*),([ \t]*))*((-?\\d*\\.?\\d+)|([a-zA-Z]{1}[a-zA-Z0-9]*)){1})(\\))$");
-	this->out = std::regex("^(out)([ \t]+)([a-zA-Z]{1}[a-zA-Z0-9]*)$");
-	this->save = std::regex("^(save)([ \t]+)([a-zA-z0-9]*\\.?[a-zA-z0-9]+)$");
-	this->load = std::regex("^(load)([ \t]+)([a-zA-z0-9]*\\.?[a-zA-z0-9]+)$");
-	this->show = std::regex("^(show)([ \t]+)(\\d{1,4})x(\\d{1,4})$");
-	this->exit = std::regex("^(exit)([ \t]*)$");
-
-	this->assignment_iter = std::regex("([a-zA-z]{1}[a-zA-z0-9]*)|(abs|add|billow|blend|cache|checkerboard|clamp|const|curve|cylinders|displace|exponent|invert|max|min|multiply|perlin|power|ridgedmulti|rotatepoint|scalebias|scalepoint|select|spheres|terrace|translatepoint|turbulence|voronoi)");
-	this->method_iter = std::regex("([a-zA-Z]{1}[a-zA-Z0-9]*)|([A-Z]{1}[a-zA-z]*)|(-?\\d*\\.?\\d+)");
-	this->out_iter = std::regex("([a-zA-Z]{1}[a-zA-Z0-9]*)$");
-	this->save_load_iter = std::regex("([a-zA-Z0-9]*\\.[a-zA-Z0-9]+)$");
-	this->show_iter = std::regex("(\\d{1,4})");
-
 	this->output_module = "";
+
+	// One render/export thread per hardware thread until `threads` says otherwise
+	this->workers = std::make_shared<NoiseLang::WorkerPool>();
 }
 
 NoiseLang::Interpreter::~Interpreter() {
@@ -284,167 +290,6 @@ auto NoiseLang::Interpreter::GetError() -> std::string {
 	}
 }
 
-auto NoiseLang::Interpreter::ParseAssignment(const std::string& line) -> NoiseLang::Assignment {
-	auto a = NoiseLang::Assignment();
-
-	auto begin = std::sregex_iterator(line.begin(), line.end(), this->assignment_iter);
-	auto end = std::sregex_iterator();
-	
-	int token = 0;
-
-	for (;begin != end; ++begin){
-		std::smatch match = *begin;
-		std::string s = match.str();
-
-		switch (token){
-			case 0: // Identifier
-				a.identifier = s;
-				break;
-			case 1: // Module
-				a.module = s;
-				break;
-			default: // Anything after Module (arguments)
-				a.arguments.push_back(s);
-				break;
-		}
-
-		token++;
-	}
-
-	return a;
-}
-
-auto NoiseLang::Interpreter::ParseMethod(const std::string& line) -> NoiseLang::Method {
-	auto m = NoiseLang::Method();
-
-	auto begin = std::sregex_iterator(line.begin(), line.end(), this->method_iter);
-	auto end = std::sregex_iterator();
-	
-	int token = 0;
-
-	for (;begin != end; ++begin){
-		std::smatch match = *begin;
-		std::string s = match.str();
-
-		switch (token){
-			case 0: // Identifier
-				m.identifier = s;
-				break;
-			case 1: // Module
-				m.method = s;
-				break;
-			default: // Anything after Module (arguments)
-				m.arguments.push_back({s});
-				break;
-		}
-
-		token++;
-	}
-
-	return m;
-}
-
-auto NoiseLang::Interpreter::ParseOut(const std::string& line) -> NoiseLang::Out {
-	auto o = NoiseLang::Out();
-
-	auto begin = std::sregex_iterator(line.begin(), line.end(), this->out_iter);
-	auto end = std::sregex_iterator();
-	
-	int token = 0;
-
-	for (;begin != end; ++begin){
-		std::smatch match = *begin;
-		std::string s = match.str();
-
-		switch (token){
-			case 0: // Identifier
-				o.identifier = s;
-				break;
-		}
-
-		token++;
-	}
-
-	return o;
-}
-
-auto NoiseLang::Interpreter::ParseSave(const std::string& line) -> NoiseLang::Save {
-	auto sa = NoiseLang::Save();
-
-	auto begin = std::sregex_iterator(line.begin(), line.end(), this->save_load_iter);
-	auto end = std::sregex_iterator();
-	
-	int token = 0;
-
-	for (;begin != end; ++begin){
-		std::smatch match = *begin;
-		std::string s = match.str();
-
-		switch (token){
-			case 0: // Filename
-				sa.filename = s;
-				break;
-		}
-
-		token++;
-	}
-
-	return sa;
-}
-
-auto NoiseLang::Interpreter::ParseLoad(const std::string& line) -> NoiseLang::Load {
-	auto l = NoiseLang::Load();
-
-	auto begin = std::sregex_iterator(line.begin(), line.end(), this->save_load_iter);
-	auto end = std::sregex_iterator();
-	
-	int token = 0;
-
-	for (;begin != end; ++begin){
-		std::smatch match = *begin;
-		std::string s = match.str();
-
-		switch (token){
-			case 0: // Filename
-				l.filename = s;
-				break;
-		}
-
-		token++;
-	}
-
-	return l;
-}
-
-auto NoiseLang::Interpreter::ParseShow(const std::string& line) -> NoiseLang::Show {
-	auto s = NoiseLang::Show();
-
-	auto begin = std::sregex_iterator(line.begin(), line.end(), this->show_iter);
-	auto end = std::sregex_iterator();
-	
-	int token = 0;
-
-	for (;begin != end; ++begin){
-		std::smatch match = *begin;
-		std::string str = match.str();
-
-		std::stringstream ss(str);
-
-		switch (token){
-			case 0: // Width
-				ss >> s.width;
-				break;
-			case 1: // Height
-				ss >> s.height;
-				break;
-		}
-
-		token++;
-	}
-
-	return s;
-}
-
 auto NoiseLang::Interpreter::CheckIdentifierArgs(std::vector<std::string> args) -> bool {
 	
 	for (unsigned int i = 0; i < args.size(); i++){
@@ -465,107 +310,36 @@ auto NoiseLang::Interpreter::RunLine(const std::string& line, bool saveline) ->
 
 	int status = NoiseLang::Ok;
 
-	if (std::regex_match(line, this->assignment)){
+	// One pass over the line, see NoiseLangParser.hpp
+	if (!this->parser.Parse(line, this->statement)){
+		this->AddError(this->parser.GetError());
+		return NoiseLang::Error;
+	}
+	auto type = this->statement.type;
+
+	if (type == NoiseLang::Statement::Type::Assignment){
 
 		// Line is a <assignment> grammar
-		auto a = this->ParseAssignment(line);
+		auto& a = this->statement.assignment;
+		std::unique_lock<std::shared_mutex> graph_lock(*this->graph_mutex);
 
 		if (auto it = this->modules.find(a.identifier); it == this->modules.end()){
 
-			// {{{ Module checking
-			if (a.module == "abs" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("abs", std::make_shared<noise::module::Abs>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "add" && a.arguments.size() == 2 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("add", std::make_shared<noise::module::Add>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-			} else if (a.module == "billow" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("billow", std::make_shared<noise::module::Billow>())));
-			} else if (a.module == "blend" && a.arguments.size() == 3 /* maybe 2 */ && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("blend", std::make_shared<noise::module::Blend>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-				this->modules[a.identifier].second->SetSourceModule(2, *this->modules[a.arguments[2]].second);
-			} else if (a.module == "cache" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("cache", std::make_shared<noise::module::Cache>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "checkerboard" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("checkerboard", std::make_shared<noise::module::Checkerboard>())));
-			} else if (a.module == "clamp" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("clamp", std::make_shared<noise::module::Clamp>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "const" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("const", std::make_shared<noise::module::Const>())));
-			} else if (a.module == "curve" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("curve", std::make_shared<noise::module::Curve>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "cylinders" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("cylinders", std::make_shared<noise::module::Cylinders>())));
-			} else if (a.module == "displace" && a.arguments.size() == 4 /* maybe 1 */ && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("displace", std::make_shared<noise::module::Displace>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-				this->modules[a.identifier].second->SetSourceModule(2, *this->modules[a.arguments[2]].second);
-				this->modules[a.identifier].second->SetSourceModule(3, *this->modules[a.arguments[3]].second);
-			} else if (a.module == "exponent" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("exponent", std::make_shared<noise::module::Exponent>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "invert" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("invert", std::make_shared<noise::module::Invert>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "max" && a.arguments.size() == 2 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("max", std::make_shared<noise::module::Max>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-			} else if (a.module == "min" && a.arguments.size() == 2 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("min", std::make_shared<noise::module::Min>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-			} else if (a.module == "multiply" && a.arguments.size() == 2 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("multiply", std::make_shared<noise::module::Multiply>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-			} else if (a.module == "perlin" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("perlin", std::make_shared<noise::module::Perlin>())));
-			} else if (a.module == "power" && a.arguments.size() == 2 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("power", std::make_shared<noise::module::Power>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-			} else if (a.module == "ridgedmulti" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("ridgedmulti", std::make_shared<noise::module::RidgedMulti>())));
-			} else if (a.module == "rotatepoint" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("rotatepoint", std::make_shared<noise::module::RotatePoint>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "scalebias" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("scalebias", std::make_shared<noise::module::ScaleBias>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "scalepoint" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("scalepoint", std::make_shared<noise::module::ScalePoint>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "select" && a.arguments.size() == 3 /* maybe 2 */ && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("select", std::make_shared<noise::module::Select>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-				this->modules[a.identifier].second->SetSourceModule(1, *this->modules[a.arguments[1]].second);
-				this->modules[a.identifier].second->SetSourceModule(2, *this->modules[a.arguments[2]].second);
-			} else if (a.module == "spheres" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("spheres", std::make_shared<noise::module::Spheres>())));
-			} else if (a.module == "terrace" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("terrace", std::make_shared<noise::module::Terrace>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "translatepoint" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("translatepoint", std::make_shared<noise::module::TranslatePoint>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "turbulence" && a.arguments.size() == 1 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("turbulence", std::make_shared<noise::module::Turbulence>())));
-				this->modules[a.identifier].second->SetSourceModule(0, *this->modules[a.arguments[0]].second);
-			} else if (a.module == "voronoi" && a.arguments.size() == 0 && this->CheckIdentifierArgs(a.arguments)){
-				this->modules.insert(std::make_pair(a.identifier, std::make_pair("voronoi", std::make_shared<noise::module::Voronoi>())));
+			if (a.arguments.size() == a.kind->sourceCount && this->CheckIdentifierArgs(a.arguments)){
+				auto module = a.kind->create();
+				for (unsigned int i = 0; i < a.arguments.size(); i++)
+					module->SetSourceModule(static_cast<int>(i), *this->modules.find(a.arguments[i])->second.second);
+				this->modules.emplace(a.identifier, std::make_pair(a.kind, std::move(module)));
+			} else if (a.arguments.size() != a.kind->sourceCount){
+				status = NoiseLang::Error;
+				this->AddError("Module " + a.module + " takes " + std::to_string(a.kind->sourceCount) + " source modules, not " + std::to_string(a.arguments.size()));
 			} else {
 				status = NoiseLang::Error;
-				this->AddError("Invalid number of arguments for module " + a.module);
+				this->AddError("Source modules of " + a.identifier + " must be existing identifiers");
 			}
-			// }}}
+
+			if (status == NoiseLang::Ok)
+				this->GraphChanged();
 
 		} else {
 
@@ -574,38 +348,50 @@ auto NoiseLang::Interpreter::RunLine(const std::string& line, bool saveline) ->
 
 		}
 
-	} else if (std::regex_match(line, this->method)) {
+	} else if (type == NoiseLang::Statement::Type::Method) {
 
 		// Line is a <method>
-		auto m = this->ParseMethod(line);
+		auto& m = this->statement.method;
+		std::unique_lock<std::shared_mutex> graph_lock(*this->graph_mutex);
 		
 		if (auto it = this->modules.find(m.identifier); it != this->modules.end()){
 
-			for (unsigned int i = 0; i < this->methods[it->second.first].size(); i++){
+			// The parser resolved the method name to an id, each kind maps ids straight to a handler
+			auto kind = it->second.first;
+			auto spec = kind->dispatch[m.methodId];
+			auto arguments = NoiseLang::MethodArguments();
 
-				if (this->methods[it->second.first][i].first == m.method){
-					
-					if (m.arguments.size() != this->methods[it->second.first][i].second.size()){
+			if (spec == nullptr){
 
-						status = NoiseLang::Error;
-						this->AddError("Invalid number of arguments to method \"" + m.method + "\"");
-						break;
+				status = NoiseLang::Error;
+				this->AddError("Module " + kind->name + " has no method \"" + m.method + "\"");
 
-					}
+			} else if (m.arguments.size() != spec->signature.size()){
+
+				status = NoiseLang::Error;
+				this->AddError("Invalid number of arguments to method \"" + m.method + "\"");
 
-					for (unsigned int j = 0; j < m.arguments.size(); j++){
-						
-						if (m.arguments[j].GetType() != this->methods[it->second.first][i].second[j]){
+			} else {
+
+				for (unsigned int j = 0; j < m.arguments.size(); j++){
 
-							status = NoiseLang::Error;
-							this->AddError("Invalid argument type");
-							break;
+					if (m.arguments[j].type != spec->signature[j]){
 
-						}
+						status = NoiseLang::Error;
+						this->AddError("Invalid argument type");
+						break;
 
 					}
 
-					break;
+					if (m.arguments[j].type == NoiseLang::ArgumentType::Number){
+						arguments.numbers[j] = m.arguments[j].number;
+					} else if (auto source = this->modules.find(m.arguments[j].identifier); source != this->modules.end()){
+						arguments.modules[j] = source->second.second.get();
+					} else {
+						status = NoiseLang::Error;
+						this->AddError("Identifier " + m.arguments[j].identifier + " does not exist");
+						break;
+					}
 
 				}
 
@@ -614,145 +400,14 @@ auto NoiseLang::Interpreter::RunLine(const std::string& line, bool saveline) ->
 			if (status == NoiseLang::Ok){
 
 				// Method call is legit
-				// auto mod = std::dynamic_pointer_cast<NOISE_MODULE_TYPE>(it->second.second);
-				
-				m.Print();
-				
-				if (it->second.first == "abs"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Abs>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "add"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Add>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "billow"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Billow>(it->second.second);
-					if (m.method == "SetFrequency") mod->SetFrequency(m.arguments[0].number);
-					else if (m.method == "SetLacunarity") mod->SetLacunarity(m.arguments[0].number);
-					//else if (m.method == "SetNoiseQuality") mod->SetNoiseQuality(m.arguments[0].number);
-					else if (m.method == "SetOctaveCount") mod->SetOctaveCount(static_cast<int>(m.arguments[0].number));
-					else if (m.method == "SetPersistence") mod->SetPersistence(m.arguments[0].number);
-					else if (m.method == "SetSeed") mod->SetSeed(static_cast<int>(m.arguments[0].number));
-				} else if (it->second.first == "blend"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Blend>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetControlModule") mod->SetControlModule(*this->modules.find(m.arguments[0].identifier)->second.second);
-				} else if (it->second.first == "cache"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Cache>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "checkerboard"){
-				} else if (it->second.first == "clamp"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Clamp>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetBounds") mod->SetBounds(m.arguments[0].number, m.arguments[1].number);
-				} else if (it->second.first == "const"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Const>(it->second.second);
-					if (m.method == "SetConstValue") mod->SetConstValue(m.arguments[0].number);
-				} else if (it->second.first == "curve"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Curve>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "AddControlPoint") mod->AddControlPoint(m.arguments[0].number, m.arguments[1].number);
-					else if (m.method == "ClearAllControlPoints") mod->ClearAllControlPoints();
-				} else if (it->second.first == "cylinders"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Cylinders>(it->second.second);
-					if (m.method == "SetFrequency") mod->SetFrequency(m.arguments[0].number);
-				} else if (it->second.first == "displace"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Displace>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetDisplaceModules") mod->SetDisplaceModules(*this->modules.find(m.arguments[0].identifier)->second.second, *this->modules.find(m.arguments[1].identifier)->second.second, *this->modules.find(m.arguments[2].identifier)->second.second);
-					else if (m.method == "SetXDisplaceModule") mod->SetXDisplaceModule(*this->modules.find(m.arguments[0].identifier)->second.second);
-					else if (m.method == "SetYDisplaceModule") mod->SetYDisplaceModule(*this->modules.find(m.arguments[0].identifier)->second.second);
-					else if (m.method == "SetZDisplaceModule") mod->SetZDisplaceModule(*this->modules.find(m.arguments[0].identifier)->second.second);
-				} else if (it->second.first == "exponent"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Exponent>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetExponent") mod->SetExponent(m.arguments[0].number);
-				} else if (it->second.first == "invert"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Invert>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "max"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Max>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "min"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Min>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "multiply"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Multiply>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "perlin"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Perlin>(it->second.second);
-					if (m.method == "SetFrequency") mod->SetFrequency(m.arguments[0].number);
-					else if (m.method == "SetLacunarity") mod->SetLacunarity(m.arguments[0].number);
-					//else if (m.method == "SetNoiseQuality") mod->SetNoiseQuality(m.arguments[0].number);
-					else if (m.method == "SetOctaveCount") mod->SetOctaveCount(static_cast<int>(m.arguments[0].number));
-					else if (m.method == "SetPersistence") mod->SetPersistence(m.arguments[0].number);
-					else if (m.method == "SetSeed") mod->SetSeed(static_cast<int>(m.arguments[0].number));
-				} else if (it->second.first == "power"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Power>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-				} else if (it->second.first == "ridgedmulti"){
-					auto mod = std::dynamic_pointer_cast<noise::module::RidgedMulti>(it->second.second);
-					if (m.method == "SetFrequency") mod->SetFrequency(m.arguments[0].number);
-					else if (m.method == "SetLacunarity") mod->SetLacunarity(m.arguments[0].number);
-					//else if (m.method == "SetNoiseQuality") mod->SetNoiseQuality(m.arguments[0].number);
-					else if (m.method == "SetOctaveCount") mod->SetOctaveCount(static_cast<int>(m.arguments[0].number));
-					else if (m.method == "SetSeed") mod->SetSeed(static_cast<int>(m.arguments[0].number));
-				} else if (it->second.first == "rotatepoint"){
-					auto mod = std::dynamic_pointer_cast<noise::module::RotatePoint>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetAngles") mod->SetAngles(m.arguments[0].number, m.arguments[1].number, m.arguments[2].number);
-					else if (m.method == "SetXAngle") mod->SetXAngle(m.arguments[0].number);
-					else if (m.method == "SetYAngle") mod->SetYAngle(m.arguments[0].number);
-					else if (m.method == "SetZAngle") mod->SetZAngle(m.arguments[0].number);
-				} else if (it->second.first == "scalebias"){
-					auto mod = std::dynamic_pointer_cast<noise::module::ScaleBias>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetBias") mod->SetBias(m.arguments[0].number);
-					else if (m.method == "SetScale") mod->SetScale(m.arguments[0].number);
-				} else if (it->second.first == "scalepoint"){
-					auto mod = std::dynamic_pointer_cast<noise::module::ScalePoint>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetScale") mod->SetScale(m.arguments[0].number, m.arguments[1].number, m.arguments[2].number);
-					else if (m.method == "SetXScale") mod->SetXScale(m.arguments[0].number);
-					else if (m.method == "SetYScale") mod->SetYScale(m.arguments[0].number);
-					else if (m.method == "SetZScale") mod->SetZScale(m.arguments[0].number);
-				} else if (it->second.first == "select"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Select>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetBounds") mod->SetBounds(m.arguments[0].number, m.arguments[1].number);
-					else if (m.method == "SetControlModule") mod->SetControlModule(*this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetEdgeFalloff") mod->SetEdgeFalloff(m.arguments[1].number);
-				} else if (it->second.first == "spheres"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Spheres>(it->second.second);
-					if (m.method == "SetFrequency") mod->SetFrequency(m.arguments[0].number);
-				} else if (it->second.first == "terrace"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Terrace>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "AddControlPoint") mod->AddControlPoint(m.arguments[0].number);
-					else if (m.method == "ClearAllControlPoints") mod->ClearAllControlPoints();
-					else if (m.method == "InvertTerraces") mod->InvertTerraces(!mod->IsTerracesInverted());
-					else if (m.method == "MakeControlPoints") mod->MakeControlPoints(static_cast<int>(m.arguments[0].number));
-				} else if (it->second.first == "translatepoint"){
-					auto mod = std::dynamic_pointer_cast<noise::module::TranslatePoint>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetTranslation") mod->SetTranslation(m.arguments[0].number, m.arguments[1].number, m.arguments[2].number);
-					else if (m.method == "SetXTranslation") mod->SetXTranslation(m.arguments[0].number);
-					else if (m.method == "SetYTranslation") mod->SetYTranslation(m.arguments[0].number);
-					else if (m.method == "SetZTranslation") mod->SetZTranslation(m.arguments[0].number);
-				} else if (it->second.first == "turbulence"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Turbulence>(it->second.second);
-					if (m.method == "SetSourceModule") mod->SetSourceModule(static_cast<int>(m.arguments[0].number), *this->modules.find(m.arguments[1].identifier)->second.second);
-					else if (m.method == "SetFrequency") mod->SetFrequency(m.arguments[0].number);
-					else if (m.method == "SetPower") mod->SetPower(m.arguments[0].number);
-					else if (m.method == "SetRoughness") mod->SetRoughness(static_cast<int>(m.arguments[0].number));
-					else if (m.method == "SetSeed") mod->SetSeed(static_cast<int>(m.arguments[0].number));
-				} else if (it->second.first == "voronoi"){
-					auto mod = std::dynamic_pointer_cast<noise::module::Voronoi>(it->second.second);
-					if (m.method == "EnableDistance") mod->EnableDistance(true);
-					else if (m.method == "DisableDistance") mod->EnableDistance(false);
-					else if (m.method == "SetDisplacement") mod->SetDisplacement(m.arguments[0].number);
-					else if (m.method == "SetFrequency") mod->SetFrequency(m.arguments[0].number);
-					else if (m.method == "SetSeed") mod->SetSeed(static_cast<int>(m.arguments[0].number));
+				try {
+					spec->handler(*it->second.second, arguments);
+					this->GraphChanged();
+				} catch (noise::Exception&){
+					status = NoiseLang::Error;
+					this->AddError("Invalid parameter to method \"" + m.method + "\"");
 				}
+
 			}
 
 		} else {
@@ -762,16 +417,15 @@ auto NoiseLang::Interpreter::RunLine(const std::string& line, bool saveline) ->
 
 		}
 
-	} else if (std::regex_match(line, this->out)) {
+	} else if (type == NoiseLang::Statement::Type::Out) {
 
 		// Line is a <out> grammar
-		auto o = this->ParseOut(line);
+		auto& o = this->statement.out;
 
 		if (auto it = this->modules.find(o.identifier); it != this->modules.end()){
 
-			if (this->image != nullptr)
-				this->image->SetSampler(it->second.second);
 			this->output_module = o.identifier;
+			this->GraphChanged();
 
 		} else {
 
@@ -780,12 +434,13 @@ auto NoiseLang::Interpreter::RunLine(const std::string& line, bool saveline) ->
 
 		}
 
-	} else if (std::regex_match(line, this->save)) {
+	} else if (type == NoiseLang::Statement::Type::Save) {
 
 		// Line is a <save> grammar
-		auto s = this->ParseSave(line);
+		auto& s = this->statement.save;
 
-		this->lines.erase(this->lines.end() - 1);
+		if (saveline)
+			this->lines.erase(this->lines.end() - 1);
 
 		std::ofstream outFile;
 		outFile.open(s.filename);
@@ -796,42 +451,471 @@ auto NoiseLang::Interpreter::RunLine(const std::string& line, bool saveline) ->
 
 		outFile.close();
 
-	} else if (std::regex_match(line, this->load)) {
+	} else if (type == NoiseLang::Statement::Type::Load) {
 
 		// Line is a <load> grammar
-		auto l = this->ParseLoad(line);
+		// A copy, the loaded lines are parsed into the same statement
+		auto l = this->statement.load;
 
 		this->Run(l.filename, false);
 
-	} else if (std::regex_match(line, this->show)) {
+	} else if (type == NoiseLang::Statement::Type::Compile) {
+
+		// Line is a <compile> grammar, write `out` as a standalone C++ header
+		auto& c = this->statement.compile;
+
+		if (saveline)
+			this->lines.erase(this->lines.end() - 1);
+
+		std::shared_ptr<const NoiseLang::Program> program;
+		try {
+			program = this->GetProgram();
+		} catch (noise::Exception&){
+			this->AddError("Module " + this->output_module + " can't be compiled, a curve needs 4 control points and a terrace 2");
+			return NoiseLang::Error;
+		}
+
+		// The file name without its directory or last extension names the generated namespace
+		std::string name = c.filename.substr(c.filename.find_last_of("/\\") + 1);
+		name = name.substr(0, name.rfind('.'));
+		for (auto& ch : name)
+			if (!std::isalnum(static_cast<unsigned char>(ch)))
+				ch = '_';
+		if (name == "" || std::isdigit(static_cast<unsigned char>(name[0])))
+			name = "Compiled" + name;
+
+		std::ofstream outFile;
+		outFile.open(c.filename);
+		NoiseLang::CodeGenerator::Generate(*program, name, outFile);
+		outFile.close();
+
+		std::cout << "Compiled " << (this->output_module == "" ? "the default module" : this->output_module) << " to " << c.filename << " (" << program->code.size() << " instructions)" << std::endl;
 
-		auto s = this->ParseShow(line);
+	} else if (type == NoiseLang::Statement::Type::Show) {
+
+		auto& s = this->statement.show;
+
+#ifdef NOISELANG_HEADLESS
+		this->AddError("This build has no viewer, use `render` to write " + std::to_string(s.width) + "x" + std::to_string(s.height) + " to a file");
+		return NoiseLang::Error;
+#else
+		std::shared_ptr<const NoiseLang::Program> program;
+		try {
+			program = this->GetProgram();
+		} catch (noise::Exception&){
+			this->AddError("Module " + this->output_module + " can't be rendered, a curve needs 4 control points and a terrace 2");
+			return NoiseLang::Error;
+		}
 
 		this->image = std::make_unique<NoiseLang::Image>(s.width, s.height);
 		this->image->InitSDL();
 		this->image->OnRender = [this](double dt) {
 			dt*=2;
-			this->image->noiseZ += (0.01);
+			this->image->MoveZ(0.01);
 		};
-		if (this->output_module == "")	
-			this->image->SetSampler(this->GetDefaultOutModule());
-		else
-			this->image->SetSampler(this->modules[this->output_module].second);
+		this->image->SetView(this->view);
+		this->image->SetProgram(program);
+		this->image->SetPalette(this->palette);
+		this->image->SetFPS(static_cast<float>(this->frame_rate));
+		this->image->SetWorkerPool(this->workers);
+		this->image->SetGraphMutex(this->graph_mutex);
+		this->image->SetTileCache(this->tile_cache);
+		this->image->SetNodeCache(this->node_cache);
 		this->image->StartRenderer();
 		this->image->PollEvents();
 			
 		this->reading_status = 2;
 		this->reading_thread = std::make_shared<std::thread>(&NoiseLang::Interpreter::InternalThreadedRead, this);
+#endif
 
-	} else if (std::regex_match(line, this->exit)) {
+	} else if (type == NoiseLang::Statement::Type::Render || type == NoiseLang::Statement::Type::Stream || type == NoiseLang::Statement::Type::Tiles) {
 
-		this->reading_status = 0;
+		// Line is a <render>, <stream> or <tiles> grammar, evaluate a module on the workers and write it out
+		auto& r = this->statement.render;
+
+		if (saveline)
+			this->lines.erase(this->lines.end() - 1);
+
+		auto it = this->modules.find(r.identifier);
+		if (it == this->modules.end()){
+			this->AddError("Identifier " + r.identifier + " does not exist");
+			return NoiseLang::Error;
+		}
+
+		std::shared_ptr<const NoiseLang::Program> program;
+		try {
+			program = r.identifier == this->output_module ? this->GetProgram() : NoiseLang::Compiler::Compile(*it->second.second, nullptr, this->compile_options);
+		} catch (noise::Exception&){
+			this->AddError("Module " + r.identifier + " can't be rendered, a curve needs 4 control points and a terrace 2");
+			return NoiseLang::Error;
+		}
+
+		auto bounds = NoiseLang::Bounds{0.0, r.width / 100.0, 0.0, r.height / 100.0};
+		if (r.hasBounds)
+			bounds = NoiseLang::Bounds{r.bounds[0], r.bounds[1], r.bounds[2], r.bounds[3]};
+
+		if (type == NoiseLang::Statement::Type::Stream)
+			return this->StreamToFile(program, r, bounds);
+		if (type == NoiseLang::Statement::Type::Tiles)
+			return this->WriteTiles(program, r, bounds);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		NoiseLang::Heightmap heightmap;
+		try {
+			heightmap = NoiseLang::Exporter::Render(*program, *this->workers, r.width, r.height, bounds);
+		} catch (std::bad_alloc&){
+			this->AddError("Not enough memory to render " + std::to_string(r.width) + "x" + std::to_string(r.height));
+			return NoiseLang::Error;
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		if (!heightmap.Save(r.filename, *this->palette)){
+			this->AddError("Couldn't write " + r.filename);
+			return NoiseLang::Error;
+		}
+
+		std::cout << "Rendered " << r.identifier << " to " << r.filename << " in " << seconds << " s, " << heightmap.values.size() / seconds / 1e6 << " Msamples/s on " << this->workers->GetThreadCount() << " threads" << std::endl;
+		std::cout << "buffer " << heightmap.GetSize() / 1048576.0 << " MiB, peak memory " << NoiseLang::GetPeakMemory() / 1048576.0 << " MiB" << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::Profile) {
+
+		// Line is a <profile> grammar, evaluate a module with every instruction timed
+		if (saveline)
+			this->lines.erase(this->lines.end() - 1);
+		return this->Profile(this->statement.render);
+
+	} else if (type == NoiseLang::Statement::Type::Budget) {
+
+		// Line is a <budget> grammar, the most a stream may hold in memory at once
+		this->memory_budget = static_cast<size_t>(this->statement.budget.megabytes) * 1024 * 1024;
+		std::cout << "Streaming within " << this->statement.budget.megabytes << " MiB" << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::Threads) {
+
+		// Line is a <threads> grammar, 0 means one thread per hardware thread
+		auto& t = this->statement.threads;
+
+		this->workers = std::make_shared<NoiseLang::WorkerPool>(t.count);
+#ifndef NOISELANG_HEADLESS
+		if (this->image != nullptr)
+			this->image->SetWorkerPool(this->workers);
+#endif
+
+		std::cout << "Rendering with " << this->workers->GetThreadCount() << " threads" << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::TileCache || type == NoiseLang::Statement::Type::NodeCache) {
+
+		// Line is a <tilecache> or <nodecache> grammar, resize one of the viewer's caches or report on it
+		auto& c = this->statement.cacheSize;
+		bool tiles = type == NoiseLang::Statement::Type::TileCache;
+		std::string what = tiles ? "tiles" : "node buffers";
+
+		if (saveline)
+			this->lines.erase(this->lines.end() - 1);
+
+		if (c.hasSize){
+			size_t capacity = static_cast<size_t>(c.megabytes) * 1024 * 1024;
+			if (tiles)
+				this->tile_cache->SetCapacity(capacity);
+			else
+				this->node_cache->SetCapacity(capacity);
+			std::cout << (c.megabytes == 0 ? "Not caching " + what : "Caching up to " + std::to_string(c.megabytes) + " MiB of " + what) << std::endl;
+		} else {
+			auto stats = tiles ? this->tile_cache->GetStats() : this->node_cache->GetStats();
+			size_t lookups = stats.hits + stats.misses;
+			std::cout << stats.hits << " hits, " << stats.misses << " misses (" << (lookups > 0 ? 100.0 * stats.hits / lookups : 0.0) << "% hit rate), " << stats.evictions << " evictions" << std::endl;
+			std::cout << stats.tiles << " " << what << " in " << stats.bytes / 1048576.0 << " of " << stats.capacity / 1048576.0 << " MiB" << std::endl;
+		}
+
+	} else if (type == NoiseLang::Statement::Type::FrameRate) {
+
+		// Line is a <fps> grammar, pace the viewer now and whatever is shown later
+		this->frame_rate = this->statement.frameRate.fps;
+#ifndef NOISELANG_HEADLESS
+		if (this->image != nullptr)
+			this->image->SetFPS(static_cast<float>(this->frame_rate));
+#endif
+
+		std::cout << (this->frame_rate == 0 ? std::string("Showing frames as fast as they render") : "Showing at most " + std::to_string(this->frame_rate) + " frames per second") << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::View) {
+
+		// Line is a <view> grammar, move the viewer or report where it is looking
+		auto& v = this->statement.view;
+#ifndef NOISELANG_HEADLESS
+		if (this->image != nullptr)
+			this->view = this->image->GetView();
+#endif
+
+		if (v.mode == NoiseLang::ViewCommand::Mode::Print){
+			if (saveline)
+				this->lines.erase(this->lines.end() - 1);
+		} else {
+			double z = this->view.z;
+			if (v.mode == NoiseLang::ViewCommand::Mode::Reset){
+				this->view = NoiseLang::View();
+			} else {
+				this->view.x = v.x;
+				this->view.y = v.y;
+				if (v.hasScale)
+					this->view.scale = v.scale;
+			}
+			this->view.z = z;
+#ifndef NOISELANG_HEADLESS
+			if (this->image != nullptr)
+				this->image->SetView(this->view);
+#endif
+		}
+
+		std::cout << "view " << this->view.x << " " << this->view.y << " " << this->view.scale << ", at z " << this->view.z;
+#ifndef NOISELANG_HEADLESS
+		if (this->image != nullptr){
+			// The bounds `render` takes to write what the window shows
+			unsigned int width, height;
+			this->image->GetSize(width, height);
+			std::cout << (this->image->IsPaused() ? " (paused)" : "") << ", the window covers " << this->view.x << " " << this->view.GetX(width) << " " << this->view.y << " " << this->view.GetY(height);
+		}
+#endif
+		std::cout << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::Stats) {
+
+		// Line is a <stats> grammar, how the viewer has kept up over its last few seconds
+		auto& s = this->statement.stats;
+
+		if (saveline)
+			this->lines.erase(this->lines.end() - 1);
+
+#ifdef NOISELANG_HEADLESS
+		(void)s;
+		this->AddError("This build has no viewer, `render` reports its own throughput");
+		return NoiseLang::Error;
+#else
+		if (this->image == nullptr){
+			this->AddError("Nothing is being shown, `show` a module first");
+			return NoiseLang::Error;
+		}
+
+		if (s.mode != NoiseLang::Stats::Mode::Print){
+			this->image->SetStatsInTitle(s.mode == NoiseLang::Stats::Mode::Title);
+			return NoiseLang::Ok;
+		}
+
+		auto stats = this->image->GetFrameStats();
+		if (stats.frames == 0){
+			std::cout << "No frames yet" << std::endl;
+			return NoiseLang::Ok;
+		}
+
+		std::cout << std::fixed << std::setprecision(2);
+		std::cout << "Last " << stats.frames << " frames at " << stats.fps << " fps";
+		if (this->frame_rate > 0)
+			std::cout << " of " << this->frame_rate;
+		std::cout << ", " << stats.samplesPerSecond / 1e6 << " Msamples/s while rendering" << std::endl;
+		std::cout << "Frame times p50 " << stats.p50 * 1000.0 << " ms, p95 " << stats.p95 * 1000.0 << " ms, p99 " << stats.p99 * 1000.0 << " ms, worst " << stats.worst * 1000.0 << " ms";
+		if (this->frame_rate > 0)
+			std::cout << ", p99 is " << 100.0 * stats.p99 * this->frame_rate << "% of the frame";
+		std::cout << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+		std::cout << std::setprecision(6);
+#endif
+
+	} else if (type == NoiseLang::Statement::Type::Precision) {
+
+		// Line is a <precision> grammar, recompile everything at the new precision or report the current one
+		auto& p = this->statement.precision;
+		namespace K = NoiseLang::Kernels;
+
+		if (p.mode == NoiseLang::PrecisionMode::Mode::Print){
+			if (saveline)
+				this->lines.erase(this->lines.end() - 1);
+		} else {
+			this->compile_options.precision = p.mode == NoiseLang::PrecisionMode::Mode::Float ? NoiseLang::Precision::Single : NoiseLang::Precision::Double;
+			this->GraphChanged();
+		}
+
+		auto level = NoiseLang::Simd::Get();
+		if (this->compile_options.precision == NoiseLang::Precision::Double)
+			std::cout << "Evaluating in double, `precision float` runs perlin, billow and ridgedmulti " << NoiseLang::Simd::GetLanes(level) << " lanes at a time (" << NoiseLang::Simd::GetName(level) << ")" << std::endl;
+		else
+			std::cout << "Evaluating perlin, billow and ridgedmulti in float, " << NoiseLang::Simd::GetLanes(level) << " lanes at a time (" << NoiseLang::Simd::GetName(level) << "), within " << K::Single::MaxError << " of double" << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::Table) {
+
+		// Line is a <lut> grammar, recompile with curves and terraces as tables within the given error
+		auto& t = this->statement.table;
+		if (t.mode == NoiseLang::TableMode::Mode::Print){
+			if (saveline)
+				this->lines.erase(this->lines.end() - 1);
+		} else {
+			this->compile_options.tableError = t.mode == NoiseLang::TableMode::Mode::Off ? 0.0 : t.error;
+			this->GraphChanged();
+		}
+
+		if (this->compile_options.tableError > 0.0)
+			std::cout << "Curves and terraces become lookup tables within " << this->compile_options.tableError << " of the one each replaces, `optimize` lists them" << std::endl;
+		else
+			std::cout << "Curves and terraces are evaluated exactly" << std::endl;
 
-	} else if (line.size() > 0) {
+	} else if (type == NoiseLang::Statement::Type::Lod) {
 
-		// Line is not blank and doesnt match any patterns
-		status = NoiseLang::Error;
-		this->AddError("Line does not match any patterns");
+		// Line is a <lod> grammar, recompile with or without octave culling and say what it does at the viewer's scale
+		auto& l = this->statement.lod;
+		if (l.mode == NoiseLang::LodMode::Mode::Print){
+			if (saveline)
+				this->lines.erase(this->lines.end() - 1);
+		} else {
+			this->compile_options.lod = l.mode == NoiseLang::LodMode::Mode::On;
+			this->GraphChanged();
+		}
+
+		if (!this->compile_options.lod){
+			std::cout << "Fractals run every octave, `lod on` fades out those finer than the pixels" << std::endl;
+		} else {
+			std::cout << "Fractals fade out octaves whose cells are under 2 pixels across and drop them under 1" << std::endl;
+
+#ifndef NOISELANG_HEADLESS
+			if (this->image != nullptr)
+				this->view = this->image->GetView();
+#endif
+			std::shared_ptr<const NoiseLang::Program> program;
+			try {
+				program = this->GetProgram();
+			} catch (noise::Exception&){
+				// Nothing to list until the curve or terrace has its control points
+			}
+
+			auto name = [this](const noise::module::Module* module) -> std::string {
+				for (auto& m : this->modules)
+					if (m.second.second.get() == module)
+						return m.first;
+				return "(default)";
+			};
+
+			if (program != nullptr){
+				std::vector<NoiseLang::OctaveDetail> detail;
+				program->GetDetail(this->view.scale, detail);
+				for (size_t n = 0; n < program->code.size(); n++){
+					if (detail[n].octaves == 0)
+						continue;
+					int octaves = program->GetOctaveCount(program->code[n]);
+					double running = std::round((detail[n].octaves - 1 + detail[n].fade) * 10.0) / 10.0;
+					std::cout << "  " << NoiseLang::GetOpCodeName(program->code[n].op) << " " << name(program->origins[n]) << " runs " << running << " of " << octaves << " octaves in the viewer, at " << this->view.scale << " per pixel" << std::endl;
+				}
+			}
+		}
+
+	} else if (type == NoiseLang::Statement::Type::Palette) {
+
+		// Line is a <palette> grammar, change how samples are colored or list the stops
+		auto& p = this->statement.palette;
+		auto palette = std::make_shared<NoiseLang::Palette>(*this->palette);
+
+		switch (p.mode){
+			case NoiseLang::PaletteCommand::Mode::Print:
+				if (saveline)
+					this->lines.erase(this->lines.end() - 1);
+				break;
+			case NoiseLang::PaletteCommand::Mode::Preset:
+				if (!palette->SetPreset(p.preset)){
+					this->AddError("There is no palette " + p.preset + ", try gray or terrain");
+					return NoiseLang::Error;
+				}
+				break;
+			case NoiseLang::PaletteCommand::Mode::Stop:
+				palette->AddStop(NoiseLang::PaletteStop{p.position, static_cast<std::uint8_t>(p.color[0]), static_cast<std::uint8_t>(p.color[1]), static_cast<std::uint8_t>(p.color[2]), static_cast<std::uint8_t>(p.color[3])});
+				break;
+			case NoiseLang::PaletteCommand::Mode::Clear:
+				palette->Clear();
+				break;
+			case NoiseLang::PaletteCommand::Mode::Shade:
+				palette->SetShade(p.shade);
+				break;
+		}
+
+		this->palette = palette;
+#ifndef NOISELANG_HEADLESS
+		if (this->image != nullptr)
+			this->image->SetPalette(this->palette);
+#endif
+
+		auto& stops = palette->GetStops();
+		if (p.mode == NoiseLang::PaletteCommand::Mode::Print)
+			for (auto& stop : stops)
+				std::cout << "palette stop " << stop.position << " " << +stop.r << " " << +stop.g << " " << +stop.b << " " << +stop.a << std::endl;
+
+		if (stops.empty())
+			std::cout << "No stops, samples are drawn black";
+		else
+			std::cout << stops.size() << " stops from " << stops.front().position << " to " << stops.back().position;
+		if (palette->GetShade() > 0.0)
+			std::cout << ", slopes shaded by " << palette->GetShade() << " from the top left";
+		std::cout << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::Optimize) {
+
+		// Line is a <optimize> grammar, report what compiling `out` removed
+		std::shared_ptr<const NoiseLang::Program> program;
+		try {
+			program = this->GetProgram();
+		} catch (noise::Exception&){
+			this->AddError("Module " + this->output_module + " can't be compiled, a curve needs 4 control points and a terrace 2");
+			return NoiseLang::Error;
+		}
+
+		auto name = [this](const noise::module::Module* module) -> std::string {
+			for (auto& m : this->modules)
+				if (m.second.second.get() == module)
+					return m.first;
+			return "(default)";
+		};
+
+		auto& report = this->program_report;
+		std::cout << "Compiled out to " << program->code.size() << " instructions" << std::endl;
+
+		for (auto& o : report.optimizations){
+			switch (o.action){
+				case NoiseLang::Optimization::Action::Folded:
+					std::cout << "folded " << NoiseLang::GetOpCodeName(o.op) << " " << name(o.module) << " into a constant";
+					break;
+				case NoiseLang::Optimization::Action::Merged:
+					std::cout << "merged " << NoiseLang::GetOpCodeName(o.op) << " " << name(o.module) << " into " << name(o.into);
+					break;
+				case NoiseLang::Optimization::Action::Pruned:
+					std::cout << "pruned " << NoiseLang::GetOpCodeName(o.op) << " " << name(o.module);
+					break;
+				case NoiseLang::Optimization::Action::Shared:
+					std::cout << "shared " << name(o.module) << " (" << NoiseLang::GetOpCodeName(o.op) << ") with another consumer";
+					break;
+				case NoiseLang::Optimization::Action::Fused:
+					std::cout << "fused " << NoiseLang::GetOpCodeName(o.op) << " " << name(o.module) << " into the chain ending at " << name(o.into);
+					break;
+				case NoiseLang::Optimization::Action::Tabulated:
+					if (o.entries == 0)
+						std::cout << "kept " << NoiseLang::GetOpCodeName(o.op) << " " << name(o.module) << " exact, " << NoiseLang::Compiler::MaxTableEntries << " entries are still off by " << o.error;
+					else
+						std::cout << "tabulated " << NoiseLang::GetOpCodeName(o.op) << " " << name(o.module) << " in " << o.entries << " entries, off by at most " << o.error;
+					break;
+			}
+			std::cout << ", saves " << o.saved << " per sample" << std::endl;
+		}
+
+		std::string unreachable;
+		for (auto& m : this->modules)
+			if (report.reachable.count(m.second.second.get()) == 0)
+				unreachable += " " + m.first;
+		if (unreachable != "")
+			std::cout << "unreachable from out:" << unreachable << std::endl;
+
+		if (report.sharedEvaluations > 0)
+			std::cout << "sharing avoids " << report.sharedEvaluations << " of " << report.treeEvaluations << " node evaluations per sample" << std::endl;
+
+		double saved = report.costBefore > 0.0 ? 100.0 * (report.costBefore - report.costAfter) / report.costBefore : 0.0;
+		std::cout << "estimated cost per sample " << report.costBefore << " -> " << report.costAfter << " (" << saved << "% saved, 1.0 = one octave of gradient noise)" << std::endl;
+
+	} else if (type == NoiseLang::Statement::Type::Exit) {
+
+		this->reading_status = 0;
 
 	}
 
@@ -853,19 +937,176 @@ auto NoiseLang::Interpreter::Run(const std::string& filename, bool savelines) ->
 }
 
 auto NoiseLang::Interpreter::Reset() -> void {
+	std::unique_lock<std::shared_mutex> graph_lock(*this->graph_mutex);
 	this->modules.clear();
+	this->GraphChanged();
 }
 
 auto NoiseLang::Interpreter::GetDefaultOutModule() -> std::shared_ptr<noise::module::Module> {
 	return std::make_unique<noise::module::Const>();
 }
 
+auto NoiseLang::Interpreter::GetOutModule() -> std::shared_ptr<noise::module::Module> {
+	if (auto it = this->modules.find(this->output_module); it != this->modules.end())
+		return it->second.second;
+	return this->GetDefaultOutModule();
+}
+
+auto NoiseLang::Interpreter::GetProgram() -> std::shared_ptr<const NoiseLang::Program> {
+	// Only recompile once per change to the graph, however many times this is asked for
+	if (this->program == nullptr || this->program_version != this->graph_version){
+		auto module = this->GetOutModule();
+
+		this->program = NoiseLang::Compiler::Compile(*module, &this->program_report, this->compile_options);
+		this->program_version = this->graph_version;
+	}
+
+	return this->program;
+}
+
+auto NoiseLang::Interpreter::GraphChanged() -> void {
+	this->graph_version++;
+
+	// The viewer gets the new program straight away, everything else compiles on demand
+#ifndef NOISELANG_HEADLESS
+	if (this->image != nullptr){
+		try {
+			this->image->SetProgram(this->GetProgram());
+		} catch (noise::Exception&){
+			// A curve or terrace that is still being given its control points, keep showing the last valid program
+		}
+	}
+#endif
+}
+
+auto NoiseLang::Interpreter::StreamToFile(std::shared_ptr<const NoiseLang::Program> program, const NoiseLang::Render& r, const NoiseLang::Bounds& bounds) -> int {
+	auto stream = NoiseLang::Stream(program, r.width, r.height, bounds);
+	stream.SetMemoryBudget(this->memory_budget);
+
+	// One line, rewritten after every chunk
+	unsigned int resumedAt = 0;
+	stream.SetProgressCallback([&resumedAt](const NoiseLang::StreamProgress& p){
+		resumedAt = p.resumedAt;
+		double rate = (p.rowsDone - p.resumedAt) / std::max(p.seconds, 1e-9);
+		std::cout << "\rrow " << p.rowsDone << "/" << p.height << " (" << static_cast<int>(100.0 * p.rowsDone / p.height) << "%), chunk " << p.chunksDone << "/" << p.chunkCount << ", " << static_cast<int>((p.height - p.rowsDone) / std::max(rate, 1e-9)) << " s left   " << std::flush;
+	});
+
+	auto start = std::chrono::high_resolution_clock::now();
+	if (!stream.Run(*this->workers, r.filename)){
+		std::cout << std::endl;
+		this->AddError(stream.GetError());
+		return NoiseLang::Error;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::cout << std::endl << "Streamed " << r.identifier << " to " << r.filename << " in " << seconds << " s, " << static_cast<double>(r.width) * (r.height - resumedAt) / seconds / 1e6 << " Msamples/s on " << this->workers->GetThreadCount() << " threads" << std::endl;
+	if (resumedAt > 0)
+		std::cout << "resumed an interrupted stream at row " << resumedAt << std::endl;
+	std::cout << "chunks of " << stream.GetChunkRows() << " rows, buffers " << stream.GetBufferSize() / 1048576.0 << " MiB of a " << this->memory_budget / 1048576.0 << " MiB budget, peak memory " << NoiseLang::GetPeakMemory() / 1048576.0 << " MiB" << std::endl;
+	return NoiseLang::Ok;
+}
+
+auto NoiseLang::Interpreter::WriteTiles(std::shared_ptr<const NoiseLang::Program> program, const NoiseLang::Render& r, const NoiseLang::Bounds& bounds) -> int {
+	// 16-bit tiles cover libnoise's nominal -1 to 1, anything outside and any NaN is clamped and counted
+	auto format = r.quantized ? NoiseLang::TileFormat::UInt16 : NoiseLang::TileFormat::Float32;
+	const double corners[4] = {bounds.x0, bounds.x1, bounds.y0, bounds.y1};
+
+	auto writer = NoiseLang::TileWriter();
+	if (!writer.Open(r.filename, r.width, r.height, NoiseLang::TileWriter::DefaultTileSize, format, -1.0, 1.0, corners)){
+		this->AddError("Couldn't make room for " + r.filename + " on disk");
+		return NoiseLang::Error;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	bool ok;
+	size_t clamped = NoiseLang::Exporter::RenderTiles(*program, *this->workers, writer, 0.0, ok);
+	if (!writer.Close() || !ok){
+		this->AddError("Couldn't write the tiles of " + r.filename);
+		return NoiseLang::Error;
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	auto& h = writer.GetHeader();
+	std::cout << "Wrote " << h.tilesX * h.tilesY << " " << (r.quantized ? "u16" : "float") << " tiles of " << h.tileSize << "x" << h.tileSize << " to " << r.filename << " in " << seconds << " s, " << static_cast<double>(r.width) * r.height / seconds / 1e6 << " Msamples/s on " << this->workers->GetThreadCount() << " threads" << std::endl;
+	std::cout << "file " << writer.GetFileSize() / 1048576.0 << " MiB, peak memory " << NoiseLang::GetPeakMemory() / 1048576.0 << " MiB" << std::endl;
+	if (clamped > 0)
+		std::cout << clamped << " samples outside -1 to 1, or not a number, were clamped" << std::endl;
+	return NoiseLang::Ok;
+}
+
+auto NoiseLang::Interpreter::Profile(const NoiseLang::Render& r) -> int {
+#ifndef NOISELANG_PROFILE
+	(void)r;
+	this->AddError("This build has no profiler, build it with NOISELANG_PROFILE defined (make profile)");
+	return NoiseLang::Error;
+#else
+	auto it = this->modules.find(r.identifier);
+	if (it == this->modules.end()){
+		this->AddError("Identifier " + r.identifier + " does not exist");
+		return NoiseLang::Error;
+	}
+
+	std::shared_ptr<const NoiseLang::Program> program;
+	auto report = NoiseLang::OptimizerReport();
+	try {
+		program = NoiseLang::Compiler::Compile(*it->second.second, &report, this->compile_options);
+	} catch (noise::Exception&){
+		this->AddError("Module " + r.identifier + " can't be profiled, a curve needs 4 control points and a terrace 2");
+		return NoiseLang::Error;
+	}
+
+	// One thread, so times add up to the wall clock
+	auto profile = NoiseLang::ProgramProfile();
+	auto evaluator = NoiseLang::ProgramEvaluator();
+	std::vector<double> values(static_cast<size_t>(r.width) * r.height);
+	evaluator.SetProfile(&profile);
+
+	std::shared_lock<std::shared_mutex> graph_lock(*this->graph_mutex);
+	auto start = std::chrono::high_resolution_clock::now();
+	evaluator.EvaluateGrid(*program, NoiseLang::PointGrid(0.0, 0.0, 0.0, 0.01, 0.01, r.width, r.height), values.data());
+	double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	graph_lock.unlock();
+
+	std::map<const noise::module::Module*, std::string> names;
+	for (auto& m : this->modules)
+		names[m.second.second.get()] = m.first;
+	auto entries = NoiseLang::Profiler::Summarize(*program, profile, report, names);
+
+	std::cout << "Profiled " << r.identifier << " at " << r.width << "x" << r.height << " in " << seconds * 1000.0 << " ms on 1 thread, " << values.size() / seconds / 1e6 << " Msamples/s" << std::endl;
+	std::cout << std::left << std::setw(16) << "module" << std::setw(16) << "kind" << std::right
+		<< std::setw(12) << "incl ms" << std::setw(8) << "incl %" << std::setw(12) << "excl ms" << std::setw(8) << "excl %"
+		<< std::setw(10) << "calls" << std::setw(12) << "Msamples/s" << std::setw(14) << "shared reads" << std::endl;
+	for (auto& e : entries){
+		std::string shared = e.reads > 1 ? std::to_string(e.sharedReads) + "/" + std::to_string(e.reads) + " " + std::to_string(100 * e.sharedReads / e.reads) + "%" : "-";
+		std::cout << std::left << std::setw(16) << e.name << std::setw(16) << e.kind << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(12) << e.inclusive * 1000.0 << std::setw(8) << 100.0 * e.inclusive / seconds
+			<< std::setw(12) << e.exclusive * 1000.0 << std::setw(8) << 100.0 * e.exclusive / seconds
+			<< std::setw(10) << e.calls << std::setw(12) << (e.exclusive > 0.0 ? e.samples / e.exclusive / 1e6 : 0.0) << std::setw(14) << shared << std::endl;
+		std::cout.unsetf(std::ios::fixed);
+		std::cout << std::setprecision(6);
+	}
+
+	if (r.filename != ""){
+		std::ofstream file(r.filename);
+		NoiseLang::Profiler::WriteFolded(*it->second.second, *program, profile, names, file);
+		if (!file){
+			this->AddError("Couldn't write " + r.filename);
+			return NoiseLang::Error;
+		}
+		std::cout << "Folded stacks written to " << r.filename << std::endl;
+	}
+
+	return NoiseLang::Ok;
+#endif
+}
+
 auto NoiseLang::Interpreter::StartReading() -> void {
 
 	this->reading_status = 1;
 
 	while (this->reading_status > 0){
 
+#ifndef NOISELANG_HEADLESS
 		if (this->image != nullptr){
 
 			this->image->PollEvents();
@@ -875,17 +1116,20 @@ auto NoiseLang::Interpreter::StartReading() -> void {
 				this->reading_thread->join();
 			}
 
-		} else {
-
-			this->InternalRead();
+			continue;
 
 		}
+#endif
+
+		this->InternalRead();
 
 	}
 
 	this->StopReading();
+#ifndef NOISELANG_HEADLESS
 	if (this->image != nullptr)
 		this->image->StopRenderer();
+#endif
 
 }
 
@@ -912,6 +1156,7 @@ auto NoiseLang::Interpreter::InternalThreadedRead() -> void {
 	}
 }
 
+#ifndef NOISELANG_HEADLESS
 NoiseLang::Image::Image(unsigned int width, unsigned int height) {
 	this->width = width;
 	this->height = height;
@@ -926,36 +1171,36 @@ NoiseLang::Image::Image(unsigned int width, unsigned int height) {
 	this->window = nullptr;
 	this->renderer = nullptr;
 
-	// Initialize texture to a nullptr
+	// Initialize texture to a nullptr, it is created by the render thread once the size is known
 	this->texture = nullptr;
+	this->textureWidth = 0;
+	this->textureHeight = 0;
 
-	// Initialize the scale functions to 1 to 1
-	this->scaleX = [](unsigned int x) -> double { return static_cast<double>(x) / 100.0; };
-	this->scaleY = [](unsigned int y) -> double { return static_cast<double>(y) / 100.0; };
-	
-	// Initialize color function to output black -> white
-	this->color = [](double noiseval) -> ImageColor { return {
-		255.0 * (1.0 + noiseval) / 2.0,
-		255.0 * (1.0 + noiseval) / 2.0,
-		255.0 * (1.0 + noiseval) / 2.0,
-		255.0
-	};};
+	// Initialize the palette to black -> white
+	this->palette = std::make_shared<NoiseLang::Palette>();
 
 	// Initialize the OnRender function (dt*=2 is just to get the warning to go away)
 	this->OnRender = [](double dt){dt*=2;};
 
-	// Initialize the internal noise position offset to 0 for all
-	this->noiseX = 0.0;
-	this->noiseY = 0.0;
-	this->noiseZ = 0.0;
+	// The view starts at the origin, 100 pixels to the unit, with z animating
+	this->view = NoiseLang::View();
+	this->paused = false;
 
 	this->is_dead = false;
+
+	this->statsInTitle = false;
+	this->titleShowsStats = false;
 }
 
 NoiseLang::Image::~Image() {
 	// Dispose of rendering thread
 	this->StopRenderer();
 	
+	// Destroy the streaming texture before the renderer that owns it
+	if (this->texture != nullptr){
+		SDL_DestroyTexture(this->texture);
+	}
+
 	// Destroy the renderer if it exists
 	if (this->renderer != nullptr){
 		SDL_DestroyRenderer(this->renderer);
@@ -983,21 +1228,100 @@ auto NoiseLang::Image::InitSDL() -> void {
 }
 
 auto NoiseLang::Image::SetSampler(std::shared_ptr<noise::module::Module> noiseSampler) -> void {
-	this->noiseSampler = noiseSampler;
+	this->SetProgram(NoiseLang::Compiler::Compile(*noiseSampler));
+}
+
+auto NoiseLang::Image::SetProgram(std::shared_ptr<const NoiseLang::Program> program) -> void {
+	// The REPL thread recompiles and swaps the program while a frame is rendering
+	std::atomic_store(&this->program, program);
+}
+
+auto NoiseLang::Image::SetPalette(std::shared_ptr<const NoiseLang::Palette> palette) -> void {
+	// Read once per frame by the render thread, so a new palette shows on the next frame
+	std::atomic_store(&this->palette, palette);
+}
+
+auto NoiseLang::Image::SetGraphMutex(std::shared_ptr<std::shared_mutex> graphMutex) -> void {
+	this->graphMutex = graphMutex;
+}
+
+auto NoiseLang::Image::SetTileCache(std::shared_ptr<NoiseLang::TileCache> cache) -> void {
+	std::atomic_store(&this->cache, cache);
+}
+
+auto NoiseLang::Image::SetNodeCache(std::shared_ptr<NoiseLang::NodeCache> nodeCache) -> void {
+	std::atomic_store(&this->nodeCache, nodeCache);
+}
+
+auto NoiseLang::Image::SetWorkerPool(std::shared_ptr<NoiseLang::WorkerPool> workers) -> void {
+	// The render thread picks the new pool up at the start of its next frame
+	std::atomic_store(&this->workers, workers);
 }
 
 auto NoiseLang::Image::SetFPS(float fps) -> void {
 	this->fps = fps;
+	// Frames paced differently would only blur the numbers for the new rate
+	this->stats.Clear();
 }
 
 auto NoiseLang::Image::GetFPS() -> float {
 	return this->fps;
 }
 
+auto NoiseLang::Image::GetFrameStats() -> NoiseLang::FrameSummary {
+	return this->stats.GetSummary();
+}
+
+auto NoiseLang::Image::SetStatsInTitle(bool statsInTitle) -> void {
+	this->statsInTitle = statsInTitle;
+}
+
+auto NoiseLang::Image::GetView() -> NoiseLang::View {
+	std::lock_guard<std::mutex> lock(this->viewMutex);
+	return this->view;
+}
+
+auto NoiseLang::Image::SetView(const NoiseLang::View& view) -> void {
+	std::lock_guard<std::mutex> lock(this->viewMutex);
+	this->view = view;
+}
+
+auto NoiseLang::Image::MoveZ(double dz) -> void {
+	std::lock_guard<std::mutex> lock(this->viewMutex);
+	this->view.z += dz;
+}
+
+auto NoiseLang::Image::IsPaused() -> bool {
+	return this->paused;
+}
+
+auto NoiseLang::Image::GetSize(unsigned int& width, unsigned int& height) -> void {
+	width = this->width;
+	height = this->height;
+}
+
 auto NoiseLang::Image::PollEvents() -> bool {
 	// https://wiki.libsdl.org/SDL_WindowEvent
 
-	SDL_PollEvent(&this->event);
+	bool polled = SDL_PollEvent(&this->event) != 0;
+
+	// Window titles belong to the thread that created the window, so they're set here rather than by the renderer
+	auto now = std::chrono::steady_clock::now();
+	if (this->statsInTitle && now - this->titleUpdated >= std::chrono::milliseconds(500)){
+		auto s = this->GetFrameStats();
+		std::ostringstream title;
+		title << std::fixed << std::setprecision(1) << "libnoise  " << s.fps << " fps  p50 " << s.p50 * 1000.0 << " p95 " << s.p95 * 1000.0 << " p99 " << s.p99 * 1000.0 << " ms  " << s.samplesPerSecond / 1e6 << " Msamples/s";
+		SDL_SetWindowTitle(this->window, title.str().c_str());
+		this->titleUpdated = now;
+		this->titleShowsStats = true;
+	} else if (!this->statsInTitle && this->titleShowsStats){
+		SDL_SetWindowTitle(this->window, "libnoise");
+		this->titleShowsStats = false;
+	}
+
+	// Without a new event, `event` still holds the last one, and a drag or scroll would repeat
+	if (!polled)
+		return true;
 
 	switch (this->event.type){
 
@@ -1012,6 +1336,48 @@ auto NoiseLang::Image::PollEvents() -> bool {
 			}
 			break;
 
+		// Dragging with the left button pans, the wheel zooms around the mouse
+		case SDL_MOUSEMOTION:
+			if (this->event.motion.state & SDL_BUTTON_LMASK){
+				std::lock_guard<std::mutex> lock(this->viewMutex);
+				this->view.Pan(this->event.motion.xrel, this->event.motion.yrel);
+			}
+			break;
+
+		case SDL_MOUSEWHEEL: {
+			int mouseX, mouseY;
+			SDL_GetMouseState(&mouseX, &mouseY);
+			int steps = this->event.wheel.direction == SDL_MOUSEWHEEL_FLIPPED ? -this->event.wheel.y : this->event.wheel.y;
+			std::lock_guard<std::mutex> lock(this->viewMutex);
+			this->view.Zoom(std::pow(1.25, steps), mouseX, mouseY);
+			break;
+		}
+
+		// Arrows pan a tile at a time, + and - zoom around the middle, 0 goes back to where the
+		// view started and space pauses z so panning can reuse the frame
+		case SDL_KEYDOWN: {
+			auto key = this->event.key.keysym.sym;
+			std::lock_guard<std::mutex> lock(this->viewMutex);
+			double pan = static_cast<double>(TileSize);
+			if (key == SDLK_LEFT)
+				this->view.Pan(pan, 0.0);
+			else if (key == SDLK_RIGHT)
+				this->view.Pan(-pan, 0.0);
+			else if (key == SDLK_UP)
+				this->view.Pan(0.0, pan);
+			else if (key == SDLK_DOWN)
+				this->view.Pan(0.0, -pan);
+			else if (key == SDLK_EQUALS || key == SDLK_PLUS || key == SDLK_KP_PLUS || key == SDLK_MINUS || key == SDLK_KP_MINUS)
+				this->view.Zoom(key == SDLK_MINUS || key == SDLK_KP_MINUS ? 0.8 : 1.25, this->width / 2.0, this->height / 2.0);
+			else if (key == SDLK_0){
+				double z = this->view.z;
+				this->view = NoiseLang::View();
+				this->view.z = z;
+			} else if (key == SDLK_SPACE)
+				this->paused = !this->paused;
+			break;
+		}
+
 	}
 	return true;
 }
@@ -1019,40 +1385,283 @@ auto NoiseLang::Image::PollEvents() -> bool {
 auto NoiseLang::Image::internal_render() -> void {
 	// Make this thread the owner of the opengl rendering context
 	SDL_GL_MakeCurrent(this->window, this->context);
-	this->renderer = SDL_CreateRenderer(this->window, -1, SDL_RENDERER_SOFTWARE);
+	this->renderer = SDL_CreateRenderer(this->window, -1, SDL_RENDERER_ACCELERATED);
+	if (this->renderer == nullptr)
+		this->renderer = SDL_CreateRenderer(this->window, -1, SDL_RENDERER_SOFTWARE);
 
-	std::chrono::high_resolution_clock timer;
+	// Frames are scheduled on a fixed grid of 1 / fps, so a short frame doesn't shift the ones after it
+	auto deadline = std::chrono::steady_clock::now();
+	auto previous = deadline;
 	while (this->rendering){
-		auto start = timer.now();
-
-		for (unsigned int x = 0; x < this->width; x++){
-			for (unsigned int y = 0; y < this->height; y++){
-				auto c = this->color(this->noiseSampler->GetValue(this->noiseX + this->scaleX(x), this->noiseY + this->scaleY(y), this->noiseZ));
-				
-				SDL_SetRenderDrawColor(this->renderer, c.r, c.g, c.b, c.a);
-				SDL_RenderDrawPoint(this->renderer, x, y);
-			}
+		std::unique_ptr<NoiseLang::Image::Frame> frame;
+		{
+			std::unique_lock<std::mutex> lock(this->pipelineMutex);
+			this->frameReady.wait(lock, [this]{ return !this->rendering || !this->readyFrames.empty(); });
+			if (!this->rendering)
+				break;
+			frame = std::move(this->readyFrames.front());
+			this->readyFrames.pop_front();
 		}
-		
-		// Force the renderer to show its changes in the window
+		auto start = std::chrono::steady_clock::now();
+
+		unsigned int width = frame->width;
+		unsigned int height = frame->height;
+
+		// The window may have been resized by PollEvents() since the last frame
+		if (width != this->textureWidth || height != this->textureHeight)
+			this->ResizeTexture(width, height);
+
+		std::atomic_load(&this->palette)->Apply(frame->samples.data(), this->framebuffer.data(), width, height);
+
+		// Hand the frame back before presenting, so the workers can start filling it again
+		double evaluation = frame->evaluation;
+		{
+			std::lock_guard<std::mutex> lock(this->pipelineMutex);
+			this->freeFrames.push_back(std::move(frame));
+		}
+		this->frameFree.notify_one();
+
+		// Upload the whole frame in one go and force the renderer to show it in the window
+		SDL_UpdateTexture(this->texture, nullptr, this->framebuffer.data(), width * 4);
+		SDL_RenderCopy(this->renderer, this->texture, nullptr, nullptr);
 		SDL_RenderPresent(this->renderer);
 
-		// Force the thread to wait up to the maximum length of a frame
-		//SDL_Delay(1000.0 / this->fps);
-		auto stop = timer.now();
-		double dt = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() / 1000.0;
-		this->OnRender(dt);
+		// Wait out the rest of the frame. A frame that ran late starts the grid again from now
+		// rather than rushing the next ones to catch up.
+		auto presented = std::chrono::steady_clock::now();
+		float fps = this->fps;
+		if (fps > 0.0f){
+			deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / fps));
+			if (deadline > presented)
+				std::this_thread::sleep_until(deadline);
+			else
+				deadline = presented;
+		} else {
+			deadline = presented;
+		}
+
+		// The stages overlap, so a frame costs whichever of them is slower
+		auto stop = std::chrono::steady_clock::now();
+		double busy = std::max(evaluation, std::chrono::duration<double>(presented - start).count());
+		this->stats.Record(busy, std::chrono::duration<double>(stop - previous).count(), static_cast<size_t>(width) * height);
+		previous = stop;
+	}
+}
+
+auto NoiseLang::Image::internal_evaluate() -> void {
+	auto previous = std::chrono::steady_clock::now();
+	while (this->rendering){
+		std::unique_ptr<NoiseLang::Image::Frame> frame;
+		{
+			std::unique_lock<std::mutex> lock(this->pipelineMutex);
+			this->frameFree.wait(lock, [this]{ return !this->rendering || !this->freeFrames.empty(); });
+			if (!this->rendering)
+				break;
+			frame = std::move(this->freeFrames.front());
+			this->freeFrames.pop_front();
+		}
+		auto start = std::chrono::steady_clock::now();
+
+		unsigned int width = this->width;
+		unsigned int height = this->height;
+		frame->width = width;
+		frame->height = height;
+		frame->samples.resize(static_cast<size_t>(width) * height);
+
+		auto workers = std::atomic_load(&this->workers);
+		if (workers == nullptr){
+			workers = std::make_shared<NoiseLang::WorkerPool>();
+			this->SetWorkerPool(workers);
+		}
+		if (this->scratch.size() < workers->GetThreadCount())
+			this->scratch.resize(workers->GetThreadCount());
+
+		// Pixel to world coordinates are the same for every tile, so only compute them once per frame
+		frame->view = this->GetView();
+		this->columns.resize(width);
+		this->rows.resize(height);
+		for (unsigned int x = 0; x < width; x++)
+			this->columns[x] = frame->view.GetX(x);
+		for (unsigned int y = 0; y < height; y++)
+			this->rows[y] = frame->view.GetY(y);
+
+		// Programs are snapshots, only modules the compiler couldn't lower still read the live graph
+		auto program = std::atomic_load(&this->program);
+		auto programKey = NoiseLang::TileKey::GetProgramKey(*program);
+		std::shared_lock<std::shared_mutex> graph_lock;
+		if (this->graphMutex != nullptr && !program->externals.empty())
+			graph_lock = std::shared_lock<std::shared_mutex>(*this->graphMutex);
+
+		// Whatever is left after reusing the last frame, cut into tiles for the workers
+		auto regions = this->ReusePrevious(*frame, frame->view, programKey);
+		bool cacheable = regions.size() == 1 && regions[0].x1 - regions[0].x0 == width && regions[0].y1 - regions[0].y0 == height;
+		bool still = frame->view.z == this->previous.view.z;
+		std::vector<NoiseLang::Image::Region> tiles;
+		for (auto& r : regions)
+			for (unsigned int y0 = r.y0; y0 < r.y1; y0 += TileSize)
+				for (unsigned int x0 = r.x0; x0 < r.x1; x0 += TileSize)
+					tiles.push_back(NoiseLang::Image::Region{x0, y0, std::min(x0 + TileSize, r.x1), std::min(y0 + TileSize, r.y1)});
+
+		workers->Run(tiles.size(), [&](size_t tile, unsigned int worker){
+			auto& t = tiles[tile];
+			this->render_tile(program, programKey, *frame, t.x0, t.y0, t.x1, t.y1, this->scratch[worker], cacheable, still);
+		});
+
+		if (graph_lock.owns_lock())
+			graph_lock.unlock();
+
+		this->previous.samples = frame->samples;
+		this->previous.width = width;
+		this->previous.height = height;
+		this->previous.view = frame->view;
+		this->previous.programKey = programKey;
+
+		frame->evaluation = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(this->pipelineMutex);
+			this->readyFrames.push_back(std::move(frame));
+		}
+		this->frameReady.notify_one();
+
+		// The next frame is picked as soon as this one is queued, not when it reaches the screen
+		auto now = std::chrono::steady_clock::now();
+		if (!this->paused)
+			this->OnRender(std::chrono::duration<double>(now - previous).count());
+		previous = now;
 	}
 }
 
+auto NoiseLang::Image::ReusePrevious(NoiseLang::Image::Frame& frame, const NoiseLang::View& view, std::uint64_t programKey) -> std::vector<NoiseLang::Image::Region> {
+	unsigned int width = frame.width, height = frame.height;
+	auto& p = this->previous;
+	std::vector<NoiseLang::Image::Region> regions;
+
+	long dx = 0, dy = 0;
+	bool reuse = p.programKey == programKey && p.width == width && p.height == height && p.samples.size() == frame.samples.size() && p.view.GetShift(view, dx, dy);
+	if (!reuse || std::labs(dx) >= static_cast<long>(width) || std::labs(dy) >= static_cast<long>(height)){
+		regions.push_back(NoiseLang::Image::Region{0, 0, width, height});
+		return regions;
+	}
+
+	// Pixel (x, y) now shows what (x + dx, y + dy) showed, so rows and columns keep whichever
+	// part of them is still on screen
+	unsigned int keptX0 = dx < 0 ? static_cast<unsigned int>(-dx) : 0;
+	unsigned int keptX1 = dx > 0 ? width - static_cast<unsigned int>(dx) : width;
+	unsigned int keptY0 = dy < 0 ? static_cast<unsigned int>(-dy) : 0;
+	unsigned int keptY1 = dy > 0 ? height - static_cast<unsigned int>(dy) : height;
+	for (unsigned int y = keptY0; y < keptY1; y++)
+		std::copy_n(&p.samples[static_cast<size_t>(static_cast<long>(y) + dy) * width + static_cast<size_t>(static_cast<long>(keptX0) + dx)], keptX1 - keptX0, &frame.samples[static_cast<size_t>(y) * width + keptX0]);
+
+	// The rows exposed above or below at full width, then the columns beside the kept rows
+	if (keptY0 > 0)
+		regions.push_back(NoiseLang::Image::Region{0, 0, width, keptY0});
+	if (keptY1 < height)
+		regions.push_back(NoiseLang::Image::Region{0, keptY1, width, height});
+	if (keptX0 > 0)
+		regions.push_back(NoiseLang::Image::Region{0, keptY0, keptX0, keptY1});
+	if (keptX1 < width)
+		regions.push_back(NoiseLang::Image::Region{keptX1, keptY0, width, keptY1});
+	return regions;
+}
+
+auto NoiseLang::Image::render_tile(const std::shared_ptr<const NoiseLang::Program>& program, std::uint64_t programKey, NoiseLang::Image::Frame& frame, unsigned int x0, unsigned int y0, unsigned int x1, unsigned int y1, NoiseLang::Image::TileScratch& scratch, bool cacheable, bool still) -> void {
+	unsigned int tileWidth = x1 - x0;
+	unsigned int tileHeight = y1 - y0;
+	unsigned int width = frame.width;
+
+	// Tiles are keyed by where they are in the world rather than on screen
+	auto cache = cacheable ? std::atomic_load(&this->cache) : nullptr;
+	auto key = NoiseLang::TileKey{programKey, this->columns[x0], this->columns[x1 - 1], this->rows[y0], this->rows[y1 - 1], frame.view.z, tileWidth, tileHeight};
+	NoiseLang::TileCache::Tile cached = cache != nullptr ? cache->Find(key) : nullptr;
+
+	if (cached == nullptr){
+		size_t count = static_cast<size_t>(tileWidth) * tileHeight;
+		scratch.xs.resize(count);
+		scratch.ys.resize(count);
+		scratch.zs.assign(count, key.z);
+		scratch.values.resize(count);
+		scratch.tile.resize(count);
+		for (unsigned int y = y0; y < y1; y++){
+			std::copy(&this->columns[x0], &this->columns[x0] + tileWidth, &scratch.xs[static_cast<size_t>(y - y0) * tileWidth]);
+			std::fill_n(&scratch.ys[static_cast<size_t>(y - y0) * tileWidth], tileWidth, this->rows[y]);
+		}
+
+		auto nodeCache = cacheable && still ? std::atomic_load(&this->nodeCache) : nullptr;
+		if (nodeCache != nullptr && nodeCache->GetCapacity() > 0){
+			// Whatever an edit left alone is still cached under its old node hash
+			size_t instructions = program->code.size();
+			scratch.nodes.reuse.assign(instructions, nullptr);
+			scratch.nodes.record.assign(instructions, nullptr);
+			scratch.reused.clear();
+			scratch.recorded.resize(instructions);
+
+			auto nodeKey = key;
+			for (size_t i = 0; i < instructions; i++){
+				if (program->nodeHashes[i] == 0 || program->code[i].op == NoiseLang::OpCode::Const)
+					continue;
+				nodeKey.program = program->nodeHashes[i];
+				if (auto buffer = nodeCache->Find(nodeKey)){
+					scratch.nodes.reuse[i] = buffer->data();
+					scratch.reused.push_back(std::move(buffer));
+				} else {
+					scratch.recorded[i].resize(count * (NoiseLang::IsTransform(program->code[i].op) ? 3 : 1));
+					scratch.nodes.record[i] = scratch.recorded[i].data();
+				}
+			}
+
+			scratch.evaluator.Evaluate(*program, scratch.xs.data(), scratch.ys.data(), scratch.zs.data(), scratch.values.data(), count, scratch.nodes, frame.view.scale);
+
+			for (size_t i = 0; i < instructions; i++){
+				if (scratch.nodes.record[i] == nullptr)
+					continue;
+				// Copied in, so the worker's buffer is kept for the next tile
+				nodeKey.program = program->nodeHashes[i];
+				nodeCache->Insert(nodeKey, scratch.recorded[i]);
+			}
+			scratch.reused.clear();
+		} else {
+			scratch.evaluator.Evaluate(*program, scratch.xs.data(), scratch.ys.data(), scratch.zs.data(), scratch.values.data(), count, frame.view.scale);
+		}
+
+		for (size_t i = 0; i < count; i++)
+			scratch.tile[i] = static_cast<float>(scratch.values[i]);
+	}
+
+	// Colors are left to the render thread, which converts the whole frame while the next one evaluates
+	const float* values = cached != nullptr ? cached->data() : scratch.tile.data();
+	for (unsigned int y = y0; y < y1; y++)
+		std::copy_n(&values[static_cast<size_t>(y - y0) * tileWidth], tileWidth, &frame.samples[static_cast<size_t>(y) * width + x0]);
+
+	if (cached == nullptr && cache != nullptr)
+		cache->Insert(key, scratch.tile, program);
+}
+
+auto NoiseLang::Image::ResizeTexture(unsigned int width, unsigned int height) -> void {
+	// Streaming textures can't change size, so a resize means a new texture
+	if (this->texture != nullptr)
+		SDL_DestroyTexture(this->texture);
+
+	this->texture = SDL_CreateTexture(this->renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+	this->framebuffer.assign(static_cast<size_t>(width) * height * 4, 0);
+	this->textureWidth = width;
+	this->textureHeight = height;
+}
+
 auto NoiseLang::Image::StartRenderer() -> void {
 	if (this->window != nullptr){
-		if (this->noiseSampler != nullptr){
-			// create rendering thread
+		if (this->program != nullptr){
+			// Every frame starts out free, the workers evaluate into them and the render thread presents them
+			this->readyFrames.clear();
+			this->freeFrames.clear();
+			for (size_t i = 0; i <= PipelineDepth; i++)
+				this->freeFrames.push_back(std::make_unique<NoiseLang::Image::Frame>());
+
+			// create the rendering and evaluation threads
 			this->rendering = true;
 			this->thread = std::thread(&NoiseLang::Image::internal_render, this);
+			this->evaluator = std::thread(&NoiseLang::Image::internal_evaluate, this);
 		} else {
-			std::cout << "Internal noiseSampler has not been initialized, please call Image::SetSampler() with a std::shared_ptr<noise::module::Module> before calling Image::StartRenderer()" << std::endl;
+			std::cout << "Internal program has not been initialized, please call Image::SetSampler() or Image::SetProgram() before calling Image::StartRenderer()" << std::endl;
 		}
 	} else {
 		std::cout << "SDL has not been initialized, please initialize SDL before calling Image::StartRenderer()" << std::endl;
@@ -1061,9 +1670,15 @@ auto NoiseLang::Image::StartRenderer() -> void {
 
 auto NoiseLang::Image::StopRenderer() -> void {
 	if (this->rendering){
-		// stop the thread and wait for it to join
-		this->rendering = false;
+		// stop both threads, waking whichever is waiting on the other, and wait for them to join
+		{
+			std::lock_guard<std::mutex> lock(this->pipelineMutex);
+			this->rendering = false;
+		}
+		this->frameReady.notify_all();
+		this->frameFree.notify_all();
 		this->thread.join();
+		this->evaluator.join();
 		this->is_dead = true;
 	}
 }
@@ -1071,3 +1686,4 @@ auto NoiseLang::Image::StopRenderer() -> void {
 auto NoiseLang::Image::IsDead() -> bool {
 	return this->is_dead;
 }
+#endif
@@ -0,0 +1,1159 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vendor/include/noise/noise.h"
+#include "vendor/include/noise/interp.h"
+#include "vendor/include/noise/mathconsts.h"
+
+namespace noise {
+
+	// Defined in libnoise (vectortable.h), which can't be included twice
+	extern double g_randomVectors[256 * 4];
+
+}
+
+namespace NoiseLang {
+
+	// Every module kind the interpreter can construct (see NoiseLangRegistry.hpp)
+	enum class ModuleKind {
+		Abs, Add, Billow, Blend, Cache, Checkerboard, Clamp, Const, Curve, Cylinders,
+		Displace, Exponent, Invert, Max, Min, Multiply, Perlin, Power, RidgedMulti, RotatePoint,
+		ScaleBias, ScalePoint, Select, Spheres, Terrace, TranslatePoint, Turbulence, Voronoi,
+		Unknown
+	};
+
+	auto GetModuleKind(const noise::module::Module& module) -> ModuleKind;
+	auto GetModuleKindName(ModuleKind kind) -> std::string;
+
+	// A regular grid of sample points on a single z-slice, in world space
+	class PointGrid {
+		public:
+			double originX, originY, z;
+			double stepX, stepY;
+			unsigned int width, height;
+
+			PointGrid(double originX, double originY, double z, double stepX, double stepY, unsigned int width, unsigned int height){
+				this->originX = originX;
+				this->originY = originY;
+				this->z = z;
+				this->stepX = stepX;
+				this->stepY = stepY;
+				this->width = width;
+				this->height = height;
+			}
+	};
+
+	// Array kernels, one per module kind. Each one reproduces the arithmetic of the
+	// matching libnoise GetValue() exactly, so block and scalar results are identical.
+	namespace Kernels {
+
+		// libnoise keeps a few derived values protected; these give read access to them
+		struct RidgedMultiAccess : noise::module::RidgedMulti {
+			static auto SpectralWeights(const noise::module::RidgedMulti& m) -> const double* {
+				return m.*(&RidgedMultiAccess::m_pSpectralWeights);
+			}
+		};
+
+		struct RotatePointAccess : noise::module::RotatePoint {
+			static auto Matrix(const noise::module::RotatePoint& m, double* matrix) -> void {
+				matrix[0] = m.*(&RotatePointAccess::m_x1Matrix);
+				matrix[1] = m.*(&RotatePointAccess::m_y1Matrix);
+				matrix[2] = m.*(&RotatePointAccess::m_z1Matrix);
+				matrix[3] = m.*(&RotatePointAccess::m_x2Matrix);
+				matrix[4] = m.*(&RotatePointAccess::m_y2Matrix);
+				matrix[5] = m.*(&RotatePointAccess::m_z2Matrix);
+				matrix[6] = m.*(&RotatePointAccess::m_x3Matrix);
+				matrix[7] = m.*(&RotatePointAccess::m_y3Matrix);
+				matrix[8] = m.*(&RotatePointAccess::m_z3Matrix);
+			}
+		};
+
+		struct TurbulenceAccess : noise::module::Turbulence {
+			static auto DistortModule(const noise::module::Turbulence& m, int axis) -> const noise::module::Perlin& {
+				switch (axis){
+					case 0: return m.*(&TurbulenceAccess::m_xDistortModule);
+					case 1: return m.*(&TurbulenceAccess::m_yDistortModule);
+					default: return m.*(&TurbulenceAccess::m_zDistortModule);
+				}
+			}
+		};
+
+		// {{{ Coherent noise
+		// Inline copies of libnoise's noisegen.cpp. The library's versions can't be inlined
+		// across the archive, so every octave paid for two calls; these are bit-identical.
+		// The hash runs on unsigned ints, libnoise relies on signed overflow wrapping.
+		inline auto GradientNoise3D(double fx, double fy, double fz, int ix, int iy, int iz, int seed) -> double {
+			std::uint32_t hash = 1619u * static_cast<std::uint32_t>(ix) + 31337u * static_cast<std::uint32_t>(iy) + 6971u * static_cast<std::uint32_t>(iz) + 1013u * static_cast<std::uint32_t>(seed);
+			std::uint32_t vectorIndex = (hash ^ (hash >> 8)) & 0xff;
+
+			const double* gradient = &noise::g_randomVectors[vectorIndex << 2];
+			return ((gradient[0] * (fx - static_cast<double>(ix))) + (gradient[1] * (fy - static_cast<double>(iy))) + (gradient[2] * (fz - static_cast<double>(iz)))) * 2.12;
+		}
+
+		inline auto GradientCoherentNoise3D(double x, double y, double z, int seed, noise::NoiseQuality quality) -> double {
+			int x0 = (x > 0.0 ? static_cast<int>(x) : static_cast<int>(x) - 1);
+			int y0 = (y > 0.0 ? static_cast<int>(y) : static_cast<int>(y) - 1);
+			int z0 = (z > 0.0 ? static_cast<int>(z) : static_cast<int>(z) - 1);
+			int x1 = x0 + 1;
+			int y1 = y0 + 1;
+			int z1 = z0 + 1;
+
+			double xs = 0, ys = 0, zs = 0;
+			switch (quality){
+				case noise::QUALITY_FAST:
+					xs = (x - static_cast<double>(x0));
+					ys = (y - static_cast<double>(y0));
+					zs = (z - static_cast<double>(z0));
+					break;
+				case noise::QUALITY_STD:
+					xs = noise::SCurve3(x - static_cast<double>(x0));
+					ys = noise::SCurve3(y - static_cast<double>(y0));
+					zs = noise::SCurve3(z - static_cast<double>(z0));
+					break;
+				case noise::QUALITY_BEST:
+					xs = noise::SCurve5(x - static_cast<double>(x0));
+					ys = noise::SCurve5(y - static_cast<double>(y0));
+					zs = noise::SCurve5(z - static_cast<double>(z0));
+					break;
+			}
+
+			double n0, n1, ix0, ix1, iy0, iy1;
+			n0 = Kernels::GradientNoise3D(x, y, z, x0, y0, z0, seed);
+			n1 = Kernels::GradientNoise3D(x, y, z, x1, y0, z0, seed);
+			ix0 = noise::LinearInterp(n0, n1, xs);
+			n0 = Kernels::GradientNoise3D(x, y, z, x0, y1, z0, seed);
+			n1 = Kernels::GradientNoise3D(x, y, z, x1, y1, z0, seed);
+			ix1 = noise::LinearInterp(n0, n1, xs);
+			iy0 = noise::LinearInterp(ix0, ix1, ys);
+			n0 = Kernels::GradientNoise3D(x, y, z, x0, y0, z1, seed);
+			n1 = Kernels::GradientNoise3D(x, y, z, x1, y0, z1, seed);
+			ix0 = noise::LinearInterp(n0, n1, xs);
+			n0 = Kernels::GradientNoise3D(x, y, z, x0, y1, z1, seed);
+			n1 = Kernels::GradientNoise3D(x, y, z, x1, y1, z1, seed);
+			ix1 = noise::LinearInterp(n0, n1, xs);
+			iy1 = noise::LinearInterp(ix0, ix1, ys);
+
+			return noise::LinearInterp(iy0, iy1, zs);
+		}
+
+		inline auto ValueNoise3D(int x, int y, int z, int seed = 0) -> double {
+			std::uint32_t n = (1619u * static_cast<std::uint32_t>(x) + 31337u * static_cast<std::uint32_t>(y) + 6971u * static_cast<std::uint32_t>(z) + 1013u * static_cast<std::uint32_t>(seed)) & 0x7fffffff;
+			n = (n >> 13) ^ n;
+			n = (n * (n * n * 60493u + 19990303u) + 1376312589u) & 0x7fffffff;
+			return 1.0 - (static_cast<double>(n) / 1073741824.0);
+		}
+		// }}}
+
+		// {{{ Generators
+		// What an octave of billow adds on average, and each octave of ridgedmulti, weighted by the
+		// octaves before it. Measured once per quality over a fixed spread of points, so level of
+		// detail can put back what the octaves it drops would have added.
+		class OctaveMeans {
+			public:
+				double billow;
+				double ridged[noise::module::RIDGED_MAX_OCTAVE];
+		};
+
+		inline auto MeasureOctaveMeans(noise::NoiseQuality quality) -> OctaveMeans {
+			const int points = 4096;
+			auto means = OctaveMeans{};
+			for (int i = 0; i < points; i++){
+				// A low discrepancy sequence over a thousand cells a side
+				double x = 1000.0 * std::fmod(0.5 + i * 0.8191725134, 1.0);
+				double y = 1000.0 * std::fmod(0.5 + i * 0.6710436067, 1.0);
+				double z = 1000.0 * std::fmod(0.5 + i * 0.5497004779, 1.0);
+				means.billow += 2.0 * std::fabs(Kernels::GradientCoherentNoise3D(x, y, z, i, quality)) - 1.0;
+
+				// RidgedMulti's octave loop without the spectral weights
+				double weight = 1.0;
+				for (int octave = 0; octave < noise::module::RIDGED_MAX_OCTAVE; octave++){
+					double signal = 1.0 - std::fabs(Kernels::GradientCoherentNoise3D(noise::MakeInt32Range(x), noise::MakeInt32Range(y), noise::MakeInt32Range(z), i + octave, quality));
+					signal *= signal * weight;
+					weight = std::clamp(signal * 2.0, 0.0, 1.0);
+					means.ridged[octave] += signal;
+					x *= 2.0;
+					y *= 2.0;
+					z *= 2.0;
+				}
+			}
+
+			means.billow /= points;
+			for (double& ridged : means.ridged)
+				ridged /= points;
+			return means;
+		}
+
+		// Measured on first use, about 10 ms for each quality
+		inline auto GetOctaveMeans(noise::NoiseQuality quality) -> const OctaveMeans& {
+			switch (quality){
+				case noise::QUALITY_FAST: {
+					static const auto fast = MeasureOctaveMeans(noise::QUALITY_FAST);
+					return fast;
+				}
+				case noise::QUALITY_BEST: {
+					static const auto best = MeasureOctaveMeans(noise::QUALITY_BEST);
+					return best;
+				}
+				default: {
+					static const auto standard = MeasureOctaveMeans(noise::QUALITY_STD);
+					return standard;
+				}
+			}
+		}
+
+		// The fractal generators weight their last octave by `fade`, so level of detail can fade an
+		// octave out before dropping it. At 1 they match libnoise exactly.
+		inline auto Perlin(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, double persistence, int octaves, int seed, noise::NoiseQuality quality, double fade = 1.0) -> void {
+			for (size_t i = 0; i < count; i++){
+				double value = 0.0;
+				double curPersistence = 1.0;
+				double px = x[i] * frequency;
+				double py = y[i] * frequency;
+				double pz = z[i] * frequency;
+
+				for (int octave = 0; octave < octaves; octave++){
+					double nx = noise::MakeInt32Range(px);
+					double ny = noise::MakeInt32Range(py);
+					double nz = noise::MakeInt32Range(pz);
+					int octaveSeed = (seed + octave) & 0xffffffff;
+					double signal = Kernels::GradientCoherentNoise3D(nx, ny, nz, octaveSeed, quality);
+					if (octave == octaves - 1)
+						signal *= fade;
+					value += signal * curPersistence;
+
+					px *= lacunarity;
+					py *= lacunarity;
+					pz *= lacunarity;
+					curPersistence *= persistence;
+				}
+
+				out[i] = value;
+			}
+		}
+
+		inline auto Billow(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, double persistence, int octaves, int seed, noise::NoiseQuality quality, double fade = 1.0) -> void {
+			for (size_t i = 0; i < count; i++){
+				double value = 0.0;
+				double curPersistence = 1.0;
+				double px = x[i] * frequency;
+				double py = y[i] * frequency;
+				double pz = z[i] * frequency;
+
+				for (int octave = 0; octave < octaves; octave++){
+					double nx = noise::MakeInt32Range(px);
+					double ny = noise::MakeInt32Range(py);
+					double nz = noise::MakeInt32Range(pz);
+					int octaveSeed = (seed + octave) & 0xffffffff;
+					double signal = Kernels::GradientCoherentNoise3D(nx, ny, nz, octaveSeed, quality);
+					signal = 2.0 * std::fabs(signal) - 1.0;
+					if (octave == octaves - 1)
+						signal *= fade;
+					value += signal * curPersistence;
+
+					px *= lacunarity;
+					py *= lacunarity;
+					pz *= lacunarity;
+					curPersistence *= persistence;
+				}
+
+				out[i] = value + 0.5;
+			}
+		}
+
+		inline auto RidgedMulti(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, int octaves, int seed, noise::NoiseQuality quality, const double* spectralWeights, double fade = 1.0) -> void {
+			const double offset = 1.0;
+			const double gain = 2.0;
+
+			for (size_t i = 0; i < count; i++){
+				double value = 0.0;
+				double weight = 1.0;
+				double px = x[i] * frequency;
+				double py = y[i] * frequency;
+				double pz = z[i] * frequency;
+
+				for (int octave = 0; octave < octaves; octave++){
+					double nx = noise::MakeInt32Range(px);
+					double ny = noise::MakeInt32Range(py);
+					double nz = noise::MakeInt32Range(pz);
+					int octaveSeed = (seed + octave) & 0x7fffffff;
+					double signal = Kernels::GradientCoherentNoise3D(nx, ny, nz, octaveSeed, quality);
+
+					signal = std::fabs(signal);
+					signal = offset - signal;
+					signal *= signal;
+					signal *= weight;
+
+					weight = signal * gain;
+					if (weight > 1.0) weight = 1.0;
+					if (weight < 0.0) weight = 0.0;
+
+					if (octave == octaves - 1)
+						signal *= fade;
+					value += (signal * spectralWeights[octave]);
+
+					px *= lacunarity;
+					py *= lacunarity;
+					pz *= lacunarity;
+				}
+
+				out[i] = (value * 1.25) - 1.0;
+			}
+		}
+
+		// libnoise's Voronoi::GetValue() for one point, hashing the seed points of all 125 cells around it
+		inline auto VoronoiPoint(double px, double py, double pz, double& xCandidate, double& yCandidate, double& zCandidate, int seed) -> void {
+			int xInt = (px > 0.0 ? static_cast<int>(px) : static_cast<int>(px) - 1);
+			int yInt = (py > 0.0 ? static_cast<int>(py) : static_cast<int>(py) - 1);
+			int zInt = (pz > 0.0 ? static_cast<int>(pz) : static_cast<int>(pz) - 1);
+
+			double minDist = 2147483647.0;
+			xCandidate = yCandidate = zCandidate = 0;
+
+			for (int zCur = zInt - 2; zCur <= zInt + 2; zCur++){
+				for (int yCur = yInt - 2; yCur <= yInt + 2; yCur++){
+					for (int xCur = xInt - 2; xCur <= xInt + 2; xCur++){
+						double xPos = xCur + Kernels::ValueNoise3D(xCur, yCur, zCur, seed);
+						double yPos = yCur + Kernels::ValueNoise3D(xCur, yCur, zCur, seed + 1);
+						double zPos = zCur + Kernels::ValueNoise3D(xCur, yCur, zCur, seed + 2);
+						double xDist = xPos - px;
+						double yDist = yPos - py;
+						double zDist = zPos - pz;
+						double dist = xDist * xDist + yDist * yDist + zDist * zDist;
+
+						if (dist < minDist){
+							minDist = dist;
+							xCandidate = xPos;
+							yCandidate = yPos;
+							zCandidate = zPos;
+						}
+					}
+				}
+			}
+		}
+
+		// What Voronoi::GetValue() returns once the nearest seed point is known
+		inline auto VoronoiValue(double px, double py, double pz, double xCandidate, double yCandidate, double zCandidate, double displacement, bool enableDistance) -> double {
+			double value;
+			if (enableDistance){
+				double xDist = xCandidate - px;
+				double yDist = yCandidate - py;
+				double zDist = zCandidate - pz;
+				value = (std::sqrt(xDist * xDist + yDist * yDist + zDist * zDist)) * noise::SQRT_3 - 1.0;
+			} else {
+				value = 0.0;
+			}
+
+			return value + (displacement * static_cast<double>(Kernels::ValueNoise3D(
+				static_cast<int>(std::floor(xCandidate)),
+				static_cast<int>(std::floor(yCandidate)),
+				static_cast<int>(std::floor(zCandidate)))));
+		}
+
+		// Most cells around one point are around its neighbours too, so a block hashes the seed
+		// point of every cell in the box its samples reach once, then searches the samples of each
+		// cell together. Blocks spread over more cells than this, or over more than
+		// VoronoiCellsPerSample each, are cheaper point by point.
+		const size_t VoronoiMaxCells = 16384;
+		const size_t VoronoiCellsPerSample = 32;
+
+		// Samples of one cell searched at a time
+		const size_t VoronoiLanes = 64;
+
+		inline auto Voronoi(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double displacement, bool enableDistance, int seed) -> void {
+			thread_local std::vector<int> cells;
+			thread_local std::vector<double> seeds;
+			thread_local std::vector<std::uint32_t> order, starts;
+			cells.resize(count * 3);
+
+			// The cell each sample sits in, and the box of cells within 2 of any of them
+			int low[3] = {std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+			int high[3] = {std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+			for (size_t i = 0; i < count; i++){
+				double p[3] = {x[i] * frequency, y[i] * frequency, z[i] * frequency};
+				for (int axis = 0; axis < 3; axis++){
+					int cell = (p[axis] > 0.0 ? static_cast<int>(p[axis]) : static_cast<int>(p[axis]) - 1);
+					cells[i * 3 + axis] = cell;
+					low[axis] = std::min(low[axis], cell);
+					high[axis] = std::max(high[axis], cell);
+				}
+			}
+
+			// Each axis is checked on its own first, a block billions of cells wide on two axes would
+			// overflow their product
+			std::int64_t size[3];
+			std::int64_t maxCells = static_cast<std::int64_t>(std::min(VoronoiMaxCells, count * VoronoiCellsPerSample));
+			bool oversized = false;
+			for (int axis = 0; axis < 3; axis++){
+				size[axis] = count > 0 ? static_cast<std::int64_t>(high[axis]) - low[axis] + 5 : 0;
+				oversized = oversized || size[axis] > maxCells;
+			}
+			std::int64_t boxCells = oversized ? 0 : size[0] * size[1] * size[2];
+
+			if (count < 2 || oversized || boxCells > maxCells){
+				for (size_t i = 0; i < count; i++){
+					double px = x[i] * frequency, py = y[i] * frequency, pz = z[i] * frequency;
+					double xCandidate, yCandidate, zCandidate;
+					Kernels::VoronoiPoint(px, py, pz, xCandidate, yCandidate, zCandidate, seed);
+					out[i] = Kernels::VoronoiValue(px, py, pz, xCandidate, yCandidate, zCandidate, displacement, enableDistance);
+				}
+				return;
+			}
+
+			// Seed points as three planes, x fastest
+			size_t plane = static_cast<size_t>(boxCells);
+			seeds.resize(plane * 3);
+			double* sx = seeds.data();
+			double* sy = sx + plane;
+			double* sz = sy + plane;
+			size_t k = 0;
+			for (int zCur = low[2] - 2; zCur <= high[2] + 2; zCur++){
+				for (int yCur = low[1] - 2; yCur <= high[1] + 2; yCur++){
+					for (int xCur = low[0] - 2; xCur <= high[0] + 2; xCur++, k++){
+						sx[k] = xCur + Kernels::ValueNoise3D(xCur, yCur, zCur, seed);
+						sy[k] = yCur + Kernels::ValueNoise3D(xCur, yCur, zCur, seed + 1);
+						sz[k] = zCur + Kernels::ValueNoise3D(xCur, yCur, zCur, seed + 2);
+					}
+				}
+			}
+
+			// Samples ordered by the box index of the cell 2 below theirs on every axis, the first
+			// of the 125 they search, so the samples of a cell are next to each other
+			auto corner = [&](size_t i){
+				return static_cast<std::uint32_t>(((static_cast<std::int64_t>(cells[i * 3 + 2]) - low[2]) * size[1] + (cells[i * 3 + 1] - low[1])) * size[0] + (cells[i * 3] - low[0]));
+			};
+			starts.assign(plane + 1, 0);
+			order.resize(count);
+			for (size_t i = 0; i < count; i++)
+				starts[corner(i) + 1]++;
+			for (size_t c = 0; c < plane; c++)
+				starts[c + 1] += starts[c];
+			for (size_t i = 0; i < count; i++)
+				order[starts[corner(i)]++] = static_cast<std::uint32_t>(i);
+
+			size_t row = static_cast<size_t>(size[0]), layer = static_cast<size_t>(size[0] * size[1]);
+			for (size_t first = 0; first < count;){
+				size_t base = corner(order[first]);
+				size_t lanes = 1;
+				while (lanes < VoronoiLanes && first + lanes < count && corner(order[first + lanes]) == base)
+					lanes++;
+
+				double px[VoronoiLanes], py[VoronoiLanes], pz[VoronoiLanes];
+				double best[VoronoiLanes], nearest[VoronoiLanes];
+				double lowest[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()};
+				double highest[3] = {std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest(), std::numeric_limits<double>::lowest()};
+				for (size_t j = 0; j < lanes; j++){
+					size_t i = order[first + j];
+					px[j] = x[i] * frequency;
+					py[j] = y[i] * frequency;
+					pz[j] = z[i] * frequency;
+					best[j] = 2147483647.0;
+					nearest[j] = 0.0;
+					lowest[0] = std::min(lowest[0], px[j]);
+					lowest[1] = std::min(lowest[1], py[j]);
+					lowest[2] = std::min(lowest[2], pz[j]);
+					highest[0] = std::max(highest[0], px[j]);
+					highest[1] = std::max(highest[1], py[j]);
+					highest[2] = std::max(highest[2], pz[j]);
+				}
+
+				// No lane's nearest seed point is further than its own cell's. A cell whose seed point
+				// is further than that from the box around the lanes can't be nearest to any of them,
+				// and skipping it leaves the first of the nearest where the full scan would find it.
+				size_t own = base + 2 * layer + 2 * row + 2;
+				double reach = 0.0;
+				for (size_t j = 0; j < lanes; j++){
+					double xDist = sx[own] - px[j];
+					double yDist = sy[own] - py[j];
+					double zDist = sz[own] - pz[j];
+					reach = std::max(reach, xDist * xDist + yDist * yDist + zDist * zDist);
+				}
+				auto gap = [&lowest, &highest](int axis, double position){
+					double d = std::max(std::max(lowest[axis] - position, position - highest[axis]), 0.0);
+					return d * d;
+				};
+
+				for (size_t zOffset = 0; zOffset < 5; zOffset++){
+					for (size_t yOffset = 0; yOffset < 5; yOffset++){
+						for (size_t xOffset = 0; xOffset < 5; xOffset++){
+							size_t c = base + zOffset * layer + yOffset * row + xOffset;
+							if ((gap(0, sx[c]) + gap(1, sy[c])) + gap(2, sz[c]) > reach)
+								continue;
+
+							// The same arithmetic and the same strict `<` as VoronoiPoint(), a lane at a time
+							double cx = sx[c], cy = sy[c], cz = sz[c], index = static_cast<double>(c);
+							for (size_t j = 0; j < lanes; j++){
+								double xDist = cx - px[j];
+								double yDist = cy - py[j];
+								double zDist = cz - pz[j];
+								double dist = xDist * xDist + yDist * yDist + zDist * zDist;
+								bool closer = dist < best[j];
+								best[j] = closer ? dist : best[j];
+								nearest[j] = closer ? index : nearest[j];
+							}
+						}
+					}
+				}
+
+				for (size_t j = 0; j < lanes; j++){
+					size_t c = static_cast<size_t>(nearest[j]);
+					out[order[first + j]] = Kernels::VoronoiValue(px[j], py[j], pz[j], sx[c], sy[c], sz[c], displacement, enableDistance);
+				}
+				first += lanes;
+			}
+		}
+
+		inline auto Cylinders(const double* x, const double* z, double* out, size_t count, double frequency) -> void {
+			for (size_t i = 0; i < count; i++){
+				double px = x[i] * frequency;
+				double pz = z[i] * frequency;
+
+				double distFromCenter = std::sqrt(px * px + pz * pz);
+				double distFromSmallerSphere = distFromCenter - std::floor(distFromCenter);
+				double distFromLargerSphere = 1.0 - distFromSmallerSphere;
+				double nearestDist = noise::GetMin(distFromSmallerSphere, distFromLargerSphere);
+				out[i] = 1.0 - (nearestDist * 4.0);
+			}
+		}
+
+		inline auto Spheres(const double* x, const double* y, const double* z, double* out, size_t count, double frequency) -> void {
+			for (size_t i = 0; i < count; i++){
+				double px = x[i] * frequency;
+				double py = y[i] * frequency;
+				double pz = z[i] * frequency;
+
+				double distFromCenter = std::sqrt(px * px + py * py + pz * pz);
+				double distFromSmallerSphere = distFromCenter - std::floor(distFromCenter);
+				double distFromLargerSphere = 1.0 - distFromSmallerSphere;
+				double nearestDist = noise::GetMin(distFromSmallerSphere, distFromLargerSphere);
+				out[i] = 1.0 - (nearestDist * 4.0);
+			}
+		}
+
+		inline auto Checkerboard(const double* x, const double* y, const double* z, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++){
+				int ix = static_cast<int>(std::floor(noise::MakeInt32Range(x[i])));
+				int iy = static_cast<int>(std::floor(noise::MakeInt32Range(y[i])));
+				int iz = static_cast<int>(std::floor(noise::MakeInt32Range(z[i])));
+				out[i] = ((ix & 1) ^ (iy & 1) ^ (iz & 1)) ? -1.0 : 1.0;
+			}
+		}
+
+		inline auto Const(double* out, size_t count, double value) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = value;
+		}
+		// }}}
+
+		// {{{ Modifiers and combiners
+		inline auto Abs(const double* a, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = std::fabs(a[i]);
+		}
+
+		inline auto Invert(const double* a, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = -a[i];
+		}
+
+		inline auto Clamp(const double* a, double* out, size_t count, double lowerBound, double upperBound) -> void {
+			for (size_t i = 0; i < count; i++){
+				double value = a[i];
+				if (value < lowerBound)
+					out[i] = lowerBound;
+				else if (value > upperBound)
+					out[i] = upperBound;
+				else
+					out[i] = value;
+			}
+		}
+
+		inline auto ScaleBias(const double* a, double* out, size_t count, double scale, double bias) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = a[i] * scale + bias;
+		}
+
+		inline auto Exponent(const double* a, double* out, size_t count, double exponent) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = (std::pow(std::fabs((a[i] + 1.0) / 2.0), exponent) * 2.0 - 1.0);
+		}
+
+		inline auto Curve(const double* a, double* out, size_t count, const noise::module::ControlPoint* points, int pointCount) -> void {
+			assert(pointCount >= 4);
+
+			for (size_t i = 0; i < count; i++){
+				double sourceValue = a[i];
+
+				int indexPos;
+				for (indexPos = 0; indexPos < pointCount; indexPos++){
+					if (sourceValue < points[indexPos].inputValue)
+						break;
+				}
+
+				int index0 = noise::ClampValue(indexPos - 2, 0, pointCount - 1);
+				int index1 = noise::ClampValue(indexPos - 1, 0, pointCount - 1);
+				int index2 = noise::ClampValue(indexPos    , 0, pointCount - 1);
+				int index3 = noise::ClampValue(indexPos + 1, 0, pointCount - 1);
+
+				if (index1 == index2){
+					out[i] = points[index1].outputValue;
+					continue;
+				}
+
+				double input0 = points[index1].inputValue;
+				double input1 = points[index2].inputValue;
+				double alpha = (sourceValue - input0) / (input1 - input0);
+
+				out[i] = noise::CubicInterp(points[index0].outputValue, points[index1].outputValue, points[index2].outputValue, points[index3].outputValue, alpha);
+			}
+		}
+
+		inline auto Terrace(const double* a, double* out, size_t count, const double* points, int pointCount, bool invert) -> void {
+			assert(pointCount >= 2);
+
+			for (size_t i = 0; i < count; i++){
+				double sourceValue = a[i];
+
+				int indexPos;
+				for (indexPos = 0; indexPos < pointCount; indexPos++){
+					if (sourceValue < points[indexPos])
+						break;
+				}
+
+				int index0 = noise::ClampValue(indexPos - 1, 0, pointCount - 1);
+				int index1 = noise::ClampValue(indexPos    , 0, pointCount - 1);
+
+				if (index0 == index1){
+					out[i] = points[index1];
+					continue;
+				}
+
+				double value0 = points[index0];
+				double value1 = points[index1];
+				double alpha = (sourceValue - value0) / (value1 - value0);
+				if (invert){
+					alpha = 1.0 - alpha;
+					noise::SwapValues(value0, value1);
+				}
+
+				alpha *= alpha;
+
+				out[i] = noise::LinearInterp(value0, value1, alpha);
+			}
+		}
+
+		// A transfer function sampled at `entries` evenly spaced inputs from `low` to `high` and
+		// interpolated linearly, holding its end values outside them as curve and terrace do
+		inline auto Table(const double* a, double* out, size_t count, const double* values, size_t entries, double low, double high) -> void {
+			double scale = static_cast<double>(entries - 1) / (high - low);
+			double last = static_cast<double>(entries - 1);
+			for (size_t i = 0; i < count; i++){
+				double t = (a[i] - low) * scale;
+				t = t > 0.0 ? (t < last ? t : last) : 0.0;
+				size_t k = std::min(static_cast<size_t>(t), entries - 2);
+				double alpha = t - static_cast<double>(k);
+				out[i] = values[k] + (values[k + 1] - values[k]) * alpha;
+			}
+		}
+
+		inline auto Add(const double* a, const double* b, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = a[i] + b[i];
+		}
+
+		inline auto Multiply(const double* a, const double* b, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = a[i] * b[i];
+		}
+
+		inline auto Max(const double* a, const double* b, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = noise::GetMax(a[i], b[i]);
+		}
+
+		inline auto Min(const double* a, const double* b, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = noise::GetMin(a[i], b[i]);
+		}
+
+		inline auto Power(const double* a, const double* b, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++)
+				out[i] = std::pow(a[i], b[i]);
+		}
+
+		inline auto Blend(const double* a, const double* b, const double* control, double* out, size_t count) -> void {
+			for (size_t i = 0; i < count; i++){
+				double alpha = (control[i] + 1.0) / 2.0;
+				out[i] = noise::LinearInterp(a[i], b[i], alpha);
+			}
+		}
+
+		inline auto Select(const double* a, const double* b, const double* control, double* out, size_t count, double lowerBound, double upperBound, double edgeFalloff) -> void {
+			for (size_t i = 0; i < count; i++){
+				double controlValue = control[i];
+
+				if (edgeFalloff > 0.0){
+					if (controlValue < (lowerBound - edgeFalloff)){
+						out[i] = a[i];
+					} else if (controlValue < (lowerBound + edgeFalloff)){
+						double lowerCurve = (lowerBound - edgeFalloff);
+						double upperCurve = (lowerBound + edgeFalloff);
+						double alpha = noise::SCurve3((controlValue - lowerCurve) / (upperCurve - lowerCurve));
+						out[i] = noise::LinearInterp(a[i], b[i], alpha);
+					} else if (controlValue < (upperBound - edgeFalloff)){
+						out[i] = b[i];
+					} else if (controlValue < (upperBound + edgeFalloff)){
+						double lowerCurve = (upperBound - edgeFalloff);
+						double upperCurve = (upperBound + edgeFalloff);
+						double alpha = noise::SCurve3((controlValue - lowerCurve) / (upperCurve - lowerCurve));
+						out[i] = noise::LinearInterp(b[i], a[i], alpha);
+					} else {
+						out[i] = a[i];
+					}
+				} else {
+					if (controlValue < lowerBound || controlValue > upperBound)
+						out[i] = a[i];
+					else
+						out[i] = b[i];
+				}
+			}
+		}
+		// }}}
+
+		// {{{ Point transformers (write the coordinates the source module is sampled at)
+		inline auto TranslatePoint(const double* x, const double* y, const double* z, double* nx, double* ny, double* nz, size_t count, double tx, double ty, double tz) -> void {
+			for (size_t i = 0; i < count; i++){
+				nx[i] = x[i] + tx;
+				ny[i] = y[i] + ty;
+				nz[i] = z[i] + tz;
+			}
+		}
+
+		inline auto ScalePoint(const double* x, const double* y, const double* z, double* nx, double* ny, double* nz, size_t count, double sx, double sy, double sz) -> void {
+			for (size_t i = 0; i < count; i++){
+				nx[i] = x[i] * sx;
+				ny[i] = y[i] * sy;
+				nz[i] = z[i] * sz;
+			}
+		}
+
+		inline auto RotatePoint(const double* x, const double* y, const double* z, double* nx, double* ny, double* nz, size_t count, const double* matrix) -> void {
+			for (size_t i = 0; i < count; i++){
+				double px = x[i], py = y[i], pz = z[i];
+				nx[i] = (matrix[0] * px) + (matrix[1] * py) + (matrix[2] * pz);
+				ny[i] = (matrix[3] * px) + (matrix[4] * py) + (matrix[5] * pz);
+				nz[i] = (matrix[6] * px) + (matrix[7] * py) + (matrix[8] * pz);
+			}
+		}
+
+		// Displacement values are written into nx/ny/nz beforehand and offset in place
+		inline auto Displace(const double* x, const double* y, const double* z, double* nx, double* ny, double* nz, size_t count) -> void {
+			for (size_t i = 0; i < count; i++){
+				nx[i] = x[i] + nx[i];
+				ny[i] = y[i] + ny[i];
+				nz[i] = z[i] + nz[i];
+			}
+		}
+
+		// Same as Displace, with the distortion values scaled by the turbulence power
+		inline auto Turbulence(const double* x, const double* y, const double* z, double* nx, double* ny, double* nz, size_t count, double power) -> void {
+			for (size_t i = 0; i < count; i++){
+				nx[i] = x[i] + (nx[i] * power);
+				ny[i] = y[i] + (ny[i] * power);
+				nz[i] = z[i] + (nz[i] * power);
+			}
+		}
+
+		// The fixed offsets libnoise's Turbulence applies before sampling each distortion module
+		const double TurbulenceOffsets[3][3] = {
+			{12414.0 / 65536.0, 65124.0 / 65536.0, 31337.0 / 65536.0},
+			{26519.0 / 65536.0, 18128.0 / 65536.0, 60493.0 / 65536.0},
+			{53820.0 / 65536.0, 11213.0 / 65536.0, 44845.0 / 65536.0},
+		};
+		// }}}
+
+	}
+
+	// Evaluates a module graph without touching any of its mutable state, so one graph can
+	// be shared read-only by any number of threads as long as each thread has its own
+	// evaluator. The state libnoise keeps in Cache modules lives here instead, and only
+	// for the duration of one Evaluate()/EvaluateGrid()/GetValue() call. A cache remembers
+	// the last block it saw rather than the last point, so a subgraph under a cache with
+	// several parents is evaluated once per block.
+	class BlockEvaluator {
+		public:
+			static const size_t DefaultBlockSize = 1024;
+
+		private:
+			class CacheState {
+				public:
+					std::vector<double> x, y, z;
+					std::vector<double> values;
+			};
+
+			size_t blockSize;
+			std::vector<std::vector<double>> scratch;
+			size_t scratchTop;
+			std::unordered_map<const noise::module::Module*, NoiseLang::BlockEvaluator::CacheState> caches;
+			size_t cachedSamples;
+
+			auto Acquire() -> double*;
+			auto Release(size_t count) -> void;
+			auto EvaluateBlock(const noise::module::Module& module, const double* x, const double* y, const double* z, double* out, size_t count) -> void;
+			auto EvaluatePerlin(const noise::module::Perlin& perlin, const double* x, const double* y, const double* z, double* out, size_t count) -> void;
+
+		public:
+			BlockEvaluator(size_t blockSize = DefaultBlockSize);
+
+			// Evaluates `module` at `count` arbitrary points, one node at a time
+			auto Evaluate(const noise::module::Module& module, const double* x, const double* y, const double* z, double* out, size_t count) -> void;
+
+			// Evaluates `module` over a regular grid, writing rows of grid.width values to out
+			auto EvaluateGrid(const noise::module::Module& module, const PointGrid& grid, double* out) -> void;
+
+			// Thread-safe replacement for module.GetValue(x, y, z)
+			auto GetValue(const noise::module::Module& module, double x, double y, double z) -> double;
+
+			auto GetBlockSize() -> size_t;
+
+			// Samples cache modules answered without evaluating their source, since construction
+			auto GetCachedSamples() -> size_t;
+	};
+
+}
+
+auto NoiseLang::GetModuleKind(const noise::module::Module& module) -> NoiseLang::ModuleKind {
+	const auto* m = &module;
+
+	if (dynamic_cast<const noise::module::Abs*>(m)) return ModuleKind::Abs;
+	if (dynamic_cast<const noise::module::Add*>(m)) return ModuleKind::Add;
+	if (dynamic_cast<const noise::module::Billow*>(m)) return ModuleKind::Billow;
+	if (dynamic_cast<const noise::module::Blend*>(m)) return ModuleKind::Blend;
+	if (dynamic_cast<const noise::module::Cache*>(m)) return ModuleKind::Cache;
+	if (dynamic_cast<const noise::module::Checkerboard*>(m)) return ModuleKind::Checkerboard;
+	if (dynamic_cast<const noise::module::Clamp*>(m)) return ModuleKind::Clamp;
+	if (dynamic_cast<const noise::module::Const*>(m)) return ModuleKind::Const;
+	if (dynamic_cast<const noise::module::Curve*>(m)) return ModuleKind::Curve;
+	if (dynamic_cast<const noise::module::Cylinders*>(m)) return ModuleKind::Cylinders;
+	if (dynamic_cast<const noise::module::Displace*>(m)) return ModuleKind::Displace;
+	if (dynamic_cast<const noise::module::Exponent*>(m)) return ModuleKind::Exponent;
+	if (dynamic_cast<const noise::module::Invert*>(m)) return ModuleKind::Invert;
+	if (dynamic_cast<const noise::module::Max*>(m)) return ModuleKind::Max;
+	if (dynamic_cast<const noise::module::Min*>(m)) return ModuleKind::Min;
+	if (dynamic_cast<const noise::module::Multiply*>(m)) return ModuleKind::Multiply;
+	if (dynamic_cast<const noise::module::Perlin*>(m)) return ModuleKind::Perlin;
+	if (dynamic_cast<const noise::module::Power*>(m)) return ModuleKind::Power;
+	if (dynamic_cast<const noise::module::RidgedMulti*>(m)) return ModuleKind::RidgedMulti;
+	if (dynamic_cast<const noise::module::RotatePoint*>(m)) return ModuleKind::RotatePoint;
+	if (dynamic_cast<const noise::module::ScaleBias*>(m)) return ModuleKind::ScaleBias;
+	if (dynamic_cast<const noise::module::ScalePoint*>(m)) return ModuleKind::ScalePoint;
+	if (dynamic_cast<const noise::module::Select*>(m)) return ModuleKind::Select;
+	if (dynamic_cast<const noise::module::Spheres*>(m)) return ModuleKind::Spheres;
+	if (dynamic_cast<const noise::module::Terrace*>(m)) return ModuleKind::Terrace;
+	if (dynamic_cast<const noise::module::TranslatePoint*>(m)) return ModuleKind::TranslatePoint;
+	if (dynamic_cast<const noise::module::Turbulence*>(m)) return ModuleKind::Turbulence;
+	if (dynamic_cast<const noise::module::Voronoi*>(m)) return ModuleKind::Voronoi;
+
+	return ModuleKind::Unknown;
+}
+
+auto NoiseLang::GetModuleKindName(NoiseLang::ModuleKind kind) -> std::string {
+	static const char* names[] = {
+		"abs", "add", "billow", "blend", "cache", "checkerboard", "clamp", "const", "curve", "cylinders",
+		"displace", "exponent", "invert", "max", "min", "multiply", "perlin", "power", "ridgedmulti", "rotatepoint",
+		"scalebias", "scalepoint", "select", "spheres", "terrace", "translatepoint", "turbulence", "voronoi",
+		"unknown"
+	};
+	return names[static_cast<int>(kind)];
+}
+
+NoiseLang::BlockEvaluator::BlockEvaluator(size_t blockSize) {
+	this->blockSize = blockSize > 0 ? blockSize : DefaultBlockSize;
+	this->scratchTop = 0;
+	this->cachedSamples = 0;
+}
+
+auto NoiseLang::BlockEvaluator::GetBlockSize() -> size_t {
+	return this->blockSize;
+}
+
+auto NoiseLang::BlockEvaluator::GetCachedSamples() -> size_t {
+	return this->cachedSamples;
+}
+
+auto NoiseLang::BlockEvaluator::Acquire() -> double* {
+	// Scratch buffers are used as a stack, one frame per node being evaluated
+	if (this->scratchTop == this->scratch.size())
+		this->scratch.emplace_back(this->blockSize);
+	return this->scratch[this->scratchTop++].data();
+}
+
+auto NoiseLang::BlockEvaluator::Release(size_t count) -> void {
+	this->scratchTop -= count;
+}
+
+auto NoiseLang::BlockEvaluator::Evaluate(const noise::module::Module& module, const double* x, const double* y, const double* z, double* out, size_t count) -> void {
+	this->caches.clear();
+
+	for (size_t offset = 0; offset < count; offset += this->blockSize){
+		size_t n = std::min(this->blockSize, count - offset);
+		this->EvaluateBlock(module, x + offset, y + offset, z + offset, out + offset, n);
+	}
+}
+
+auto NoiseLang::BlockEvaluator::EvaluateGrid(const noise::module::Module& module, const NoiseLang::PointGrid& grid, double* out) -> void {
+	this->caches.clear();
+
+	double* x = this->Acquire();
+	double* y = this->Acquire();
+	double* z = this->Acquire();
+
+	size_t total = static_cast<size_t>(grid.width) * grid.height;
+	for (size_t offset = 0; offset < total; offset += this->blockSize){
+		size_t n = std::min(this->blockSize, total - offset);
+
+		for (size_t i = 0; i < n; i++){
+			size_t index = offset + i;
+			x[i] = grid.originX + static_cast<double>(index % grid.width) * grid.stepX;
+			y[i] = grid.originY + static_cast<double>(index / grid.width) * grid.stepY;
+			z[i] = grid.z;
+		}
+
+		this->EvaluateBlock(module, x, y, z, out + offset, n);
+	}
+
+	this->Release(3);
+}
+
+auto NoiseLang::BlockEvaluator::GetValue(const noise::module::Module& module, double x, double y, double z) -> double {
+	this->caches.clear();
+
+	double value;
+	this->EvaluateBlock(module, &x, &y, &z, &value, 1);
+	return value;
+}
+
+auto NoiseLang::BlockEvaluator::EvaluatePerlin(const noise::module::Perlin& perlin, const double* x, const double* y, const double* z, double* out, size_t count) -> void {
+	NoiseLang::Kernels::Perlin(x, y, z, out, count, perlin.GetFrequency(), perlin.GetLacunarity(), perlin.GetPersistence(), perlin.GetOctaveCount(), perlin.GetSeed(), perlin.GetNoiseQuality());
+}
+
+auto NoiseLang::BlockEvaluator::EvaluateBlock(const noise::module::Module& module, const double* x, const double* y, const double* z, double* out, size_t count) -> void {
+	namespace K = NoiseLang::Kernels;
+	using namespace noise::module;
+
+	switch (NoiseLang::GetModuleKind(module)){
+
+		// {{{ Generators
+		case ModuleKind::Billow: {
+			auto& m = static_cast<const Billow&>(module);
+			K::Billow(x, y, z, out, count, m.GetFrequency(), m.GetLacunarity(), m.GetPersistence(), m.GetOctaveCount(), m.GetSeed(), m.GetNoiseQuality());
+			break;
+		}
+		case ModuleKind::Checkerboard:
+			K::Checkerboard(x, y, z, out, count);
+			break;
+		case ModuleKind::Const:
+			K::Const(out, count, static_cast<const noise::module::Const&>(module).GetConstValue());
+			break;
+		case ModuleKind::Cylinders:
+			K::Cylinders(x, z, out, count, static_cast<const Cylinders&>(module).GetFrequency());
+			break;
+		case ModuleKind::Perlin:
+			this->EvaluatePerlin(static_cast<const Perlin&>(module), x, y, z, out, count);
+			break;
+		case ModuleKind::RidgedMulti: {
+			auto& m = static_cast<const RidgedMulti&>(module);
+			K::RidgedMulti(x, y, z, out, count, m.GetFrequency(), m.GetLacunarity(), m.GetOctaveCount(), m.GetSeed(), m.GetNoiseQuality(), K::RidgedMultiAccess::SpectralWeights(m));
+			break;
+		}
+		case ModuleKind::Spheres:
+			K::Spheres(x, y, z, out, count, static_cast<const Spheres&>(module).GetFrequency());
+			break;
+		case ModuleKind::Voronoi: {
+			auto& m = static_cast<const Voronoi&>(module);
+			K::Voronoi(x, y, z, out, count, m.GetFrequency(), m.GetDisplacement(), m.IsDistanceEnabled(), m.GetSeed());
+			break;
+		}
+		// }}}
+
+		// {{{ Single source modifiers
+		case ModuleKind::Abs:
+			this->EvaluateBlock(module.GetSourceModule(0), x, y, z, out, count);
+			K::Abs(out, out, count);
+			break;
+		case ModuleKind::Cache: {
+			// Same rule as libnoise (reuse the values if asked for the same points again), but for
+			// a whole block, and remembered by this evaluator rather than by the shared module
+			auto& state = this->caches[&module];
+			if (state.values.size() == count && std::equal(x, x + count, state.x.begin()) && std::equal(y, y + count, state.y.begin()) && std::equal(z, z + count, state.z.begin())){
+				std::copy(state.values.begin(), state.values.end(), out);
+				this->cachedSamples += count;
+				break;
+			}
+
+			this->EvaluateBlock(module.GetSourceModule(0), x, y, z, out, count);
+
+			state.x.assign(x, x + count);
+			state.y.assign(y, y + count);
+			state.z.assign(z, z + count);
+			state.values.assign(out, out + count);
+			break;
+		}
+		case ModuleKind::Clamp: {
+			auto& m = static_cast<const Clamp&>(module);
+			this->EvaluateBlock(m.GetSourceModule(0), x, y, z, out, count);
+			K::Clamp(out, out, count, m.GetLowerBound(), m.GetUpperBound());
+			break;
+		}
+		case ModuleKind::Curve: {
+			auto& m = static_cast<const Curve&>(module);
+			this->EvaluateBlock(m.GetSourceModule(0), x, y, z, out, count);
+			K::Curve(out, out, count, m.GetControlPointArray(), m.GetControlPointCount());
+			break;
+		}
+		case ModuleKind::Exponent: {
+			auto& m = static_cast<const Exponent&>(module);
+			this->EvaluateBlock(m.GetSourceModule(0), x, y, z, out, count);
+			K::Exponent(out, out, count, m.GetExponent());
+			break;
+		}
+		case ModuleKind::Invert:
+			this->EvaluateBlock(module.GetSourceModule(0), x, y, z, out, count);
+			K::Invert(out, out, count);
+			break;
+		case ModuleKind::ScaleBias: {
+			auto& m = static_cast<const ScaleBias&>(module);
+			this->EvaluateBlock(m.GetSourceModule(0), x, y, z, out, count);
+			K::ScaleBias(out, out, count, m.GetScale(), m.GetBias());
+			break;
+		}
+		case ModuleKind::Terrace: {
+			auto& m = static_cast<const Terrace&>(module);
+			this->EvaluateBlock(m.GetSourceModule(0), x, y, z, out, count);
+			K::Terrace(out, out, count, m.GetControlPointArray(), m.GetControlPointCount(), m.IsTerracesInverted());
+			break;
+		}
+		// }}}
+
+		// {{{ Combiners
+		case ModuleKind::Add:
+		case ModuleKind::Max:
+		case ModuleKind::Min:
+		case ModuleKind::Multiply:
+		case ModuleKind::Power: {
+			double* b = this->Acquire();
+			this->EvaluateBlock(module.GetSourceModule(0), x, y, z, out, count);
+			this->EvaluateBlock(module.GetSourceModule(1), x, y, z, b, count);
+
+			switch (NoiseLang::GetModuleKind(module)){
+				case ModuleKind::Add: K::Add(out, b, out, count); break;
+				case ModuleKind::Max: K::Max(out, b, out, count); break;
+				case ModuleKind::Min: K::Min(out, b, out, count); break;
+				case ModuleKind::Multiply: K::Multiply(out, b, out, count); break;
+				default: K::Power(out, b, out, count); break;
+			}
+
+			this->Release(1);
+			break;
+		}
+		case ModuleKind::Blend: {
+			double* b = this->Acquire();
+			double* control = this->Acquire();
+			this->EvaluateBlock(module.GetSourceModule(0), x, y, z, out, count);
+			this->EvaluateBlock(module.GetSourceModule(1), x, y, z, b, count);
+			this->EvaluateBlock(module.GetSourceModule(2), x, y, z, control, count);
+			K::Blend(out, b, control, out, count);
+			this->Release(2);
+			break;
+		}
+		case ModuleKind::Select: {
+			auto& m = static_cast<const Select&>(module);
+			double* b = this->Acquire();
+			double* control = this->Acquire();
+			this->EvaluateBlock(m.GetSourceModule(0), x, y, z, out, count);
+			this->EvaluateBlock(m.GetSourceModule(1), x, y, z, b, count);
+			this->EvaluateBlock(m.GetSourceModule(2), x, y, z, control, count);
+			K::Select(out, b, control, out, count, m.GetLowerBound(), m.GetUpperBound(), m.GetEdgeFalloff());
+			this->Release(2);
+			break;
+		}
+		// }}}
+
+		// {{{ Point transformers
+		case ModuleKind::Displace: {
+			double* nx = this->Acquire();
+			double* ny = this->Acquire();
+			double* nz = this->Acquire();
+			this->EvaluateBlock(module.GetSourceModule(1), x, y, z, nx, count);
+			this->EvaluateBlock(module.GetSourceModule(2), x, y, z, ny, count);
+			this->EvaluateBlock(module.GetSourceModule(3), x, y, z, nz, count);
+			K::Displace(x, y, z, nx, ny, nz, count);
+			this->EvaluateBlock(module.GetSourceModule(0), nx, ny, nz, out, count);
+			this->Release(3);
+			break;
+		}
+		case ModuleKind::RotatePoint: {
+			double matrix[9];
+			K::RotatePointAccess::Matrix(static_cast<const RotatePoint&>(module), matrix);
+			double* nx = this->Acquire();
+			double* ny = this->Acquire();
+			double* nz = this->Acquire();
+			K::RotatePoint(x, y, z, nx, ny, nz, count, matrix);
+			this->EvaluateBlock(module.GetSourceModule(0), nx, ny, nz, out, count);
+			this->Release(3);
+			break;
+		}
+		case ModuleKind::ScalePoint: {
+			auto& m = static_cast<const ScalePoint&>(module);
+			double* nx = this->Acquire();
+			double* ny = this->Acquire();
+			double* nz = this->Acquire();
+			K::ScalePoint(x, y, z, nx, ny, nz, count, m.GetXScale(), m.GetYScale(), m.GetZScale());
+			this->EvaluateBlock(m.GetSourceModule(0), nx, ny, nz, out, count);
+			this->Release(3);
+			break;
+		}
+		case ModuleKind::TranslatePoint: {
+			auto& m = static_cast<const TranslatePoint&>(module);
+			double* nx = this->Acquire();
+			double* ny = this->Acquire();
+			double* nz = this->Acquire();
+			K::TranslatePoint(x, y, z, nx, ny, nz, count, m.GetXTranslation(), m.GetYTranslation(), m.GetZTranslation());
+			this->EvaluateBlock(m.GetSourceModule(0), nx, ny, nz, out, count);
+			this->Release(3);
+			break;
+		}
+		case ModuleKind::Turbulence: {
+			auto& m = static_cast<const Turbulence&>(module);
+			double* ox = this->Acquire();
+			double* oy = this->Acquire();
+			double* oz = this->Acquire();
+			double* distort[3] = {this->Acquire(), this->Acquire(), this->Acquire()};
+
+			for (int axis = 0; axis < 3; axis++){
+				K::TranslatePoint(x, y, z, ox, oy, oz, count, K::TurbulenceOffsets[axis][0], K::TurbulenceOffsets[axis][1], K::TurbulenceOffsets[axis][2]);
+				this->EvaluatePerlin(K::TurbulenceAccess::DistortModule(m, axis), ox, oy, oz, distort[axis], count);
+			}
+
+			K::Turbulence(x, y, z, distort[0], distort[1], distort[2], count, m.GetPower());
+			this->EvaluateBlock(m.GetSourceModule(0), distort[0], distort[1], distort[2], out, count);
+			this->Release(6);
+			break;
+		}
+		// }}}
+
+		case ModuleKind::Unknown:
+			// Not a module the interpreter builds, fall back to the scalar path
+			for (size_t i = 0; i < count; i++)
+				out[i] = module.GetValue(x[i], y[i], z[i]);
+			break;
+	}
+}
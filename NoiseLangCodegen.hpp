@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+#include "vendor/include/noise/noise.h"
+
+#include "NoiseLangProgram.hpp"
+
+namespace NoiseLang {
+
+	// Writes a compiled program out as a standalone C++ header. Every parameter becomes a
+	// literal at its kernel call, so an -O3 build constant-propagates them into the kernels
+	// (unrolled octave loops, no parameter loads) and nothing is dispatched at runtime.
+	class CodeGenerator {
+		private:
+			const NoiseLang::Program& program;
+			std::ostream& stream;
+
+			CodeGenerator(const NoiseLang::Program& program, std::ostream& stream);
+
+			auto Literal(double value) -> std::string;
+			auto Quality(double value) -> std::string;
+			auto Value(std::uint32_t v) -> std::string;
+			auto Coord(std::uint32_t c, int axis) -> std::string;
+			auto EmitTable(const std::string& type, const std::string& name, const double* values, size_t count) -> void;
+			auto EmitTables() -> void;
+			auto EmitStep(const NoiseLang::ChainStep& step, const std::string& a, const std::string& o, const std::string& suffix) -> void;
+			auto EmitInstruction(const NoiseLang::Instruction& instruction, size_t index) -> void;
+
+		public:
+			// `name` becomes the namespace of the generated code. Throws
+			// noise::ExceptionInvalidParam if the program still calls into live modules.
+			static auto Generate(const NoiseLang::Program& program, const std::string& name, std::ostream& stream) -> void;
+	};
+
+}
+
+NoiseLang::CodeGenerator::CodeGenerator(const NoiseLang::Program& program, std::ostream& stream) : program(program), stream(stream) {
+}
+
+auto NoiseLang::CodeGenerator::Literal(double value) -> std::string {
+	if (std::isnan(value))
+		return "std::numeric_limits<double>::quiet_NaN()";
+	if (std::isinf(value))
+		return value > 0 ? "std::numeric_limits<double>::infinity()" : "-std::numeric_limits<double>::infinity()";
+
+	// 17 significant digits round trips every double exactly
+	std::stringstream ss;
+	ss.precision(17);
+	ss << value;
+
+	std::string literal = ss.str();
+	if (literal.find_first_of(".e") == std::string::npos)
+		literal += ".0";
+	return literal;
+}
+
+auto NoiseLang::CodeGenerator::Quality(double value) -> std::string {
+	switch (static_cast<int>(value)){
+		case noise::QUALITY_FAST: return "noise::QUALITY_FAST";
+		case noise::QUALITY_BEST: return "noise::QUALITY_BEST";
+		default: return "noise::QUALITY_STD";
+	}
+}
+
+auto NoiseLang::CodeGenerator::Value(std::uint32_t v) -> std::string {
+	return "v" + std::to_string(v);
+}
+
+auto NoiseLang::CodeGenerator::Coord(std::uint32_t c, int axis) -> std::string {
+	// Coordinate register 0 is the caller's points
+	static const char* axes[] = {"x", "y", "z"};
+	return c == 0 ? axes[axis] : "c" + std::to_string(c) + axes[axis];
+}
+
+auto NoiseLang::CodeGenerator::EmitTable(const std::string& type, const std::string& name, const double* values, size_t count) -> void {
+	this->stream << "\tconst " << type << " " << name << "[] = {";
+	for (size_t i = 0; i < count; i++)
+		this->stream << (i > 0 ? ", " : "") << this->Literal(values[i]);
+	this->stream << "};" << std::endl;
+}
+
+auto NoiseLang::CodeGenerator::EmitTables() -> void {
+	// Kernels that take arrays read them from namespace scope constants
+	for (size_t index = 0; index < this->program.code.size(); index++){
+		auto& i = this->program.code[index];
+		const double* p = this->program.params.data() + i.params;
+		std::string suffix = std::to_string(index);
+
+		if (i.op == OpCode::RidgedMulti)
+			this->EmitTable("double", "weights" + suffix, p + 5, static_cast<size_t>(p[2]));
+		if (i.op == OpCode::RotatePoint)
+			this->EmitTable("double", "matrix" + suffix, p, 9);
+		if (!NoiseLang::IsPointwise(i.op))
+			continue;
+
+		// A chain's steps are suffixed with their position in it
+		NoiseLang::ChainStep steps[NoiseLang::Program::MaxChainSteps];
+		size_t count = this->program.GetSteps(i, steps);
+		for (size_t k = 0; k < count; k++){
+			const double* q = steps[k].params;
+			std::string name = i.op == OpCode::Chain ? suffix + "_" + std::to_string(k) : suffix;
+
+			switch (steps[k].op){
+				case OpCode::Terrace:
+					this->EmitTable("double", "terrace" + name, q + 2, static_cast<size_t>(q[0]));
+					break;
+				case OpCode::Table:
+					this->EmitTable("double", "table" + name, q + 3, static_cast<size_t>(q[0]));
+					break;
+				case OpCode::Curve: {
+					auto* points = this->program.controlPoints.data() + static_cast<size_t>(q[0]);
+					this->stream << "\tconst noise::module::ControlPoint curve" << name << "[] = {";
+					for (int point = 0; point < static_cast<int>(q[1]); point++)
+						this->stream << (point > 0 ? ", " : "") << "{" << this->Literal(points[point].inputValue) << ", " << this->Literal(points[point].outputValue) << "}";
+					this->stream << "};" << std::endl;
+					break;
+				}
+				default:
+					break;
+			}
+		}
+	}
+}
+
+auto NoiseLang::CodeGenerator::EmitStep(const NoiseLang::ChainStep& step, const std::string& a, const std::string& o, const std::string& suffix) -> void {
+	auto& s = this->stream;
+	const double* p = step.params;
+
+	switch (step.op){
+		case OpCode::Abs: s << "K::Abs(" << a << ", " << o << ", count);"; break;
+		case OpCode::Invert: s << "K::Invert(" << a << ", " << o << ", count);"; break;
+		case OpCode::Clamp: s << "K::Clamp(" << a << ", " << o << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ");"; break;
+		case OpCode::Curve: s << "K::Curve(" << a << ", " << o << ", count, curve" << suffix << ", " << static_cast<int>(p[1]) << ");"; break;
+		case OpCode::Exponent: s << "K::Exponent(" << a << ", " << o << ", count, " << this->Literal(p[0]) << ");"; break;
+		case OpCode::ScaleBias: s << "K::ScaleBias(" << a << ", " << o << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ");"; break;
+		case OpCode::Terrace: s << "K::Terrace(" << a << ", " << o << ", count, terrace" << suffix << ", " << static_cast<int>(p[0]) << ", " << (p[1] != 0.0 ? "true" : "false") << ");"; break;
+		case OpCode::Table: s << "K::Table(" << a << ", " << o << ", count, table" << suffix << ", " << static_cast<size_t>(p[0]) << ", " << this->Literal(p[1]) << ", " << this->Literal(p[2]) << ");"; break;
+		default: break;
+	}
+}
+
+auto NoiseLang::CodeGenerator::EmitInstruction(const NoiseLang::Instruction& i, size_t index) -> void {
+	auto& s = this->stream;
+	const double* p = this->program.params.data() + i.params;
+	std::string suffix = std::to_string(index);
+
+	std::string px = this->Coord(i.coords, 0), py = this->Coord(i.coords, 1), pz = this->Coord(i.coords, 2);
+	std::string at = px + ", " + py + ", " + pz;
+	std::string o = this->Value(i.out);
+	std::string a = this->Value(i.in[0]), b = this->Value(i.in[1]), c = this->Value(i.in[2]);
+	// The namespace of the gradient noise kernels the program was compiled for
+	std::string g = this->program.precision == NoiseLang::Precision::Single ? "K::Single::" : "K::";
+
+	s << "\t\t";
+	switch (i.op){
+		case OpCode::Billow:
+			s << g << "Billow(" << at << ", " << o << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ", " << this->Literal(p[2]) << ", " << static_cast<int>(p[3]) << ", " << static_cast<int>(p[4]) << ", " << this->Quality(p[5]) << ");";
+			break;
+		case OpCode::Perlin:
+			s << g << "Perlin(" << at << ", " << o << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ", " << this->Literal(p[2]) << ", " << static_cast<int>(p[3]) << ", " << static_cast<int>(p[4]) << ", " << this->Quality(p[5]) << ");";
+			break;
+		case OpCode::RidgedMulti:
+			s << g << "RidgedMulti(" << at << ", " << o << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ", " << static_cast<int>(p[2]) << ", " << static_cast<int>(p[3]) << ", " << this->Quality(p[4]) << ", weights" << suffix << ");";
+			break;
+		case OpCode::Voronoi:
+			s << "K::Voronoi(" << at << ", " << o << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ", " << (p[2] != 0.0 ? "true" : "false") << ", " << static_cast<int>(p[3]) << ");";
+			break;
+		case OpCode::Checkerboard:
+			s << "K::Checkerboard(" << at << ", " << o << ", count);";
+			break;
+		case OpCode::Const:
+			s << "K::Const(" << o << ", count, " << this->Literal(p[0]) << ");";
+			break;
+		case OpCode::Cylinders:
+			s << "K::Cylinders(" << px << ", " << pz << ", " << o << ", count, " << this->Literal(p[0]) << ");";
+			break;
+		case OpCode::Spheres:
+			s << "K::Spheres(" << at << ", " << o << ", count, " << this->Literal(p[0]) << ");";
+			break;
+
+		case OpCode::Abs: case OpCode::Invert: case OpCode::Clamp: case OpCode::Curve: case OpCode::Exponent: case OpCode::ScaleBias: case OpCode::Terrace: case OpCode::Table:
+			this->EmitStep(NoiseLang::ChainStep{i.op, p}, a, o, suffix);
+			break;
+		case OpCode::Chain: {
+			// Step by step in place on the output, the compiler keeps the block in cache
+			NoiseLang::ChainStep steps[NoiseLang::Program::MaxChainSteps];
+			size_t count = this->program.GetSteps(i, steps);
+			for (size_t k = 0; k < count; k++){
+				if (k > 0)
+					s << std::endl << "\t\t";
+				this->EmitStep(steps[k], k == 0 ? a : o, o, suffix + "_" + std::to_string(k));
+			}
+			break;
+		}
+		case OpCode::Add: s << "K::Add(" << a << ", " << b << ", " << o << ", count);"; break;
+		case OpCode::Max: s << "K::Max(" << a << ", " << b << ", " << o << ", count);"; break;
+		case OpCode::Min: s << "K::Min(" << a << ", " << b << ", " << o << ", count);"; break;
+		case OpCode::Multiply: s << "K::Multiply(" << a << ", " << b << ", " << o << ", count);"; break;
+		case OpCode::Power: s << "K::Power(" << a << ", " << b << ", " << o << ", count);"; break;
+		case OpCode::Blend: s << "K::Blend(" << a << ", " << b << ", " << c << ", " << o << ", count);"; break;
+		case OpCode::Select: s << "K::Select(" << a << ", " << b << ", " << c << ", " << o << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ", " << this->Literal(p[2]) << ");"; break;
+
+		case OpCode::Displace:
+			s << "for (size_t i = 0; i < count; i++){" << std::endl;
+			for (int axis = 0; axis < 3; axis++)
+				s << "\t\t\t" << this->Coord(i.out, axis) << "[i] = " << this->Coord(i.coords, axis) << "[i] + " << this->Value(i.in[axis]) << "[i];" << std::endl;
+			s << "\t\t}";
+			break;
+		case OpCode::RotatePoint:
+			s << "K::RotatePoint(" << at << ", " << this->Coord(i.out, 0) << ", " << this->Coord(i.out, 1) << ", " << this->Coord(i.out, 2) << ", count, matrix" << suffix << ");";
+			break;
+		case OpCode::ScalePoint:
+		case OpCode::TranslatePoint:
+			s << (i.op == OpCode::ScalePoint ? "K::ScalePoint(" : "K::TranslatePoint(") << at << ", " << this->Coord(i.out, 0) << ", " << this->Coord(i.out, 1) << ", " << this->Coord(i.out, 2) << ", count, " << this->Literal(p[0]) << ", " << this->Literal(p[1]) << ", " << this->Literal(p[2]) << ");";
+			break;
+		case OpCode::Turbulence:
+			// Same order as the evaluator, distortions first since the output may be the input register
+			for (int axis = 0; axis < 3; axis++){
+				const double* q = p + 1 + axis * 6;
+				s << "K::TranslatePoint(" << at << ", tx, ty, tz, count, K::TurbulenceOffsets[" << axis << "][0], K::TurbulenceOffsets[" << axis << "][1], K::TurbulenceOffsets[" << axis << "][2]);" << std::endl;
+				s << "\t\tK::Perlin(tx, ty, tz, t" << axis << ", count, " << this->Literal(q[0]) << ", " << this->Literal(q[1]) << ", " << this->Literal(q[2]) << ", " << static_cast<int>(q[3]) << ", " << static_cast<int>(q[4]) << ", " << this->Quality(q[5]) << ");" << std::endl << "\t\t";
+			}
+			s << "for (size_t i = 0; i < count; i++){" << std::endl;
+			for (int axis = 0; axis < 3; axis++)
+				s << "\t\t\t" << this->Coord(i.out, axis) << "[i] = " << this->Coord(i.coords, axis) << "[i] + (t" << axis << "[i] * " << this->Literal(p[0]) << ");" << std::endl;
+			s << "\t\t}";
+			break;
+
+		case OpCode::External:
+			throw noise::ExceptionInvalidParam();
+	}
+	s << std::endl;
+}
+
+auto NoiseLang::CodeGenerator::Generate(const NoiseLang::Program& program, const std::string& name, std::ostream& stream) -> void {
+	auto generator = NoiseLang::CodeGenerator(program, stream);
+	auto& s = stream;
+
+	// Modules the compiler didn't lower only exist in the interpreter's memory
+	if (!program.externals.empty())
+		throw noise::ExceptionInvalidParam();
+
+	bool turbulence = false;
+	for (auto& i : program.code)
+		turbulence = turbulence || i.op == OpCode::Turbulence;
+
+	s << "#pragma once" << std::endl << std::endl;
+	s << "// Generated by the NoiseLang `compile` command, regenerate it from the script instead of editing it" << std::endl << std::endl;
+	s << "#include <algorithm>" << std::endl;
+	s << "#include <cstddef>" << std::endl;
+	s << "#include <limits>" << std::endl << std::endl;
+	s << "#include \"NoiseLangBlock.hpp\"" << std::endl;
+	if (program.precision == NoiseLang::Precision::Single)
+		s << "#include \"NoiseLangSimd.hpp\"" << std::endl;
+	s << std::endl;
+	s << "namespace " << name << " {" << std::endl << std::endl;
+	s << "\tconst size_t BlockSize = 256;" << std::endl << std::endl;
+
+	generator.EmitTables();
+
+	s << std::endl << "\tinline auto EvaluateBlock(const double* x, const double* y, const double* z, double* out, size_t count) -> void {" << std::endl;
+	s << "\t\tnamespace K = NoiseLang::Kernels;" << std::endl << std::endl;
+	for (std::uint32_t v = 0; v < program.valueRegisters; v++)
+		s << "\t\tdouble " << generator.Value(v) << "[BlockSize];" << std::endl;
+	for (std::uint32_t c = 1; c < program.coordRegisters; c++)
+		s << "\t\tdouble " << generator.Coord(c, 0) << "[BlockSize], " << generator.Coord(c, 1) << "[BlockSize], " << generator.Coord(c, 2) << "[BlockSize];" << std::endl;
+	if (turbulence)
+		s << "\t\tdouble tx[BlockSize], ty[BlockSize], tz[BlockSize], t0[BlockSize], t1[BlockSize], t2[BlockSize];" << std::endl;
+	s << std::endl;
+
+	for (size_t index = 0; index < program.code.size(); index++)
+		generator.EmitInstruction(program.code[index], index);
+
+	s << std::endl << "\t\tstd::copy(" << generator.Value(program.result) << ", " << generator.Value(program.result) << " + count, out);" << std::endl;
+	s << "\t}" << std::endl << std::endl;
+
+	s << "\tinline auto Evaluate(const double* x, const double* y, const double* z, double* out, size_t count) -> void {" << std::endl;
+	s << "\t\tfor (size_t offset = 0; offset < count; offset += BlockSize)" << std::endl;
+	s << "\t\t\tEvaluateBlock(x + offset, y + offset, z + offset, out + offset, std::min(BlockSize, count - offset));" << std::endl;
+	s << "\t}" << std::endl << std::endl;
+
+	s << "\tinline auto GetValue(double x, double y, double z) -> double {" << std::endl;
+	s << "\t\tdouble value;" << std::endl;
+	s << "\t\tEvaluateBlock(&x, &y, &z, &value, 1);" << std::endl;
+	s << "\t\treturn value;" << std::endl;
+	s << "\t}" << std::endl << std::endl;
+
+	s << "}" << std::endl;
+}
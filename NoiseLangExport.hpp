@@ -0,0 +1,471 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "NoiseLangPalette.hpp"
+#include "NoiseLangProgram.hpp"
+#include "NoiseLangTiles.hpp"
+#include "NoiseLangWorkers.hpp"
+
+namespace NoiseLang {
+
+	// The region of the plane a render covers, in world coordinates
+	class Bounds {
+		public:
+			double x0, x1, y0, y1;
+	};
+
+	// One float per sample, rows from the top (lowest y) down
+	class Heightmap {
+		public:
+			unsigned int width = 0, height = 0;
+			std::vector<float> values;
+
+			auto GetSize() const -> size_t;
+
+			// .pfm writes a Portable Float Map, .ppm the samples colored by `palette`, anything
+			// else raw little-endian float32 rows
+			auto Save(const std::string& filename, const NoiseLang::Palette& palette = NoiseLang::Palette()) const -> bool;
+
+		private:
+			auto WritePFM(std::ofstream& file) const -> void;
+			auto WritePPM(std::ofstream& file, const NoiseLang::Palette& palette) const -> void;
+			auto WriteRaw(std::ofstream& file) const -> void;
+	};
+
+	// Renders without a window: the graph is evaluated on the worker pool straight into a
+	// Heightmap, so nothing here touches SDL
+	class Exporter {
+		public:
+			// Rows rendered per task, sized so a band is about this many samples
+			static const size_t BandSamples = 1 << 16;
+
+			static auto Render(const NoiseLang::Program& program, NoiseLang::WorkerPool& workers, unsigned int width, unsigned int height, const NoiseLang::Bounds& bounds, double z = 0.0) -> NoiseLang::Heightmap;
+
+			// Renders into an opened TileWriter, one task and one pwrite per tile, so memory is a
+			// tile per worker whatever the size. Returns the number of samples clamped to the
+			// file's range, sets `ok` false if a write failed.
+			static auto RenderTiles(const NoiseLang::Program& program, NoiseLang::WorkerPool& workers, NoiseLang::TileWriter& writer, double z, bool& ok) -> size_t;
+	};
+
+	// Where a stream is, handed to the progress callback after every chunk
+	class StreamProgress {
+		public:
+			unsigned int rowsDone;
+			unsigned int height;
+			// Row this run picked up from, 0 unless it resumed an interrupted stream
+			unsigned int resumedAt;
+			size_t chunksDone;
+			size_t chunkCount;
+			// Since this run started
+			double seconds;
+	};
+
+	// Generates worlds larger than memory. Rows are evaluated a chunk at a time on the workers and
+	// written straight to their place in the file, so only one chunk is ever held. A journal next
+	// to the file records the rows already on disk and a stream that was interrupted carries on
+	// from there when it is run again with the same program, size and bounds.
+	class Stream {
+		public:
+			using Callback = std::function<void(const NoiseLang::StreamProgress&)>;
+
+			static const size_t DefaultMemoryBudget = 1024ull * 1024 * 1024;
+
+		private:
+			std::shared_ptr<const NoiseLang::Program> program;
+			unsigned int width, height;
+			NoiseLang::Bounds bounds;
+			double z;
+			size_t memoryBudget;
+			Callback progress;
+			std::string error;
+			unsigned int chunkRows;
+			size_t bufferSize;
+
+			auto Fail(const std::string& message) -> bool;
+			auto GetSignature(bool pfm) -> std::string;
+			auto ReadJournal(const std::string& path, const std::string& signature, unsigned int& rowsDone) -> bool;
+			auto WriteJournal(const std::string& path, const std::string& signature, unsigned int rowsDone) -> bool;
+			static auto WriteAt(int file, const void* data, size_t size, size_t offset) -> bool;
+
+		public:
+			Stream(std::shared_ptr<const NoiseLang::Program> program, unsigned int width, unsigned int height, const NoiseLang::Bounds& bounds, double z = 0.0);
+
+			auto SetMemoryBudget(size_t bytes) -> void;
+			auto SetProgressCallback(Callback callback) -> void;
+
+			// Writes `filename` like Heightmap::Save would, returns false and sets GetError() on failure
+			auto Run(NoiseLang::WorkerPool& workers, const std::string& filename) -> bool;
+
+			auto GetError() -> std::string;
+			// What the last Run settled on within the budget
+			auto GetChunkRows() -> unsigned int;
+			auto GetBufferSize() -> size_t;
+	};
+
+	// High water mark of the process's resident memory, in bytes
+	auto GetPeakMemory() -> size_t;
+
+}
+
+auto NoiseLang::Heightmap::GetSize() const -> size_t {
+	return this->values.size() * sizeof(float);
+}
+
+auto NoiseLang::Heightmap::Save(const std::string& filename, const NoiseLang::Palette& palette) const -> bool {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file)
+		return false;
+
+	std::string extension = filename.substr(std::min(filename.size(), filename.rfind('.')));
+	if (extension == ".pfm" || extension == ".PFM")
+		this->WritePFM(file);
+	else if (extension == ".ppm" || extension == ".PPM")
+		this->WritePPM(file, palette);
+	else
+		this->WriteRaw(file);
+
+	file.close();
+	return !file.fail();
+}
+
+auto NoiseLang::Heightmap::WritePFM(std::ofstream& file) const -> void {
+	// A negative scale marks the floats little-endian; PFM stores the bottom row first
+	file << "Pf\n" << this->width << " " << this->height << "\n-1.0\n";
+	for (unsigned int row = this->height; row-- > 0;)
+		file.write(reinterpret_cast<const char*>(&this->values[static_cast<size_t>(row) * this->width]), static_cast<std::streamsize>(this->width * sizeof(float)));
+}
+
+auto NoiseLang::Heightmap::WritePPM(std::ofstream& file, const NoiseLang::Palette& palette) const -> void {
+	// PPM has no alpha, so it is dropped after coloring
+	std::vector<std::uint8_t> rgba(this->values.size() * 4);
+	palette.Apply(this->values.data(), rgba.data(), this->width, this->height);
+	for (size_t i = 0; i < this->values.size(); i++)
+		for (size_t c = 0; c < 3; c++)
+			rgba[i * 3 + c] = rgba[i * 4 + c];
+	file << "P6\n" << this->width << " " << this->height << "\n255\n";
+	file.write(reinterpret_cast<const char*>(rgba.data()), static_cast<std::streamsize>(this->values.size() * 3));
+}
+
+auto NoiseLang::Heightmap::WriteRaw(std::ofstream& file) const -> void {
+	file.write(reinterpret_cast<const char*>(this->values.data()), static_cast<std::streamsize>(this->GetSize()));
+}
+
+auto NoiseLang::Exporter::Render(const NoiseLang::Program& program, NoiseLang::WorkerPool& workers, unsigned int width, unsigned int height, const NoiseLang::Bounds& bounds, double z) -> NoiseLang::Heightmap {
+	auto heightmap = NoiseLang::Heightmap();
+	heightmap.width = width;
+	heightmap.height = height;
+	heightmap.values.resize(static_cast<size_t>(width) * height);
+
+	double stepX = (bounds.x1 - bounds.x0) / width;
+	double stepY = (bounds.y1 - bounds.y0) / height;
+
+	unsigned int bandRows = static_cast<unsigned int>(std::max<size_t>(1, BandSamples / std::max(1u, width)));
+	size_t bands = (height + bandRows - 1) / bandRows;
+
+	// Per worker, so the only thing shared between tasks is the heightmap they write disjoint rows of
+	class Scratch {
+		public:
+			NoiseLang::ProgramEvaluator evaluator;
+			std::vector<double> values;
+	};
+	std::vector<Scratch> scratch(workers.GetThreadCount());
+
+	workers.Run(bands, [&](size_t band, unsigned int worker){
+		unsigned int row = static_cast<unsigned int>(band) * bandRows;
+		unsigned int rows = std::min(bandRows, height - row);
+
+		auto& s = scratch[worker];
+		s.values.resize(width);
+
+		// A row at a time with y computed from the row index, so streams of the same bounds match exactly
+		for (unsigned int y = row; y < row + rows; y++){
+			s.evaluator.EvaluateGrid(program, NoiseLang::PointGrid(bounds.x0, bounds.y0 + y * stepY, z, stepX, stepY, width, 1), s.values.data());
+
+			float* out = &heightmap.values[static_cast<size_t>(y) * width];
+			for (unsigned int x = 0; x < width; x++)
+				out[x] = static_cast<float>(s.values[x]);
+		}
+	});
+
+	return heightmap;
+}
+
+// {{{ Stream
+NoiseLang::Stream::Stream(std::shared_ptr<const NoiseLang::Program> program, unsigned int width, unsigned int height, const NoiseLang::Bounds& bounds, double z) {
+	this->program = std::move(program);
+	this->width = width;
+	this->height = height;
+	this->bounds = bounds;
+	this->z = z;
+	this->memoryBudget = DefaultMemoryBudget;
+	this->progress = [](const NoiseLang::StreamProgress&){};
+	this->chunkRows = 0;
+	this->bufferSize = 0;
+}
+
+auto NoiseLang::Stream::SetMemoryBudget(size_t bytes) -> void {
+	this->memoryBudget = bytes;
+}
+
+auto NoiseLang::Stream::SetProgressCallback(Callback callback) -> void {
+	this->progress = std::move(callback);
+}
+
+auto NoiseLang::Stream::GetError() -> std::string {
+	return this->error;
+}
+
+auto NoiseLang::Stream::GetChunkRows() -> unsigned int {
+	return this->chunkRows;
+}
+
+auto NoiseLang::Stream::GetBufferSize() -> size_t {
+	return this->bufferSize;
+}
+
+auto NoiseLang::Stream::Fail(const std::string& message) -> bool {
+	this->error = message;
+	return false;
+}
+
+auto NoiseLang::Stream::GetSignature(bool pfm) -> std::string {
+	// Everything that decides what ends up in the file, a resumed stream has to match all of it
+	std::ostringstream signature;
+	signature << std::setprecision(17) << this->width << " " << this->height << " " << this->bounds.x0 << " " << this->bounds.x1 << " " << this->bounds.y0 << " " << this->bounds.y1 << " " << this->z << " " << (pfm ? "pfm" : "raw") << " " << std::hex << this->program->GetHash();
+	return signature.str();
+}
+
+auto NoiseLang::Stream::ReadJournal(const std::string& path, const std::string& signature, unsigned int& rowsDone) -> bool {
+	std::ifstream journal(path);
+	std::string magic, recorded;
+	if (!std::getline(journal, magic) || magic != "noiselang stream 1" || !std::getline(journal, recorded) || !(journal >> rowsDone))
+		return this->Fail(path + " is not a stream journal, delete it to start over");
+	if (recorded != signature)
+		return this->Fail(path + " belongs to a stream with a different program, size or bounds, delete it to start over");
+	return true;
+}
+
+auto NoiseLang::Stream::WriteJournal(const std::string& path, const std::string& signature, unsigned int rowsDone) -> bool {
+	// Written aside and renamed over the old one, so a crash never leaves half a journal
+	std::string temporary = path + ".tmp";
+	{
+		std::ofstream journal(temporary);
+		journal << "noiselang stream 1\n" << signature << "\n" << rowsDone << "\n";
+		journal.close();
+		if (journal.fail())
+			return false;
+	}
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+auto NoiseLang::Stream::WriteAt(int file, const void* data, size_t size, size_t offset) -> bool {
+	auto bytes = static_cast<const char*>(data);
+	while (size > 0){
+		ssize_t written = pwrite(file, bytes, size, static_cast<off_t>(offset));
+		if (written <= 0)
+			return false;
+		bytes += written;
+		offset += static_cast<size_t>(written);
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+auto NoiseLang::Stream::Run(NoiseLang::WorkerPool& workers, const std::string& filename) -> bool {
+	this->error.clear();
+
+	std::string extension = filename.substr(std::min(filename.size(), filename.rfind('.')));
+	bool pfm = extension == ".pfm" || extension == ".PFM";
+	std::string signature = this->GetSignature(pfm);
+	std::string journalPath = filename + ".progress";
+
+	// The budget pays for one float chunk plus each worker's row of doubles and register file
+	size_t rowBytes = static_cast<size_t>(this->width) * sizeof(float);
+	size_t registers = this->program->valueRegisters + 3 * this->program->coordRegisters + 6;
+	size_t scratchBytes = workers.GetThreadCount() * (static_cast<size_t>(this->width) * sizeof(double) + registers * NoiseLang::ProgramEvaluator::DefaultBlockSize * sizeof(double));
+	if (this->memoryBudget < scratchBytes + rowBytes){
+		std::ostringstream message;
+		message << "A memory budget of " << this->memoryBudget / 1048576.0 << " MiB can't hold a " << this->width << " sample row, it needs at least " << (scratchBytes + rowBytes) / 1048576.0 << " MiB";
+		return this->Fail(message.str());
+	}
+	this->chunkRows = static_cast<unsigned int>(std::min<size_t>(this->height, (this->memoryBudget - scratchBytes) / rowBytes));
+	this->bufferSize = scratchBytes + this->chunkRows * rowBytes;
+
+	// Pick up where a previous run of the same stream stopped
+	unsigned int rowsDone = 0;
+	bool resuming = std::ifstream(journalPath).good();
+	if (resuming && !this->ReadJournal(journalPath, signature, rowsDone))
+		return false;
+
+	int file = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+	if (file < 0)
+		return this->Fail("Couldn't open " + filename);
+
+	std::string header = pfm ? "Pf\n" + std::to_string(this->width) + " " + std::to_string(this->height) + "\n-1.0\n" : "";
+	size_t dataSize = static_cast<size_t>(this->height) * rowBytes;
+
+	// A fresh stream sizes the whole file up front, the rows are then filled in wherever they fall
+	if (resuming && lseek(file, 0, SEEK_END) != static_cast<off_t>(header.size() + dataSize)){
+		close(file);
+		return this->Fail(filename + " doesn't match " + journalPath + ", delete the journal to start over");
+	} else if (!resuming){
+		if (ftruncate(file, 0) != 0 || ftruncate(file, static_cast<off_t>(header.size() + dataSize)) != 0 || !WriteAt(file, header.data(), header.size(), 0) || !this->WriteJournal(journalPath, signature, 0)){
+			close(file);
+			return this->Fail("Couldn't make room for " + filename + " on disk");
+		}
+	}
+
+	double stepX = (this->bounds.x1 - this->bounds.x0) / this->width;
+	double stepY = (this->bounds.y1 - this->bounds.y0) / this->height;
+	unsigned int taskRows = static_cast<unsigned int>(std::max<size_t>(1, NoiseLang::Exporter::BandSamples / this->width));
+
+	class Scratch {
+		public:
+			NoiseLang::ProgramEvaluator evaluator;
+			std::vector<double> values;
+	};
+	std::vector<Scratch> scratch(workers.GetThreadCount());
+	std::vector<float> chunk(static_cast<size_t>(this->chunkRows) * this->width);
+
+	auto progress = NoiseLang::StreamProgress();
+	progress.height = this->height;
+	progress.resumedAt = rowsDone;
+	progress.chunksDone = 0;
+	progress.chunkCount = (this->height - rowsDone + this->chunkRows - 1) / this->chunkRows;
+	auto start = std::chrono::high_resolution_clock::now();
+
+	while (rowsDone < this->height){
+		unsigned int first = rowsDone;
+		unsigned int rows = std::min(this->chunkRows, this->height - first);
+		size_t tasks = (rows + taskRows - 1) / taskRows;
+
+		workers.Run(tasks, [&](size_t task, unsigned int worker){
+			auto& s = scratch[worker];
+			s.values.resize(this->width);
+
+			unsigned int end = std::min(rows, static_cast<unsigned int>(task + 1) * taskRows);
+			for (unsigned int row = static_cast<unsigned int>(task) * taskRows; row < end; row++){
+				double y = this->bounds.y0 + (first + row) * stepY;
+				s.evaluator.EvaluateGrid(*this->program, NoiseLang::PointGrid(this->bounds.x0, y, this->z, stepX, stepY, this->width, 1), s.values.data());
+
+				float* out = &chunk[static_cast<size_t>(row) * this->width];
+				for (unsigned int x = 0; x < this->width; x++)
+					out[x] = static_cast<float>(s.values[x]);
+			}
+		});
+
+		// Raw rows are one contiguous run, PFM stores them bottom up so each goes on its own
+		bool written = true;
+		if (pfm){
+			for (unsigned int row = 0; row < rows && written; row++)
+				written = WriteAt(file, &chunk[static_cast<size_t>(row) * this->width], rowBytes, header.size() + (this->height - 1 - (first + row)) * rowBytes);
+		} else {
+			written = WriteAt(file, chunk.data(), rows * rowBytes, static_cast<size_t>(first) * rowBytes);
+		}
+
+		// Only journal rows once they're known to be on disk
+		if (!written || fsync(file) != 0){
+			close(file);
+			return this->Fail("Couldn't write rows " + std::to_string(first) + " to " + std::to_string(first + rows) + " of " + filename);
+		}
+		rowsDone = first + rows;
+		if (!this->WriteJournal(journalPath, signature, rowsDone)){
+			close(file);
+			return this->Fail("Couldn't record rows " + std::to_string(first) + " to " + std::to_string(first + rows) + " of " + filename + " in " + journalPath);
+		}
+
+		progress.rowsDone = rowsDone;
+		progress.chunksDone++;
+		progress.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		this->progress(progress);
+	}
+
+	close(file);
+	std::remove(journalPath.c_str());
+	return true;
+}
+// }}}
+
+auto NoiseLang::Exporter::RenderTiles(const NoiseLang::Program& program, NoiseLang::WorkerPool& workers, NoiseLang::TileWriter& writer, double z, bool& ok) -> size_t {
+	auto& h = writer.GetHeader();
+	double stepX = (h.bounds[1] - h.bounds[0]) / h.width;
+	double stepY = (h.bounds[3] - h.bounds[2]) / h.height;
+	double spacing = std::max(std::fabs(stepX), std::fabs(stepY));
+
+	// Computed the way EvaluateGrid does, so tiles hold exactly what `render` would have written
+	std::vector<double> columns(h.width);
+	for (unsigned int x = 0; x < h.width; x++)
+		columns[x] = h.bounds[0] + x * stepX;
+
+	class Scratch {
+		public:
+			NoiseLang::ProgramEvaluator evaluator;
+			std::vector<double> ys, zs, values;
+			std::vector<float> tile;
+	};
+	std::vector<Scratch> scratch(workers.GetThreadCount());
+	std::atomic<size_t> clamped(0);
+	std::atomic<bool> failed(false);
+
+	workers.Run(static_cast<size_t>(h.tilesX) * h.tilesY, [&](size_t tile, unsigned int worker){
+		unsigned int tileX = static_cast<unsigned int>(tile % h.tilesX);
+		unsigned int tileY = static_cast<unsigned int>(tile / h.tilesX);
+		unsigned int x0 = tileX * h.tileSize, y0 = tileY * h.tileSize;
+		unsigned int columnCount = std::min(h.tileSize, h.width - x0);
+		unsigned int rowCount = std::min(h.tileSize, h.height - y0);
+
+		// Edge tiles keep zeros in their padding
+		auto& s = scratch[worker];
+		s.tile.assign(static_cast<size_t>(h.tileSize) * h.tileSize, 0.0f);
+		s.ys.resize(columnCount);
+		s.zs.assign(columnCount, z);
+		s.values.resize(columnCount);
+
+		for (unsigned int row = 0; row < rowCount; row++){
+			std::fill(s.ys.begin(), s.ys.end(), h.bounds[2] + (y0 + row) * stepY);
+			s.evaluator.Evaluate(program, &columns[x0], s.ys.data(), s.zs.data(), s.values.data(), columnCount, spacing);
+
+			float* out = &s.tile[static_cast<size_t>(row) * h.tileSize];
+			for (unsigned int x = 0; x < columnCount; x++)
+				out[x] = static_cast<float>(s.values[x]);
+		}
+
+		bool written;
+		clamped += writer.WriteTile(tileX, tileY, s.tile.data(), written);
+		if (!written)
+			failed = true;
+	});
+
+	ok = !failed;
+	return clamped;
+}
+
+auto NoiseLang::GetPeakMemory() -> size_t {
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+
+	// macOS reports bytes, Linux kilobytes
+#ifdef __APPLE__
+	return static_cast<size_t>(usage.ru_maxrss);
+#else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+namespace NoiseLang {
+
+	// Where the viewer stands over the last few seconds of frames. Times are in seconds.
+	class FrameSummary {
+		public:
+			size_t frames;
+			// Frames actually presented per second, pacing included
+			double fps;
+			// The slower of evaluating and presenting a frame, pacing excluded. The viewer overlaps
+			// the two, so this is what bounds its frame rate.
+			double p50, p95, p99, worst;
+			// Pixels per second of that slower stage
+			double samplesPerSecond;
+	};
+
+	// A rolling window of frame times, written by the render thread and read by the REPL
+	class FrameStats {
+		public:
+			static const size_t DefaultWindow = 240;
+
+		private:
+			class Frame {
+				public:
+					double busy, interval;
+					size_t samples;
+			};
+
+			std::mutex mutex;
+			std::vector<Frame> frames;
+			size_t next;
+			size_t window;
+
+		public:
+			FrameStats(size_t window = DefaultWindow);
+
+			// `busy` is the time the frame took to render, `interval` the time since the previous one was shown
+			auto Record(double busy, double interval, size_t samples) -> void;
+			auto GetSummary() -> NoiseLang::FrameSummary;
+			auto Clear() -> void;
+	};
+
+}
+
+NoiseLang::FrameStats::FrameStats(size_t window) {
+	this->window = std::max<size_t>(window, 1);
+	this->next = 0;
+}
+
+auto NoiseLang::FrameStats::Record(double busy, double interval, size_t samples) -> void {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	auto frame = Frame{busy, interval, samples};
+	if (this->frames.size() < this->window)
+		this->frames.push_back(frame);
+	else
+		this->frames[this->next] = frame;
+	this->next = (this->next + 1) % this->window;
+}
+
+auto NoiseLang::FrameStats::GetSummary() -> NoiseLang::FrameSummary {
+	std::vector<double> busy;
+	double busyTotal = 0.0, intervalTotal = 0.0, samples = 0.0;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (auto& f : this->frames){
+			busy.push_back(f.busy);
+			busyTotal += f.busy;
+			intervalTotal += f.interval;
+			samples += static_cast<double>(f.samples);
+		}
+	}
+
+	auto summary = NoiseLang::FrameSummary{busy.size(), 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+	if (busy.empty())
+		return summary;
+
+	// Nearest rank, so p99 of a short window is its worst frame rather than an interpolation
+	std::sort(busy.begin(), busy.end());
+	auto percentile = [&busy](double p){
+		size_t rank = static_cast<size_t>(p * static_cast<double>(busy.size()) + 0.999999);
+		return busy[std::min(std::max<size_t>(rank, 1), busy.size()) - 1];
+	};
+	summary.p50 = percentile(0.50);
+	summary.p95 = percentile(0.95);
+	summary.p99 = percentile(0.99);
+	summary.worst = busy.back();
+	summary.fps = intervalTotal > 0.0 ? static_cast<double>(busy.size()) / intervalTotal : 0.0;
+	summary.samplesPerSecond = busyTotal > 0.0 ? samples / busyTotal : 0.0;
+	return summary;
+}
+
+auto NoiseLang::FrameStats::Clear() -> void {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->frames.clear();
+	this->next = 0;
+}
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace NoiseLang {
+
+	// A color at a position along the palette, like a point of libnoise's GradientColor
+	class PaletteStop {
+		public:
+			double position;
+			std::uint8_t r, g, b, a;
+	};
+
+	// Maps samples to RGBA8 pixels through a table built from gradient stops, so coloring a frame
+	// is a clamp and a lookup per pixel rather than a call. Values past the first and last stop
+	// take their colors.
+	class Palette {
+		public:
+			static const size_t Entries = 4096;
+
+		private:
+			std::vector<NoiseLang::PaletteStop> stops;
+			// Entries colors from the first stop to the last, each the r, g, b, a bytes in memory order
+			std::vector<std::uint32_t> table;
+			float low, scale;
+			double shade;
+
+			auto Build() -> void;
+			auto GetColor(double position) const -> std::uint32_t;
+
+		public:
+			// Black at -1 to white at 1, what the viewer has always shown
+			Palette();
+
+			// Replaces the stops with "gray" or "terrain", libnoise's terrain gradient. False for
+			// any other name.
+			auto SetPreset(const std::string& name) -> bool;
+			// A stop at the position of an existing one replaces it
+			auto AddStop(const NoiseLang::PaletteStop& stop) -> void;
+			auto Clear() -> void;
+			auto GetStops() const -> const std::vector<NoiseLang::PaletteStop>&;
+
+			// Lights the samples as a height field from the top left, slopes exaggerated by
+			// `shade` per pixel. 0 leaves the colors flat.
+			auto SetShade(double shade) -> void;
+			auto GetShade() const -> double;
+
+			// Colors `width` by `height` samples, rows from the top, into as many RGBA8 pixels.
+			// Shading reads each sample's neighbours, so it takes the whole image at once.
+			auto Apply(const float* samples, std::uint8_t* pixels, unsigned int width, unsigned int height) const -> void;
+	};
+
+}
+
+NoiseLang::Palette::Palette() {
+	this->shade = 0.0;
+	this->SetPreset("gray");
+}
+
+auto NoiseLang::Palette::SetPreset(const std::string& name) -> bool {
+	if (name == "gray"){
+		this->stops = {{-1.0, 0, 0, 0, 255}, {1.0, 255, 255, 255, 255}};
+	} else if (name == "terrain"){
+		// noise::utils::RendererImage::BuildTerrainGradient
+		this->stops = {
+			{-1.00, 0, 0, 128, 255},
+			{-0.20, 32, 64, 128, 255},
+			{-0.04, 64, 96, 192, 255},
+			{-0.02, 192, 192, 128, 255},
+			{0.00, 0, 192, 0, 255},
+			{0.25, 192, 192, 0, 255},
+			{0.50, 160, 96, 64, 255},
+			{0.75, 128, 255, 255, 255},
+			{1.00, 255, 255, 255, 255}
+		};
+	} else {
+		return false;
+	}
+	this->Build();
+	return true;
+}
+
+auto NoiseLang::Palette::AddStop(const NoiseLang::PaletteStop& stop) -> void {
+	auto it = std::lower_bound(this->stops.begin(), this->stops.end(), stop.position, [](const NoiseLang::PaletteStop& s, double position){ return s.position < position; });
+	if (it != this->stops.end() && it->position == stop.position)
+		*it = stop;
+	else
+		this->stops.insert(it, stop);
+	this->Build();
+}
+
+auto NoiseLang::Palette::Clear() -> void {
+	this->stops.clear();
+	this->Build();
+}
+
+auto NoiseLang::Palette::GetStops() const -> const std::vector<NoiseLang::PaletteStop>& {
+	return this->stops;
+}
+
+auto NoiseLang::Palette::SetShade(double shade) -> void {
+	this->shade = std::max(shade, 0.0);
+}
+
+auto NoiseLang::Palette::GetShade() const -> double {
+	return this->shade;
+}
+
+auto NoiseLang::Palette::GetColor(double position) const -> std::uint32_t {
+	std::uint8_t rgba[4] = {0, 0, 0, 255};
+	auto& stops = this->stops;
+
+	if (stops.size() == 1 || (stops.size() > 1 && position <= stops.front().position)){
+		rgba[0] = stops.front().r; rgba[1] = stops.front().g; rgba[2] = stops.front().b; rgba[3] = stops.front().a;
+	} else if (stops.size() > 1 && position >= stops.back().position){
+		rgba[0] = stops.back().r; rgba[1] = stops.back().g; rgba[2] = stops.back().b; rgba[3] = stops.back().a;
+	} else if (stops.size() > 1){
+		// The first stop past the position and the one before it, blended linearly as GradientColor does
+		size_t i = 1;
+		while (stops[i].position < position)
+			i++;
+		auto& a = stops[i - 1];
+		auto& b = stops[i];
+		double t = (position - a.position) / (b.position - a.position);
+		auto lerp = [t](std::uint8_t x, std::uint8_t y){ return static_cast<std::uint8_t>(std::lround(x + (y - x) * t)); };
+		rgba[0] = lerp(a.r, b.r); rgba[1] = lerp(a.g, b.g); rgba[2] = lerp(a.b, b.b); rgba[3] = lerp(a.a, b.a);
+	}
+
+	std::uint32_t color;
+	std::memcpy(&color, rgba, sizeof(color));
+	return color;
+}
+
+auto NoiseLang::Palette::Build() -> void {
+	// Without two distinct stops every entry is the same color, and any scale will do
+	double low = -1.0, high = 1.0;
+	if (this->stops.size() > 1 && this->stops.back().position > this->stops.front().position){
+		low = this->stops.front().position;
+		high = this->stops.back().position;
+	}
+
+	this->table.resize(Entries);
+	for (size_t i = 0; i < Entries; i++)
+		this->table[i] = this->GetColor(low + (high - low) * static_cast<double>(i) / (Entries - 1));
+
+	this->low = static_cast<float>(low);
+	this->scale = static_cast<float>((Entries - 1) / (high - low));
+}
+
+auto NoiseLang::Palette::Apply(const float* samples, std::uint8_t* pixels, unsigned int width, unsigned int height) const -> void {
+	std::vector<std::int32_t> index(width);
+	std::vector<std::int32_t> light(this->shade > 0.0 ? width : 0);
+
+	const std::uint32_t* table = this->table.data();
+	const float low = this->low, scale = this->scale;
+	const float top = static_cast<float>(Entries - 1);
+	const float k = static_cast<float>(this->shade * 0.5);
+
+	// How much a sample with these slopes is lit, in 8.8 fixed point. The light comes from
+	// (-1, -1, 1), and a flat sample is scaled by 1, a quarter of that ambient.
+	auto lit = [](float gx, float gy){
+		// 1 / sqrt(q) from the exponent trick and two Newton steps, about 5e-6 off. std::sqrt sets
+		// errno, which keeps the loop from vectorizing.
+		float q = gx * gx + gy * gy + 1.0f;
+		float r = __builtin_bit_cast(float, 0x5f3759dfu - (__builtin_bit_cast(std::uint32_t, q) >> 1));
+		r = r * (1.5f - 0.5f * q * r * r);
+		r = r * (1.5f - 0.5f * q * r * r);
+		// At most sqrt(3) for finite slopes. NaN converts to INT_MIN and is clamped to 0 as an
+		// integer, a float clamp would stop the loop vectorizing too.
+		float lambert = std::max(0.0f, gx + gy + 1.0f) * r;
+		return std::max<std::int32_t>(0, static_cast<std::int32_t>((0.25f + 0.75f * lambert) * 256.0f));
+	};
+
+	for (unsigned int y = 0; y < height; y++){
+		const float* row = samples + static_cast<size_t>(y) * width;
+		std::uint8_t* out = pixels + static_cast<size_t>(y) * width * 4;
+
+		// Clamping before the conversion keeps NaN and far off samples in the table; max(0, NaN) is 0
+		for (size_t x = 0; x < width; x++)
+			index[x] = static_cast<std::int32_t>(std::min(std::max(0.0f, (row[x] - low) * scale + 0.5f), top));
+
+		for (size_t x = 0; x < width; x++)
+			std::memcpy(out + x * 4, &table[index[x]], 4);
+		if (light.empty())
+			continue;
+
+		// Central differences, one sided at the edges, then the colors scaled in place. A one sided
+		// difference spans one sample instead of two, so it's scaled by twice as much.
+		const float* above = samples + static_cast<size_t>(y > 0 ? y - 1 : y) * width;
+		const float* below = samples + static_cast<size_t>(y + 1 < height ? y + 1 : y) * width;
+		const float ky = (y > 0 && y + 1 < height) ? k : 2.0f * k;
+		std::int32_t* l = light.data();
+		for (size_t x = 1; x + 1 < width; x++)
+			l[x] = lit((row[x + 1] - row[x - 1]) * k, (below[x] - above[x]) * ky);
+		l[0] = lit((row[width > 1 ? 1 : 0] - row[0]) * 2.0f * k, (below[0] - above[0]) * ky);
+		if (width > 1)
+			l[width - 1] = lit((row[width - 1] - row[width - 2]) * 2.0f * k, (below[width - 1] - above[width - 1]) * ky);
+
+		for (size_t x = 0; x < width; x++)
+			for (size_t c = 0; c < 3; c++)
+				out[x * 4 + c] = static_cast<std::uint8_t>(std::min<std::int32_t>(255, (out[x * 4 + c] * l[x]) >> 8));
+	}
+}
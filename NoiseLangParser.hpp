@@ -0,0 +1,789 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "NoiseLangRegistry.hpp"
+
+namespace NoiseLang {
+
+	// {{{ Statements, one per line of a script
+	class Argument {
+		public:
+			NoiseLang::ArgumentType type = NoiseLang::ArgumentType::Number;
+			std::string identifier;
+			double number = 0.0;
+	};
+
+	class Assignment {
+		public:
+			std::string identifier;
+			std::string module;
+			const NoiseLang::ModuleSpec* kind = nullptr;
+			std::vector<std::string> arguments;
+	};
+
+	class Method {
+		public:
+			std::string identifier;
+			std::string method;
+			int methodId = -1;
+			std::vector<NoiseLang::Argument> arguments;
+
+			auto Print() -> void {
+				std::cout << "(IDENTIFIER: \"" << this->identifier << "\") -> (METHOD: \"" << this->method << "\") (ARGUMENTS: [";
+				for (auto& arg : this->arguments){
+					if (arg.type == NoiseLang::ArgumentType::Number)
+						std::cout << arg.number << ", ";
+					else
+						std::cout << "\"" << arg.identifier << "\", ";
+				}
+				std::cout << "]);" << std::endl;
+			}
+	};
+
+	class Out {
+		public:
+			std::string identifier;
+	};
+
+	class Save {
+		public:
+			std::string filename;
+	};
+
+	class Load {
+		public:
+			std::string filename;
+	};
+
+	class Compile {
+		public:
+			std::string filename;
+	};
+
+	class Show {
+		public:
+			int width;
+			int height;
+	};
+
+	// Also filled in by `stream` and `tiles`, which take the same arguments, and by `profile`
+	// whose file name is optional
+	class Render {
+		public:
+			std::string identifier;
+			int width;
+			int height;
+			std::string filename;
+
+			// `tiles` only, 16-bit samples rather than floats
+			bool quantized;
+
+			// x0 x1 y0 y1, the viewer's 100 pixels per unit when not given
+			bool hasBounds;
+			double bounds[4];
+	};
+
+	class Budget {
+		public:
+			int megabytes;
+	};
+
+	class Threads {
+		public:
+			int count;
+	};
+
+	class CacheSize {
+		public:
+			// Without a size the line only reports on the cache
+			bool hasSize;
+			int megabytes;
+	};
+
+	class FrameRate {
+		public:
+			// 0 doesn't pace the viewer at all
+			int fps;
+	};
+
+	class Stats {
+		public:
+			// Print once, keep them in the viewer's window title, or take them back out of it
+			enum class Mode {Print, Title, Off};
+			Mode mode;
+	};
+
+	class PrecisionMode {
+		public:
+			// Print reports the precision in use without changing it
+			enum class Mode {Print, Float, Double};
+			Mode mode;
+	};
+
+	class TableMode {
+		public:
+			// Print reports the current setting, Bound sets the error curves and terraces may take on
+			enum class Mode {Print, Bound, Off};
+			Mode mode;
+			double error;
+	};
+
+	class LodMode {
+		public:
+			// Print reports whether octaves are culled without changing it
+			enum class Mode {Print, On, Off};
+			Mode mode;
+	};
+
+	class ViewCommand {
+		public:
+			// Print reports the view, Set moves it to x y and, when given, a scale in world units
+			// per pixel, Reset goes back to where the viewer starts
+			enum class Mode {Print, Set, Reset};
+			Mode mode;
+			double x, y;
+			bool hasScale;
+			double scale;
+	};
+
+	class PaletteCommand {
+		public:
+			// Print lists the stops, Preset replaces them with a named gradient, Stop adds one,
+			// Clear removes them all and Shade sets how strongly slopes are lit
+			enum class Mode {Print, Preset, Stop, Clear, Shade};
+			Mode mode;
+			std::string preset;
+			double position;
+			int color[4];
+			// 0 turns shading off
+			double shade;
+	};
+
+	// The parsed form of a line. Only the member matching `type` is filled in; the
+	// others keep their buffers so parsing the next line doesn't have to allocate.
+	class Statement {
+		public:
+			enum class Type {Empty, Assignment, Method, Out, Save, Load, Compile, Show, Render, Stream, Tiles, Budget, Threads, TileCache, NodeCache, Profile, FrameRate, Stats, Precision, Table, Lod, Palette, View, Optimize, Exit};
+
+			Type type = Type::Empty;
+			NoiseLang::Assignment assignment;
+			NoiseLang::Method method;
+			NoiseLang::Out out;
+			NoiseLang::Save save;
+			NoiseLang::Load load;
+			NoiseLang::Compile compile;
+			NoiseLang::Show show;
+			NoiseLang::Render render;
+			NoiseLang::Threads threads;
+			NoiseLang::Budget budget;
+			NoiseLang::CacheSize cacheSize;
+			NoiseLang::FrameRate frameRate;
+			NoiseLang::Stats stats;
+			NoiseLang::PrecisionMode precision;
+			NoiseLang::TableMode table;
+			NoiseLang::LodMode lod;
+			NoiseLang::PaletteCommand palette;
+			NoiseLang::ViewCommand view;
+	};
+	// }}}
+
+	enum class TokenType {Identifier, Number, Word, Equals, Arrow, LeftParen, RightParen, Comma, End, Invalid};
+
+	// Tokens point into the line being parsed rather than owning their text
+	class Token {
+		public:
+			TokenType type;
+			std::string_view text;
+			size_t column;
+			double number;
+	};
+
+	class Lexer {
+		private:
+			std::string_view line;
+			size_t position;
+
+			auto SkipWhitespace() -> void;
+
+		public:
+			Lexer(std::string_view line = "");
+
+			auto Next() -> NoiseLang::Token;
+			auto Peek() -> NoiseLang::Token;
+
+			// The next run of non-blank characters as a single token, for file names and sizes
+			auto Word() -> NoiseLang::Token;
+	};
+
+	// Recursive descent over the grammar in NoiseLangGrammar.txt, a line at a time
+	class Parser {
+		private:
+			NoiseLang::Lexer lexer;
+			std::string error;
+
+			auto Fail(const NoiseLang::Token& at, const std::string& message) -> bool;
+			auto Expect(TokenType type, const char* what, NoiseLang::Token& token) -> bool;
+			auto ExpectEnd() -> bool;
+			auto ParseAssignment(const NoiseLang::Token& identifier, NoiseLang::Assignment& assignment) -> bool;
+			auto ParseMethod(const NoiseLang::Token& identifier, NoiseLang::Method& method) -> bool;
+			auto ParseInteger(std::string_view digits, size_t maxDigits, int& value) -> bool;
+			auto ParseSize(const NoiseLang::Token& size, size_t maxDigits, int& width, int& height) -> bool;
+			auto ParseKeyword(const NoiseLang::Token& keyword, NoiseLang::Statement& statement) -> bool;
+
+		public:
+			// Fills `statement` from `line`. Returns false on a syntax error, GetError() then
+			// says what was expected and at which column.
+			auto Parse(std::string_view line, NoiseLang::Statement& statement) -> bool;
+			auto GetError() -> std::string;
+	};
+
+}
+
+// {{{ Lexer
+NoiseLang::Lexer::Lexer(std::string_view line) {
+	this->line = line;
+	this->position = 0;
+}
+
+auto NoiseLang::Lexer::SkipWhitespace() -> void {
+	while (this->position < this->line.size() && (this->line[this->position] == ' ' || this->line[this->position] == '\t' || this->line[this->position] == '\r'))
+		this->position++;
+}
+
+auto NoiseLang::Lexer::Next() -> NoiseLang::Token {
+	this->SkipWhitespace();
+
+	auto& line = this->line;
+	size_t start = this->position;
+	auto token = NoiseLang::Token();
+	token.column = start + 1;
+	token.number = 0.0;
+
+	auto isAlpha = [](char c){ return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); };
+	auto isDigit = [](char c){ return c >= '0' && c <= '9'; };
+
+	if (start >= line.size()){
+		token.type = TokenType::End;
+		return token;
+	}
+
+	char c = line[start];
+	size_t end = start + 1;
+
+	if (isAlpha(c)){
+		while (end < line.size() && (isAlpha(line[end]) || isDigit(line[end])))
+			end++;
+		token.type = TokenType::Identifier;
+	} else if (c == '-' && end < line.size() && line[end] == '>'){
+		end++;
+		token.type = TokenType::Arrow;
+	} else if (isDigit(c) || c == '.' || c == '-'){
+		// <number> = -? <digit>* (<period> <digit>+)? <f>?
+		if (c != '-')
+			end = start;
+		while (end < line.size() && isDigit(line[end]))
+			end++;
+		if (end < line.size() && line[end] == '.'){
+			end++;
+			while (end < line.size() && isDigit(line[end]))
+				end++;
+		}
+
+		auto result = std::from_chars(line.data() + start, line.data() + end, token.number);
+		token.type = (result.ec == std::errc() && result.ptr == line.data() + end) ? TokenType::Number : TokenType::Invalid;
+
+		if (end < line.size() && line[end] == 'f')
+			end++;
+	} else {
+		switch (c){
+			case '=': token.type = TokenType::Equals; break;
+			case '(': token.type = TokenType::LeftParen; break;
+			case ')': token.type = TokenType::RightParen; break;
+			case ',': token.type = TokenType::Comma; break;
+			default: token.type = TokenType::Invalid; break;
+		}
+	}
+
+	token.text = line.substr(start, end - start);
+	this->position = end;
+	return token;
+}
+
+auto NoiseLang::Lexer::Peek() -> NoiseLang::Token {
+	size_t position = this->position;
+	auto token = this->Next();
+	this->position = position;
+	return token;
+}
+
+auto NoiseLang::Lexer::Word() -> NoiseLang::Token {
+	this->SkipWhitespace();
+
+	size_t start = this->position;
+	while (this->position < this->line.size() && this->line[this->position] != ' ' && this->line[this->position] != '\t' && this->line[this->position] != '\r')
+		this->position++;
+
+	auto token = NoiseLang::Token();
+	token.type = this->position > start ? TokenType::Word : TokenType::End;
+	token.text = this->line.substr(start, this->position - start);
+	token.column = start + 1;
+	token.number = 0.0;
+	return token;
+}
+// }}}
+
+// {{{ Parser
+auto NoiseLang::Parser::Fail(const NoiseLang::Token& at, const std::string& message) -> bool {
+	this->error = "Column " + std::to_string(at.column) + ": " + message;
+	return false;
+}
+
+auto NoiseLang::Parser::GetError() -> std::string {
+	return this->error;
+}
+
+auto NoiseLang::Parser::Expect(NoiseLang::TokenType type, const char* what, NoiseLang::Token& token) -> bool {
+	token = this->lexer.Next();
+	if (token.type != type)
+		return this->Fail(token, std::string("expected ") + what + (token.type == TokenType::End ? " at end of line" : ", found `" + std::string(token.text) + "`"));
+	return true;
+}
+
+auto NoiseLang::Parser::ExpectEnd() -> bool {
+	auto token = this->lexer.Next();
+	if (token.type != TokenType::End)
+		return this->Fail(token, "unexpected `" + std::string(token.text) + "` after the end of the statement");
+	return true;
+}
+
+auto NoiseLang::Parser::Parse(std::string_view line, NoiseLang::Statement& statement) -> bool {
+	this->lexer = NoiseLang::Lexer(line);
+	this->error.clear();
+
+	auto first = this->lexer.Next();
+	switch (first.type){
+		case TokenType::End:
+			statement.type = Statement::Type::Empty;
+			return true;
+		case TokenType::Identifier:
+			break;
+		default:
+			return this->Fail(first, "expected an identifier or a command, found `" + std::string(first.text) + "`");
+	}
+
+	// Keywords are only keywords when they aren't being assigned to or called
+	auto second = this->lexer.Peek();
+	if (second.type == TokenType::Equals){
+		statement.type = Statement::Type::Assignment;
+		return this->ParseAssignment(first, statement.assignment);
+	}
+	if (second.type == TokenType::Arrow){
+		statement.type = Statement::Type::Method;
+		return this->ParseMethod(first, statement.method);
+	}
+	return this->ParseKeyword(first, statement);
+}
+
+auto NoiseLang::Parser::ParseAssignment(const NoiseLang::Token& identifier, NoiseLang::Assignment& assignment) -> bool {
+	// <assignment> = <identifier> = <module> ( <argument>* <identifier> )
+	NoiseLang::Token token;
+	this->lexer.Next();
+
+	if (!this->Expect(TokenType::Identifier, "a module name", token))
+		return false;
+	auto kind = NoiseLang::Registry::Get().FindKind(token.text);
+	if (kind == nullptr)
+		return this->Fail(token, "unknown module `" + std::string(token.text) + "`");
+
+	assignment.identifier.assign(identifier.text);
+	assignment.module.assign(token.text);
+	assignment.kind = kind;
+	assignment.arguments.clear();
+
+	if (!this->Expect(TokenType::LeftParen, "`(` after the module name", token))
+		return false;
+
+	if (this->lexer.Peek().type == TokenType::RightParen){
+		this->lexer.Next();
+		return this->ExpectEnd();
+	}
+
+	while (true){
+		if (!this->Expect(TokenType::Identifier, "a module identifier", token))
+			return false;
+		assignment.arguments.emplace_back(token.text);
+
+		token = this->lexer.Next();
+		if (token.type == TokenType::RightParen)
+			return this->ExpectEnd();
+		if (token.type != TokenType::Comma)
+			return this->Fail(token, "expected `,` or `)` in the argument list");
+	}
+}
+
+auto NoiseLang::Parser::ParseMethod(const NoiseLang::Token& identifier, NoiseLang::Method& method) -> bool {
+	// <method> = <identifier> -> <method_identifier> ( (<argument> | <number_argument>)* (<identifier> | <number>) )
+	NoiseLang::Token token;
+	this->lexer.Next();
+
+	if (!this->Expect(TokenType::Identifier, "a method name", token))
+		return false;
+	if (token.text[0] < 'A' || token.text[0] > 'Z')
+		return this->Fail(token, "method names start with a capital letter");
+
+	// Whether the module has this method can only be checked once we know what the identifier is
+	int methodId = NoiseLang::Registry::Get().FindMethod(token.text);
+	if (methodId < 0)
+		return this->Fail(token, "unknown method `" + std::string(token.text) + "`");
+
+	method.identifier.assign(identifier.text);
+	method.method.assign(token.text);
+	method.methodId = methodId;
+	method.arguments.clear();
+
+	if (!this->Expect(TokenType::LeftParen, "`(` after the method name", token))
+		return false;
+
+	if (this->lexer.Peek().type == TokenType::RightParen){
+		this->lexer.Next();
+		return this->ExpectEnd();
+	}
+
+	while (true){
+		token = this->lexer.Next();
+
+		if (method.arguments.size() == NoiseLang::MethodArguments::Max)
+			return this->Fail(token, "methods take at most " + std::to_string(NoiseLang::MethodArguments::Max) + " arguments");
+
+		auto argument = NoiseLang::Argument();
+		if (token.type == TokenType::Number){
+			argument.number = token.number;
+		} else if (token.type == TokenType::Identifier){
+			argument.type = NoiseLang::ArgumentType::Identifier;
+			argument.identifier.assign(token.text);
+		} else {
+			return this->Fail(token, "expected a number or an identifier, found `" + std::string(token.text) + "`");
+		}
+		method.arguments.push_back(std::move(argument));
+
+		token = this->lexer.Next();
+		if (token.type == TokenType::RightParen)
+			return this->ExpectEnd();
+		if (token.type != TokenType::Comma)
+			return this->Fail(token, "expected `,` or `)` in the argument list");
+	}
+}
+
+auto NoiseLang::Parser::ParseInteger(std::string_view digits, size_t maxDigits, int& value) -> bool {
+	if (digits.empty() || digits.size() > maxDigits)
+		return false;
+	auto result = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+	return result.ec == std::errc() && result.ptr == digits.data() + digits.size();
+}
+
+auto NoiseLang::Parser::ParseSize(const NoiseLang::Token& size, size_t maxDigits, int& width, int& height) -> bool {
+	// <digit>+x<digit>+, neither side zero
+	size_t x = size.text.find('x');
+	return x != std::string_view::npos && this->ParseInteger(size.text.substr(0, x), maxDigits, width) && this->ParseInteger(size.text.substr(x + 1), maxDigits, height) && width > 0 && height > 0;
+}
+
+auto NoiseLang::Parser::ParseKeyword(const NoiseLang::Token& keyword, NoiseLang::Statement& statement) -> bool {
+	auto& name = keyword.text;
+
+	if (name == "out"){
+		// <out> = out <identifier>
+		NoiseLang::Token token;
+		if (!this->Expect(TokenType::Identifier, "a module identifier after `out`", token))
+			return false;
+		statement.type = Statement::Type::Out;
+		statement.out.identifier.assign(token.text);
+		return this->ExpectEnd();
+	}
+
+	if (name == "save" || name == "load" || name == "compile"){
+		// <save> = save <filename>, and the same for load and compile
+		auto token = this->lexer.Word();
+		if (token.type == TokenType::End)
+			return this->Fail(token, "expected a file name after `" + std::string(name) + "`");
+
+		if (name == "save"){
+			statement.type = Statement::Type::Save;
+			statement.save.filename.assign(token.text);
+		} else if (name == "load"){
+			statement.type = Statement::Type::Load;
+			statement.load.filename.assign(token.text);
+		} else {
+			statement.type = Statement::Type::Compile;
+			statement.compile.filename.assign(token.text);
+		}
+		return this->ExpectEnd();
+	}
+
+	if (name == "show"){
+		// <show> = show <digit>{1,4}x<digit>{1,4}
+		auto token = this->lexer.Word();
+		if (!this->ParseSize(token, 4, statement.show.width, statement.show.height))
+			return this->Fail(token, "expected a size like 500x500 after `show`");
+		statement.type = Statement::Type::Show;
+		return this->ExpectEnd();
+	}
+
+	if (name == "render" || name == "stream" || name == "tiles" || name == "profile"){
+		// <render> = render <identifier> <digit>{1,5}x<digit>{1,5} <filename> (<number> <number> <number> <number>)?
+		// <stream> = stream <identifier> <digit>{1,6}x<digit>{1,6} <filename> (<number> <number> <number> <number>)?
+		// <tiles> = tiles <identifier> <digit>{1,6}x<digit>{1,6} <filename> (float | u16)? (<number> <number> <number> <number>)?
+		// <profile> = profile <identifier> <digit>{1,5}x<digit>{1,5} <filename>?
+		// Only render and profile hold the whole image, the other two can go bigger
+		bool render = name == "render" || name == "profile";
+		auto& r = statement.render;
+		NoiseLang::Token token;
+		if (!this->Expect(TokenType::Identifier, "a module identifier after the command", token))
+			return false;
+		r.identifier.assign(token.text);
+
+		token = this->lexer.Word();
+		if (!this->ParseSize(token, render ? 5 : 6, r.width, r.height))
+			return this->Fail(token, render ? "expected a size like 4096x4096 after the module" : "expected a size like 200000x200000 after the module");
+
+		// Where profile writes its folded stacks, if anywhere
+		if (name == "profile"){
+			r.filename.clear();
+			if (this->lexer.Peek().type != TokenType::End)
+				r.filename.assign(this->lexer.Word().text);
+			r.hasBounds = false;
+			statement.type = Statement::Type::Profile;
+			return this->ExpectEnd();
+		}
+
+		token = this->lexer.Word();
+		if (token.type == TokenType::End)
+			return this->Fail(token, "expected a file name after the size");
+		r.filename.assign(token.text);
+
+		r.quantized = false;
+		if (name == "tiles" && this->lexer.Peek().type == TokenType::Identifier){
+			token = this->lexer.Next();
+			if (token.text != "float" && token.text != "u16")
+				return this->Fail(token, "expected `float` or `u16` for the sample format");
+			r.quantized = token.text == "u16";
+		}
+
+		r.hasBounds = this->lexer.Peek().type != TokenType::End;
+		if (r.hasBounds){
+			for (auto& bound : r.bounds){
+				if (!this->Expect(TokenType::Number, "four bounds, x0 x1 y0 y1", token))
+					return false;
+				bound = token.number;
+			}
+		}
+
+		statement.type = render ? Statement::Type::Render : name == "stream" ? Statement::Type::Stream : Statement::Type::Tiles;
+		return this->ExpectEnd();
+	}
+
+	if (name == "budget"){
+		// <budget> = budget <digit>{1,7}
+		auto token = this->lexer.Word();
+		if (!this->ParseInteger(token.text, 7, statement.budget.megabytes) || statement.budget.megabytes == 0)
+			return this->Fail(token, "expected a memory budget in MiB after `budget`");
+		statement.type = Statement::Type::Budget;
+		return this->ExpectEnd();
+	}
+
+	if (name == "threads"){
+		// <threads> = threads <digit>{1,3}
+		auto token = this->lexer.Word();
+		if (!this->ParseInteger(token.text, 3, statement.threads.count))
+			return this->Fail(token, "expected a thread count after `threads`");
+		statement.type = Statement::Type::Threads;
+		return this->ExpectEnd();
+	}
+
+	if (name == "tilecache" || name == "nodecache"){
+		// <tilecache> = tilecache <digit>{1,5}?
+		// <nodecache> = nodecache <digit>{1,5}?
+		auto& c = statement.cacheSize;
+		c.hasSize = this->lexer.Peek().type != TokenType::End;
+		if (c.hasSize){
+			auto token = this->lexer.Word();
+			if (!this->ParseInteger(token.text, 5, c.megabytes))
+				return this->Fail(token, "expected a cache size in MiB after `" + std::string(name) + "`");
+		}
+		statement.type = name == "tilecache" ? Statement::Type::TileCache : Statement::Type::NodeCache;
+		return this->ExpectEnd();
+	}
+
+	if (name == "fps"){
+		// <fps> = fps <digit>{1,3}
+		auto token = this->lexer.Word();
+		if (!this->ParseInteger(token.text, 3, statement.frameRate.fps))
+			return this->Fail(token, "expected a frame rate after `fps`, 0 for as fast as it renders");
+		statement.type = Statement::Type::FrameRate;
+		return this->ExpectEnd();
+	}
+
+	if (name == "stats"){
+		// <stats> = stats (title | off)?
+		auto& s = statement.stats;
+		s.mode = NoiseLang::Stats::Mode::Print;
+		if (this->lexer.Peek().type != TokenType::End){
+			NoiseLang::Token token;
+			if (!this->Expect(TokenType::Identifier, "`title` or `off` after `stats`", token))
+				return false;
+			if (token.text != "title" && token.text != "off")
+				return this->Fail(token, "expected `title` or `off` after `stats`");
+			s.mode = token.text == "title" ? NoiseLang::Stats::Mode::Title : NoiseLang::Stats::Mode::Off;
+		}
+		statement.type = Statement::Type::Stats;
+		return this->ExpectEnd();
+	}
+
+	if (name == "precision"){
+		// <precision> = precision (float | double)?
+		auto& p = statement.precision;
+		p.mode = NoiseLang::PrecisionMode::Mode::Print;
+		if (this->lexer.Peek().type != TokenType::End){
+			NoiseLang::Token token;
+			if (!this->Expect(TokenType::Identifier, "`float` or `double` after `precision`", token))
+				return false;
+			if (token.text != "float" && token.text != "double")
+				return this->Fail(token, "expected `float` or `double` after `precision`");
+			p.mode = token.text == "float" ? NoiseLang::PrecisionMode::Mode::Float : NoiseLang::PrecisionMode::Mode::Double;
+		}
+		statement.type = Statement::Type::Precision;
+		return this->ExpectEnd();
+	}
+
+	if (name == "lut"){
+		// <lut> = lut (<number> | off)?
+		auto& t = statement.table;
+		t.mode = NoiseLang::TableMode::Mode::Print;
+		auto next = this->lexer.Peek();
+		if (next.type == TokenType::Identifier && next.text == "off"){
+			this->lexer.Next();
+			t.mode = NoiseLang::TableMode::Mode::Off;
+		} else if (next.type != TokenType::End){
+			NoiseLang::Token token;
+			if (!this->Expect(TokenType::Number, "the error tables may have after `lut`, or `off`", token))
+				return false;
+			if (!(token.number > 0.0))
+				return this->Fail(token, "expected an error above 0 after `lut`, `lut off` keeps curves and terraces exact");
+			t.mode = NoiseLang::TableMode::Mode::Bound;
+			t.error = token.number;
+		}
+		statement.type = Statement::Type::Table;
+		return this->ExpectEnd();
+	}
+
+	if (name == "lod"){
+		// <lod> = lod (on | off)?
+		auto& l = statement.lod;
+		l.mode = NoiseLang::LodMode::Mode::Print;
+		if (this->lexer.Peek().type != TokenType::End){
+			NoiseLang::Token token;
+			if (!this->Expect(TokenType::Identifier, "`on` or `off` after `lod`", token))
+				return false;
+			if (token.text != "on" && token.text != "off")
+				return this->Fail(token, "expected `on` or `off` after `lod`");
+			l.mode = token.text == "on" ? NoiseLang::LodMode::Mode::On : NoiseLang::LodMode::Mode::Off;
+		}
+		statement.type = Statement::Type::Lod;
+		return this->ExpectEnd();
+	}
+
+	if (name == "palette"){
+		// <palette> = palette (<identifier> | stop <number> <digit>{1,3} <digit>{1,3} <digit>{1,3} <digit>{1,3}? | clear | shade (<number> | off))?
+		auto& p = statement.palette;
+		p.mode = NoiseLang::PaletteCommand::Mode::Print;
+		statement.type = Statement::Type::Palette;
+		if (this->lexer.Peek().type == TokenType::End)
+			return true;
+
+		NoiseLang::Token token;
+		if (!this->Expect(TokenType::Identifier, "`stop`, `clear`, `shade` or a palette name after `palette`", token))
+			return false;
+
+		if (token.text == "clear"){
+			p.mode = NoiseLang::PaletteCommand::Mode::Clear;
+		} else if (token.text == "shade"){
+			p.mode = NoiseLang::PaletteCommand::Mode::Shade;
+			p.shade = 0.0;
+			auto next = this->lexer.Peek();
+			if (next.type == TokenType::Identifier && next.text == "off"){
+				this->lexer.Next();
+			} else {
+				if (!this->Expect(TokenType::Number, "how strongly to shade slopes after `shade`, or `off`", token))
+					return false;
+				if (token.number < 0.0)
+					return this->Fail(token, "expected a shade of 0 or more, `palette shade off` turns it off");
+				p.shade = token.number;
+			}
+		} else if (token.text == "stop"){
+			p.mode = NoiseLang::PaletteCommand::Mode::Stop;
+			if (!this->Expect(TokenType::Number, "the stop's position after `stop`", token))
+				return false;
+			p.position = token.number;
+
+			// Alpha is optional and opaque by default
+			p.color[3] = 255;
+			for (int c = 0; c < 4; c++){
+				if (c == 3 && this->lexer.Peek().type == TokenType::End)
+					break;
+				token = this->lexer.Word();
+				if (!this->ParseInteger(token.text, 3, p.color[c]) || p.color[c] < 0 || p.color[c] > 255)
+					return this->Fail(token, c < 3 ? "expected red, green and blue from 0 to 255 after the position" : "expected an alpha from 0 to 255 after the color");
+			}
+		} else {
+			p.mode = NoiseLang::PaletteCommand::Mode::Preset;
+			p.preset.assign(token.text);
+		}
+		return this->ExpectEnd();
+	}
+
+	if (name == "view"){
+		// <view> = view (<number> <number> <number>? | reset)?
+		auto& v = statement.view;
+		v.mode = NoiseLang::ViewCommand::Mode::Print;
+		statement.type = Statement::Type::View;
+
+		auto next = this->lexer.Peek();
+		if (next.type == TokenType::Identifier && next.text == "reset"){
+			this->lexer.Next();
+			v.mode = NoiseLang::ViewCommand::Mode::Reset;
+		} else if (next.type != TokenType::End){
+			NoiseLang::Token token;
+			if (!this->Expect(TokenType::Number, "the x and y of the top left pixel after `view`, or `reset`", token))
+				return false;
+			v.x = token.number;
+			if (!this->Expect(TokenType::Number, "the y of the top left pixel after its x", token))
+				return false;
+			v.y = token.number;
+
+			v.hasScale = this->lexer.Peek().type != TokenType::End;
+			if (v.hasScale){
+				if (!this->Expect(TokenType::Number, "a scale in world units per pixel", token))
+					return false;
+				if (!(token.number > 0.0))
+					return this->Fail(token, "expected a scale above 0, the default is 0.01 units per pixel");
+				v.scale = token.number;
+			}
+			v.mode = NoiseLang::ViewCommand::Mode::Set;
+		}
+		return this->ExpectEnd();
+	}
+
+	if (name == "optimize" || name == "exit"){
+		statement.type = name == "exit" ? Statement::Type::Exit : Statement::Type::Optimize;
+		return this->ExpectEnd();
+	}
+
+	return this->Fail(keyword, "expected `=`, `->` or a command, `" + std::string(name) + "` is not a command");
+}
+// }}}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "vendor/include/noise/noise.h"
+
+#include "NoiseLangProgram.hpp"
+
+namespace NoiseLang {
+
+	// One named module's share of a profiled evaluation. Times are in seconds.
+	class ProfileEntry {
+		public:
+			std::string name;
+			// The module's kind, e.g. "perlin"
+			std::string kind;
+			// Inclusive counts everything upstream of the module once, however often it is read
+			double inclusive;
+			double exclusive;
+			std::uint64_t calls;
+			std::uint64_t samples;
+			// Consumers of the module, and how many of them read the register it already wrote
+			size_t reads;
+			size_t sharedReads;
+	};
+
+	// Turns per instruction counters back into the modules they were compiled from
+	class Profiler {
+		private:
+			// Per instruction, the instructions that wrote its inputs and coordinates, -1 for none
+			static auto GetProducers(const NoiseLang::Program& program) -> std::vector<std::int64_t>;
+
+		public:
+			// One entry per named module the program reads, most inclusive time first
+			static auto Summarize(const NoiseLang::Program& program, const NoiseLang::ProgramProfile& profile, const NoiseLang::OptimizerReport& report, const std::map<const noise::module::Module*, std::string>& names) -> std::vector<NoiseLang::ProfileEntry>;
+
+			// Folded stacks ("out;terrain;mountains 1234", microseconds) of `out`, the module the
+			// program was compiled from, for flamegraph.pl and speedscope. A module read by several
+			// consumers is charged to the first path reaching it.
+			static auto WriteFolded(const noise::module::Module& out, const NoiseLang::Program& program, const NoiseLang::ProgramProfile& profile, const std::map<const noise::module::Module*, std::string>& names, std::ostream& stream) -> void;
+	};
+
+}
+
+auto NoiseLang::Profiler::GetProducers(const NoiseLang::Program& program) -> std::vector<std::int64_t> {
+	auto& code = program.code;
+	std::vector<std::int64_t> lastValue(program.valueRegisters, -1);
+	std::vector<std::int64_t> lastCoord(program.coordRegisters, -1);
+	std::vector<std::int64_t> producers(code.size() * 4, -1);
+
+	for (size_t i = 0; i < code.size(); i++){
+		for (int j = 0; j < NoiseLang::GetInputCount(code[i].op); j++)
+			producers[i * 4 + j] = lastValue[code[i].in[j]];
+		producers[i * 4 + 3] = lastCoord[code[i].coords];
+		(NoiseLang::IsTransform(code[i].op) ? lastCoord : lastValue)[code[i].out] = static_cast<std::int64_t>(i);
+	}
+	return producers;
+}
+
+auto NoiseLang::Profiler::Summarize(const NoiseLang::Program& program, const NoiseLang::ProgramProfile& profile, const NoiseLang::OptimizerReport& report, const std::map<const noise::module::Module*, std::string>& names) -> std::vector<NoiseLang::ProfileEntry> {
+	auto& code = program.code;
+	auto producers = GetProducers(program);
+
+	auto exclusive = [&profile](size_t i){ return i < profile.seconds.size() ? profile.seconds[i] : 0.0; };
+
+	// Instructions, outputs and shared reads per module, so each entry only looks at its own
+	std::map<const noise::module::Module*, std::vector<size_t>> lowered, outputs;
+	for (size_t i = 0; i < code.size(); i++)
+		lowered[program.origins[i]].push_back(i);
+	for (auto& [output, instruction] : program.outputs)
+		outputs[output].push_back(instruction);
+	std::map<const noise::module::Module*, size_t> shared;
+	for (auto& o : report.optimizations)
+		if (o.action == NoiseLang::Optimization::Action::Shared)
+			shared[o.module]++;
+
+	// Instructions already counted towards the entry numbered `visited[i]`, so the upstream walk
+	// counts each once without a per module set to clear
+	std::vector<size_t> visited(code.size(), 0);
+	std::vector<size_t> pending;
+
+	std::vector<NoiseLang::ProfileEntry> entries;
+	for (auto& [module, name] : names){
+		if (report.reachable.count(module) == 0)
+			continue;
+
+		auto entry = NoiseLang::ProfileEntry();
+		entry.name = name;
+		entry.kind = NoiseLang::GetModuleKindName(NoiseLang::GetModuleKind(*module));
+		entry.inclusive = entry.exclusive = 0.0;
+		entry.calls = entry.samples = 0;
+
+		for (size_t i : lowered[module]){
+			entry.exclusive += exclusive(i);
+			entry.calls += i < profile.calls.size() ? profile.calls[i] : 0;
+			entry.samples += i < profile.samples.size() ? profile.samples[i] : 0;
+		}
+
+		// Everything the module's outputs read from, themselves included, walked through the
+		// producers of each instruction's inputs and coordinates
+		size_t stamp = entries.size() + 1;
+		for (size_t instruction : outputs[module]){
+			if (visited[instruction] != stamp){
+				visited[instruction] = stamp;
+				pending.push_back(instruction);
+			}
+		}
+		while (!pending.empty()){
+			size_t k = pending.back();
+			pending.pop_back();
+			entry.inclusive += exclusive(k);
+			for (int j = 0; j < 4; j++){
+				std::int64_t producer = producers[k * 4 + j];
+				if (producer >= 0 && visited[static_cast<size_t>(producer)] != stamp){
+					visited[static_cast<size_t>(producer)] = stamp;
+					pending.push_back(static_cast<size_t>(producer));
+				}
+			}
+		}
+
+		entry.sharedReads = shared[module];
+		entry.reads = entry.sharedReads + 1;
+
+		entries.push_back(std::move(entry));
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const NoiseLang::ProfileEntry& a, const NoiseLang::ProfileEntry& b){ return a.inclusive > b.inclusive; });
+	return entries;
+}
+
+auto NoiseLang::Profiler::WriteFolded(const noise::module::Module& out, const NoiseLang::Program& program, const NoiseLang::ProgramProfile& profile, const std::map<const noise::module::Module*, std::string>& names, std::ostream& stream) -> void {
+	// Each module's own time, over every frame it was lowered in
+	std::map<const noise::module::Module*, double> self;
+	for (size_t i = 0; i < program.code.size() && i < profile.seconds.size(); i++)
+		self[program.origins[i]] += profile.seconds[i];
+
+	// Depth first over the module graph, the way the script reads
+	std::set<const noise::module::Module*> visited;
+	auto walk = [&](auto& walk, const noise::module::Module& module, const std::string& path) -> void {
+		if (!visited.insert(&module).second)
+			return;
+
+		auto it = names.find(&module);
+		std::string name = it != names.end() ? it->second : "(" + NoiseLang::GetModuleKindName(NoiseLang::GetModuleKind(module)) + ")";
+		std::string stack = path == "" ? name : path + ";" + name;
+
+		auto microseconds = static_cast<long long>(std::llround(self[&module] * 1e6));
+		if (microseconds > 0)
+			stream << stack << " " << microseconds << std::endl;
+
+		for (int source = 0; source < module.GetSourceModuleCount(); source++)
+			walk(walk, module.GetSourceModule(source), stack);
+	};
+	walk(walk, out, "");
+}
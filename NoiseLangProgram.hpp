@@ -0,0 +1,1700 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "vendor/include/noise/noise.h"
+
+#include "NoiseLangBlock.hpp"
+#include "NoiseLangSimd.hpp"
+
+namespace NoiseLang {
+
+	enum class OpCode : std::uint8_t {
+		// Generators, write a value register from the instruction's coordinates
+		Billow, Checkerboard, Const, Cylinders, Perlin, RidgedMulti, Spheres, Voronoi,
+
+		// Modifiers and combiners, write a value register from other value registers
+		Abs, Add, Blend, Clamp, Curve, Exponent, Invert, Max, Min, Multiply, Power, ScaleBias, Select, Terrace,
+
+		// Only the compiler writes these: a curve or terrace sampled into a lookup table, and a run
+		// of unary modifiers fused into one pass over the block
+		Table, Chain,
+
+		// Point transformers, write a coordinate register
+		Displace, RotatePoint, ScalePoint, TranslatePoint, Turbulence,
+
+		// A module the compiler doesn't know, sampled through its own GetValue()
+		External
+	};
+
+	auto IsTransform(OpCode op) -> bool;
+	auto IsGenerator(OpCode op) -> bool;
+	// Unary modifiers, whose output at a point only depends on their input at that point
+	auto IsPointwise(OpCode op) -> bool;
+	auto GetInputCount(OpCode op) -> int;
+	auto GetOpCodeName(OpCode op) -> std::string;
+
+	// What perlin, billow and ridgedmulti run at. Single is the float32 SIMD kernels, within
+	// Kernels::Single::MaxError of Double; everything else is double either way.
+	enum class Precision : std::uint8_t {Double, Single};
+
+	// One step of a compiled program. `coords` names the coordinate register the
+	// instruction samples at, `in` its value register inputs, and `params` the offset of
+	// its parameter block. Transforms write the coordinate register `out`, everything
+	// else the value register `out`. Coordinate register 0 is the caller's input points.
+	class Instruction {
+		public:
+			OpCode op;
+			std::uint32_t params;
+			std::uint32_t coords;
+			std::uint32_t out;
+			std::uint32_t in[3];
+	};
+
+	// One modifier of a Chain, or a pointwise instruction on its own. `params` is its block in
+	// Program::params, laid out as the instruction's would be.
+	class ChainStep {
+		public:
+			OpCode op;
+			const double* params;
+	};
+
+	// Which precision gradient noise runs at, whether curves and terraces become tables and
+	// whether fractals drop the octaves their samples are too far apart to show
+	class CompileOptions {
+		public:
+			NoiseLang::Precision precision = NoiseLang::Precision::Double;
+			// The most a curve or terrace's table may differ from it, 0 keeps them exact. Each
+			// table is held to this on its own, modules after it may still amplify the difference.
+			double tableError = 0.0;
+			bool lod = false;
+	};
+
+	// How much of a fractal an instruction runs at some sample spacing: its first `octaves`
+	// octaves, the last of them weighted by `fade`, plus `bias` for what the rest add on average
+	class OctaveDetail {
+		public:
+			int octaves;
+			double fade;
+			double bias;
+	};
+
+	// A module graph lowered to a topologically ordered instruction stream. Parameters
+	// are copied out of the modules, so a Program is an immutable snapshot that any
+	// number of threads can run while the interpreter keeps editing the graph.
+	class Program {
+		public:
+			std::vector<NoiseLang::Instruction> code;
+			std::vector<double> params;
+			std::vector<noise::module::ControlPoint> controlPoints;
+			std::vector<const noise::module::Module*> externals;
+
+			// The module each instruction was lowered from, for diagnostics
+			std::vector<const noise::module::Module*> origins;
+
+			// The instruction each module evaluates to, once per coordinate frame it was lowered in.
+			// Transforms and caches evaluate to an instruction lowered from their source.
+			std::vector<std::pair<const noise::module::Module*, std::uint32_t>> outputs;
+
+			// Per instruction, a hash of its own parameters and those of everything upstream of it,
+			// so an instruction keeps its hash across recompiles until something it reads changes.
+			// 0 for instructions that depend on an external, whose parameters live in the graph.
+			std::vector<std::uint64_t> nodeHashes;
+
+			std::uint32_t valueRegisters = 0;
+			std::uint32_t coordRegisters = 1;
+			std::uint32_t result = 0;
+			NoiseLang::Precision precision = NoiseLang::Precision::Double;
+			bool lod = false;
+
+			auto Print(std::ostream& stream) const -> void;
+
+			// A chain holds at most this many modifiers
+			static const size_t MaxChainSteps = 16;
+
+			// Length of the instruction's block in `params`
+			static auto GetParamCount(NoiseLang::OpCode op, const double* p) -> size_t;
+			auto GetParamCount(const NoiseLang::Instruction& instruction) const -> size_t;
+
+			// Rough per sample cost of the instruction, one octave of gradient noise is 1.0
+			static auto GetCost(NoiseLang::OpCode op, const double* p) -> double;
+			auto GetCost(const NoiseLang::Instruction& instruction) const -> double;
+			auto GetCost() const -> double;
+
+			// The modifiers a pointwise instruction runs into `steps`, a chain's in order and any
+			// other one itself, returning how many
+			auto GetSteps(const NoiseLang::Instruction& instruction, NoiseLang::ChainStep* steps) const -> size_t;
+
+			// The octaves each instruction runs when neighbouring input points are `spacing` apart,
+			// for perlin, billow, ridgedmulti and turbulence. Without `lod`, or at a spacing of 0,
+			// every octave; with it an octave fades out as its lattice cells shrink from 2 samples
+			// across to 1 (at the default lacunarity) and is dropped below that, where it would only
+			// alias, leaving what it adds on average. Transforms change the spacing below them,
+			// displacements by roughly how steep their sources are.
+			auto GetDetail(double spacing, std::vector<NoiseLang::OctaveDetail>& detail) const -> void;
+
+			// Octaves a perlin, billow, ridgedmulti or turbulence instruction is set to run before
+			// `lod` drops any, 0 for every other instruction
+			static auto GetOctaveCount(NoiseLang::OpCode op, const double* p) -> int;
+			auto GetOctaveCount(const NoiseLang::Instruction& instruction) const -> int;
+
+			// FNV-1a over everything that decides the output, equal programs hash equally across runs.
+			// Externals only contribute their position, their parameters live in the module.
+			auto GetHash() const -> std::uint64_t;
+	};
+
+	// One instruction the optimizer removed, and what evaluating it used to cost per sample
+	class Optimization {
+		public:
+			// Shared: a module reached again at the same points, read from the register it already
+			// wrote rather than evaluated again. Fused: run as a step of the chain `into` ends with.
+			// Tabulated: a curve or terrace read from a table of `entries` values, `error` at most
+			// off, or kept exact when `entries` is 0 because no table was close enough.
+			enum class Action {Folded, Merged, Pruned, Shared, Fused, Tabulated};
+
+			Action action;
+			NoiseLang::OpCode op;
+			const noise::module::Module* module;
+			// For merges, the module whose identical instruction is kept
+			const noise::module::Module* into;
+			double saved;
+			double error = 0.0;
+			size_t entries = 0;
+	};
+
+	class OptimizerReport {
+		public:
+			std::vector<NoiseLang::Optimization> optimizations;
+			// Every module reachable from `out`, the rest are never compiled at all
+			std::set<const noise::module::Module*> reachable;
+			double costBefore = 0.0;
+			double costAfter = 0.0;
+			// Instructions per sample that evaluating the graph node by node would run, and how
+			// many of those sharing avoids
+			size_t treeEvaluations = 0;
+			size_t sharedEvaluations = 0;
+	};
+
+	class Compiler {
+		private:
+			NoiseLang::Program program;
+			std::map<std::pair<const noise::module::Module*, std::uint32_t>, std::uint32_t> lowered;
+			std::uint32_t values;
+			std::uint32_t coords;
+
+			// What a node by node walk would run below each lowered module, to count what sharing saves
+			class Subtree {
+				public:
+					size_t evaluations;
+					double cost;
+			};
+			std::map<std::pair<const noise::module::Module*, std::uint32_t>, Subtree> subtrees;
+			size_t walked;
+			double walkedCost;
+			std::vector<NoiseLang::Optimization> shared;
+
+			// The value register each Emit() returned, turned into Program::outputs once registers settle
+			std::vector<std::pair<const noise::module::Module*, std::uint32_t>> moduleValues;
+
+			auto Emit(const noise::module::Module& module, std::uint32_t coords) -> std::uint32_t;
+			auto Push(OpCode op, const noise::module::Module& origin, std::uint32_t coords, std::uint32_t params, std::uint32_t in0 = 0, std::uint32_t in1 = 0, std::uint32_t in2 = 0) -> std::uint32_t;
+			auto Param(double value) -> void;
+			auto EmitPerlinParams(const noise::module::Perlin& perlin) -> void;
+			auto Optimize(NoiseLang::OptimizerReport& report) -> void;
+			auto Prune(NoiseLang::OptimizerReport& report) -> void;
+			auto Fold(const NoiseLang::Instruction& instruction, const double* inputs) -> double;
+			auto Tabulate(NoiseLang::OptimizerReport& report, double maxError) -> void;
+			auto Fuse(NoiseLang::OptimizerReport& report) -> void;
+			auto Remove(const std::vector<bool>& removed) -> void;
+			auto HashNodes() -> void;
+			auto FindOutputs() -> void;
+			auto Allocate() -> void;
+
+			Compiler();
+
+		public:
+			// Tables tried for a curve or terrace, doubling from the smallest until one is close enough
+			static const size_t MinTableEntries = 256;
+			static const size_t MaxTableEntries = 65536;
+
+			// Lowers and optimizes the graph rooted at `out`; throws noise::ExceptionInvalidParam if a
+			// module can't be evaluated (e.g. a curve with fewer than four control points)
+			static auto Compile(const noise::module::Module& out, NoiseLang::OptimizerReport* report = nullptr, const NoiseLang::CompileOptions& options = NoiseLang::CompileOptions()) -> std::shared_ptr<const NoiseLang::Program>;
+	};
+
+	// Per instruction counters filled in by a ProgramEvaluator built with NOISELANG_PROFILE.
+	// Without it the evaluator has no timing code at all and never touches these.
+	class ProgramProfile {
+		public:
+			std::vector<double> seconds;
+			std::vector<std::uint64_t> calls;
+			std::vector<std::uint64_t> samples;
+	};
+
+	// Buffers holding one instruction's output for every point of an Evaluate() call, indexed by
+	// instruction. A value takes `count` doubles, a transform 3 * `count`, x then y then z.
+	class NodeBuffers {
+		public:
+			// Instructions with a buffer here are read back rather than run, and anything only
+			// they read is skipped
+			std::vector<const double*> reuse;
+			// Instructions that run copy their output here; Evaluate() clears the entries of
+			// instructions it didn't need to run
+			std::vector<double*> record;
+	};
+
+	// Runs compiled programs over blocks of points. Holds the register file, so each
+	// thread needs its own ProgramEvaluator; the Program itself is only read.
+	class ProgramEvaluator {
+		public:
+			static const size_t DefaultBlockSize = 1024;
+
+		private:
+			// Values a chain runs through all its steps at a time
+			static const size_t ChainSlice = 64;
+
+			size_t blockSize;
+			std::vector<std::vector<double>> values;
+			std::vector<std::vector<double>> coords;
+			std::vector<double> temp;
+			std::vector<double> gx, gy, gz;
+			std::vector<const double*> cx, cy, cz;
+			std::vector<bool> needed;
+			std::vector<std::int64_t> lastValue, lastCoord;
+			std::vector<NoiseLang::OctaveDetail> detail;
+#ifdef NOISELANG_PROFILE
+			NoiseLang::ProgramProfile* profile = nullptr;
+#endif
+
+			auto Prepare(const NoiseLang::Program& program, double spacing = 0.0) -> void;
+			auto Plan(const NoiseLang::Program& program, NoiseLang::NodeBuffers& nodes) -> void;
+			auto EvaluateBlock(const NoiseLang::Program& program, const double* x, const double* y, const double* z, double* out, size_t count, const NoiseLang::NodeBuffers* nodes = nullptr, size_t offset = 0, size_t total = 0) -> void;
+
+		public:
+			ProgramEvaluator(size_t blockSize = DefaultBlockSize);
+
+			// `spacing` is how far apart neighbouring points are, which programs compiled with `lod`
+			// drop the octaves finer than. 0 runs every octave.
+			auto Evaluate(const NoiseLang::Program& program, const double* x, const double* y, const double* z, double* out, size_t count, double spacing = 0.0) -> void;
+			// As above, reusing and recording per instruction outputs for incremental re-evaluation
+			auto Evaluate(const NoiseLang::Program& program, const double* x, const double* y, const double* z, double* out, size_t count, NoiseLang::NodeBuffers& nodes, double spacing = 0.0) -> void;
+			// Spaced by the grid's larger step
+			auto EvaluateGrid(const NoiseLang::Program& program, const NoiseLang::PointGrid& grid, double* out) -> void;
+			auto GetValue(const NoiseLang::Program& program, double x, double y, double z) -> double;
+
+			// One pointwise modifier over `count` values, `a` and `out` may be the same
+			static auto RunStep(const NoiseLang::Program& program, const NoiseLang::ChainStep& step, const double* a, double* out, size_t count) -> void;
+
+#ifdef NOISELANG_PROFILE
+			// Every instruction run from now on is timed into `profile`, nullptr stops it
+			auto SetProfile(NoiseLang::ProgramProfile* profile) -> void;
+#endif
+	};
+
+}
+
+auto NoiseLang::IsTransform(NoiseLang::OpCode op) -> bool {
+	return op == OpCode::Displace || op == OpCode::RotatePoint || op == OpCode::ScalePoint || op == OpCode::TranslatePoint || op == OpCode::Turbulence;
+}
+
+auto NoiseLang::IsGenerator(NoiseLang::OpCode op) -> bool {
+	return op < OpCode::Abs || op == OpCode::External;
+}
+
+auto NoiseLang::IsPointwise(NoiseLang::OpCode op) -> bool {
+	switch (op){
+		case OpCode::Abs: case OpCode::Clamp: case OpCode::Curve: case OpCode::Exponent: case OpCode::Invert: case OpCode::ScaleBias: case OpCode::Terrace:
+		case OpCode::Table: case OpCode::Chain:
+			return true;
+		default:
+			return false;
+	}
+}
+
+auto NoiseLang::GetInputCount(NoiseLang::OpCode op) -> int {
+	switch (op){
+		case OpCode::Abs: case OpCode::Clamp: case OpCode::Curve: case OpCode::Exponent: case OpCode::Invert: case OpCode::ScaleBias: case OpCode::Terrace:
+		case OpCode::Table: case OpCode::Chain:
+			return 1;
+		case OpCode::Add: case OpCode::Max: case OpCode::Min: case OpCode::Multiply: case OpCode::Power:
+			return 2;
+		case OpCode::Blend: case OpCode::Select: case OpCode::Displace:
+			return 3;
+		default:
+			return 0;
+	}
+}
+
+auto NoiseLang::GetOpCodeName(NoiseLang::OpCode op) -> std::string {
+	static const char* names[] = {
+		"billow", "checkerboard", "const", "cylinders", "perlin", "ridgedmulti", "spheres", "voronoi",
+		"abs", "add", "blend", "clamp", "curve", "exponent", "invert", "max", "min", "multiply", "power", "scalebias", "select", "terrace",
+		"table", "chain",
+		"displace", "rotatepoint", "scalepoint", "translatepoint", "turbulence",
+		"external"
+	};
+	return names[static_cast<int>(op)];
+}
+
+auto NoiseLang::Program::Print(std::ostream& stream) const -> void {
+	for (auto& i : this->code){
+		stream << (NoiseLang::IsTransform(i.op) ? "c" : "v") << i.out << " = " << NoiseLang::GetOpCodeName(i.op) << " @c" << i.coords;
+		for (int j = 0; j < NoiseLang::GetInputCount(i.op); j++)
+			stream << " v" << i.in[j];
+		stream << std::endl;
+	}
+	stream << "result v" << this->result << " (" << this->valueRegisters << " value, " << this->coordRegisters << " coordinate registers)" << std::endl;
+}
+
+auto NoiseLang::Program::GetParamCount(NoiseLang::OpCode op, const double* p) -> size_t {
+	switch (op){
+		case OpCode::Billow: case OpCode::Perlin: return 6;
+		case OpCode::RidgedMulti: return 5 + static_cast<size_t>(p[2]);
+		case OpCode::Voronoi: return 4;
+		case OpCode::Const: case OpCode::Cylinders: case OpCode::Spheres: case OpCode::Exponent: case OpCode::External: return 1;
+		case OpCode::Clamp: case OpCode::Curve: case OpCode::ScaleBias: return 2;
+		case OpCode::Terrace: return 2 + static_cast<size_t>(p[0]);
+		case OpCode::Table: return 3 + static_cast<size_t>(p[0]);
+		case OpCode::Chain: return static_cast<size_t>(p[0]);
+		case OpCode::Select: case OpCode::ScalePoint: case OpCode::TranslatePoint: return 3;
+		case OpCode::RotatePoint: return 9;
+		case OpCode::Turbulence: return 19;
+		default: return 0;
+	}
+}
+
+auto NoiseLang::Program::GetParamCount(const NoiseLang::Instruction& instruction) const -> size_t {
+	return GetParamCount(instruction.op, this->params.data() + instruction.params);
+}
+
+auto NoiseLang::Program::GetCost(NoiseLang::OpCode op, const double* p) -> double {
+	switch (op){
+		case OpCode::Billow: case OpCode::Perlin: return p[3];
+		case OpCode::RidgedMulti: return p[2] * 1.1;
+		case OpCode::Voronoi: return 4.0;
+		case OpCode::Turbulence: return p[4] + p[10] + p[16];
+		case OpCode::External: return 1.0;
+		case OpCode::Checkerboard: case OpCode::Cylinders: case OpCode::Spheres: return 0.1;
+		case OpCode::Curve: case OpCode::Terrace: case OpCode::Exponent: case OpCode::Power: return 0.1;
+		case OpCode::Blend: case OpCode::Select: case OpCode::RotatePoint: return 0.05;
+		case OpCode::Const: return 0.01;
+		case OpCode::Table: return 0.03;
+		case OpCode::Chain: {
+			// Every step after the first saves its own pass over the block
+			double cost = -0.01 * (p[1] - 1.0);
+			const double* step = p + 2;
+			for (int i = 0; i < static_cast<int>(p[1]); i++){
+				auto op = static_cast<OpCode>(static_cast<int>(step[0]));
+				cost += GetCost(op, step + 1);
+				step += 1 + GetParamCount(op, step + 1);
+			}
+			return cost;
+		}
+		default: return 0.02;
+	}
+}
+
+auto NoiseLang::Program::GetCost(const NoiseLang::Instruction& instruction) const -> double {
+	return GetCost(instruction.op, this->params.data() + instruction.params);
+}
+
+auto NoiseLang::Program::GetCost() const -> double {
+	double cost = 0.0;
+	for (auto& i : this->code)
+		cost += this->GetCost(i);
+	return cost;
+}
+
+auto NoiseLang::Program::GetSteps(const NoiseLang::Instruction& instruction, NoiseLang::ChainStep* steps) const -> size_t {
+	// A chain's block is its length, its step count, then each step's op and block
+	const double* p = this->params.data() + instruction.params;
+	if (instruction.op != OpCode::Chain){
+		steps[0] = NoiseLang::ChainStep{instruction.op, p};
+		return 1;
+	}
+
+	size_t count = static_cast<size_t>(p[1]);
+	const double* step = p + 2;
+	for (size_t i = 0; i < count; i++){
+		auto op = static_cast<OpCode>(static_cast<int>(step[0]));
+		steps[i] = NoiseLang::ChainStep{op, step + 1};
+		step += 1 + GetParamCount(op, step + 1);
+	}
+	return count;
+}
+
+auto NoiseLang::Program::GetOctaveCount(NoiseLang::OpCode op, const double* p) -> int {
+	switch (op){
+		case OpCode::Billow: case OpCode::Perlin: return static_cast<int>(p[3]);
+		case OpCode::RidgedMulti: return static_cast<int>(p[2]);
+		// The three distortions share their octave count
+		case OpCode::Turbulence: return static_cast<int>(p[4]);
+		default: return 0;
+	}
+}
+
+auto NoiseLang::Program::GetOctaveCount(const NoiseLang::Instruction& instruction) const -> int {
+	return GetOctaveCount(instruction.op, this->params.data() + instruction.params);
+}
+
+auto NoiseLang::Program::GetDetail(double spacing, std::vector<NoiseLang::OctaveDetail>& detail) const -> void {
+	// Per register, how far apart points that are 1 apart at the input end up (`stretch`) and
+	// about how steep a value is across the input (`slope`, the RMS of its gradient). Registers
+	// are reused once allocated, but in program order each holds what the next reader sees.
+	std::vector<double> stretch(this->coordRegisters, 1.0);
+	std::vector<double> slope(this->valueRegisters, 0.0);
+	detail.resize(this->code.size());
+
+	// The RMS gradient of one octave of gradient noise at frequency 1
+	const double noiseSlope = 1.6;
+
+	auto cull = [this, spacing](double frequency, double lacunarity, int octaves, double stretch){
+		auto d = NoiseLang::OctaveDetail{octaves, 1.0, 0.0};
+		double h = spacing * stretch;
+		if (!this->lod || !(h > 0.0) || !(std::fabs(lacunarity) > 1.0) || frequency == 0.0)
+			return d;
+
+		// Octave i's cells are lacunarity^(t - i) samples across, and it's weighted by t - i
+		// clamped to [0, 1]. The first octave always runs.
+		double t = std::log(1.0 / (std::fabs(frequency) * h)) / std::log(std::fabs(lacunarity));
+		if (octaves > 1 && t < octaves){
+			d.octaves = static_cast<int>(std::max(1.0, std::ceil(t)));
+			d.fade = d.octaves > 1 ? t - (d.octaves - 1) : 1.0;
+		}
+		return d;
+	};
+	// What the octaves from `d.octaves - 1` on would have added on average, less what runs of them.
+	// Means are only looked up, and measured the first time, once something is dropped.
+	auto dropped = [](const NoiseLang::OctaveDetail& d, int octaves, auto mean){
+		double sum = d.fade < 1.0 ? (1.0 - d.fade) * mean(d.octaves - 1) : 0.0;
+		for (int octave = d.octaves; octave < octaves; octave++)
+			sum += mean(octave);
+		return sum;
+	};
+	// Octaves add up like independent noise, each as steep as its frequency times its amplitude
+	auto fractalSlope = [noiseSlope](double frequency, double lacunarity, const NoiseLang::OctaveDetail& d, auto amplitude){
+		double sum = 0.0;
+		for (int octave = 0; octave < d.octaves; octave++){
+			double octaveSlope = frequency * amplitude(octave) * (octave == d.octaves - 1 ? d.fade : 1.0);
+			sum += octaveSlope * octaveSlope;
+			frequency *= lacunarity;
+		}
+		return noiseSlope * std::sqrt(sum);
+	};
+
+	for (size_t n = 0; n < this->code.size(); n++){
+		auto& i = this->code[n];
+		const double* p = this->params.data() + i.params;
+		double k = stretch[i.coords];
+		double a = slope[i.in[0]], b = slope[i.in[1]], c = slope[i.in[2]];
+		detail[n] = NoiseLang::OctaveDetail{0, 1.0, 0.0};
+
+		switch (i.op){
+			// Generators are as steep as they are in their own coordinates times the stretch.
+			// Perlin octaves average 0, billow and ridgedmulti ones don't.
+			case OpCode::Billow: case OpCode::Perlin: {
+				auto persistence = [p](int octave){ return std::pow(p[2], octave); };
+				int octaves = GetOctaveCount(i.op, p);
+				detail[n] = cull(p[0], p[1], octaves, k);
+				if (i.op == OpCode::Billow){
+					auto quality = static_cast<noise::NoiseQuality>(static_cast<int>(p[5]));
+					detail[n].bias = dropped(detail[n], octaves, [&](int octave){ return NoiseLang::Kernels::GetOctaveMeans(quality).billow * persistence(octave); });
+				}
+				slope[i.out] = (i.op == OpCode::Billow ? 2.0 : 1.0) * k * fractalSlope(p[0], p[1], detail[n], persistence);
+				break;
+			}
+			case OpCode::RidgedMulti: {
+				auto weight = [p](int octave){ return p[5 + octave]; };
+				int octaves = GetOctaveCount(i.op, p);
+				detail[n] = cull(p[0], p[1], octaves, k);
+				auto quality = static_cast<noise::NoiseQuality>(static_cast<int>(p[4]));
+				detail[n].bias = 1.25 * dropped(detail[n], octaves, [&](int octave){ return NoiseLang::Kernels::GetOctaveMeans(quality).ridged[octave] * weight(octave); });
+				slope[i.out] = 1.25 * k * fractalSlope(p[0], p[1], detail[n], weight);
+				break;
+			}
+			case OpCode::Cylinders: case OpCode::Spheres:
+				slope[i.out] = 4.0 * std::fabs(p[0]) * k;
+				break;
+			case OpCode::Voronoi:
+				// Cell values are flat, the distance to the seed point isn't
+				slope[i.out] = p[2] != 0.0 ? std::sqrt(3.0) * std::fabs(p[0]) * k : 0.0;
+				break;
+			case OpCode::Checkerboard: case OpCode::Const: case OpCode::External:
+				// Flat between edges, or unknown
+				slope[i.out] = 0.0;
+				break;
+
+			case OpCode::Abs: case OpCode::Invert: case OpCode::Clamp: case OpCode::Curve: case OpCode::Exponent: case OpCode::ScaleBias: case OpCode::Terrace:
+			case OpCode::Table: case OpCode::Chain: {
+				// Only scaling and exponents change a slope much, curves and terraces keep the range
+				NoiseLang::ChainStep steps[NoiseLang::Program::MaxChainSteps];
+				size_t count = this->GetSteps(i, steps);
+				for (size_t step = 0; step < count; step++){
+					if (steps[step].op == OpCode::ScaleBias || steps[step].op == OpCode::Exponent)
+						a *= std::fabs(steps[step].params[0]);
+				}
+				slope[i.out] = a;
+				break;
+			}
+			case OpCode::Add: case OpCode::Multiply: case OpCode::Power:
+				slope[i.out] = std::sqrt(a * a + b * b);
+				break;
+			case OpCode::Max: case OpCode::Min: case OpCode::Select:
+				slope[i.out] = std::max(a, b);
+				break;
+			case OpCode::Blend:
+				slope[i.out] = std::sqrt(a * a + b * b + c * c);
+				break;
+
+			// Displacing by something with gradients g stretches distances by about sqrt(1 + |g|^2 / 3)
+			// in a random direction, the displacement's slope adding to the stretch already there
+			case OpCode::Displace:
+				stretch[i.out] = std::sqrt(k * k + (a * a + b * b + c * c) / 3.0);
+				break;
+			case OpCode::RotatePoint: case OpCode::TranslatePoint:
+				stretch[i.out] = k;
+				break;
+			case OpCode::ScalePoint:
+				stretch[i.out] = k * std::max({std::fabs(p[0]), std::fabs(p[1]), std::fabs(p[2])});
+				break;
+			case OpCode::Turbulence: {
+				// The three distortions share everything but their seeds
+				const double* q = p + 1;
+				detail[n] = cull(q[0], q[1], GetOctaveCount(i.op, p), k);
+				double distortion = p[0] * fractalSlope(q[0], q[1], detail[n], [q](int octave){ return std::pow(q[2], octave); });
+				stretch[i.out] = k * std::sqrt(1.0 + distortion * distortion);
+				break;
+			}
+		}
+	}
+}
+
+auto NoiseLang::Program::GetHash() const -> std::uint64_t {
+	std::uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size){
+		auto bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++){
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+
+	for (auto& i : this->code){
+		mix(&i.op, sizeof(i.op));
+		mix(&i.params, sizeof(i.params));
+		mix(&i.coords, sizeof(i.coords));
+		mix(&i.out, sizeof(i.out));
+		mix(i.in, sizeof(i.in));
+	}
+	mix(this->params.data(), this->params.size() * sizeof(double));
+	for (auto& point : this->controlPoints){
+		mix(&point.inputValue, sizeof(double));
+		mix(&point.outputValue, sizeof(double));
+	}
+	mix(&this->result, sizeof(this->result));
+	mix(&this->precision, sizeof(this->precision));
+	mix(&this->lod, sizeof(this->lod));
+	return hash;
+}
+
+NoiseLang::Compiler::Compiler() {
+	this->values = 0;
+	this->coords = 1;
+	this->walked = 0;
+	this->walkedCost = 0.0;
+}
+
+auto NoiseLang::Compiler::Compile(const noise::module::Module& out, NoiseLang::OptimizerReport* report, const NoiseLang::CompileOptions& options) -> std::shared_ptr<const NoiseLang::Program> {
+	auto compiler = NoiseLang::Compiler();
+	auto optimized = NoiseLang::OptimizerReport();
+	compiler.program.precision = options.precision;
+	compiler.program.lod = options.lod;
+
+	compiler.program.result = compiler.Emit(out, 0);
+	for (auto& lowered : compiler.lowered)
+		optimized.reachable.insert(lowered.first.first);
+	optimized.optimizations = std::move(compiler.shared);
+	optimized.treeEvaluations = compiler.walked;
+	optimized.sharedEvaluations = compiler.walked - compiler.program.code.size();
+
+	optimized.costBefore = compiler.walkedCost;
+	compiler.Optimize(optimized);
+	compiler.Prune(optimized);
+	if (options.tableError > 0.0)
+		compiler.Tabulate(optimized, options.tableError);
+	compiler.Fuse(optimized);
+	optimized.costAfter = compiler.program.GetCost();
+
+	compiler.HashNodes();
+	compiler.FindOutputs();
+	compiler.Allocate();
+
+	if (report != nullptr)
+		*report = std::move(optimized);
+
+	return std::make_shared<const NoiseLang::Program>(std::move(compiler.program));
+}
+
+auto NoiseLang::Compiler::Param(double value) -> void {
+	this->program.params.push_back(value);
+}
+
+auto NoiseLang::Compiler::Push(NoiseLang::OpCode op, const noise::module::Module& origin, std::uint32_t coords, std::uint32_t params, std::uint32_t in0, std::uint32_t in1, std::uint32_t in2) -> std::uint32_t {
+	auto i = NoiseLang::Instruction();
+	i.op = op;
+	i.params = params;
+	i.coords = coords;
+	i.out = NoiseLang::IsTransform(op) ? this->coords++ : this->values++;
+	i.in[0] = in0;
+	i.in[1] = in1;
+	i.in[2] = in2;
+
+	this->program.code.push_back(i);
+	this->program.origins.push_back(&origin);
+	this->walked++;
+	this->walkedCost += this->program.GetCost(i);
+	return i.out;
+}
+
+auto NoiseLang::Compiler::EmitPerlinParams(const noise::module::Perlin& perlin) -> void {
+	this->Param(perlin.GetFrequency());
+	this->Param(perlin.GetLacunarity());
+	this->Param(perlin.GetPersistence());
+	this->Param(perlin.GetOctaveCount());
+	this->Param(perlin.GetSeed());
+	this->Param(perlin.GetNoiseQuality());
+}
+
+auto NoiseLang::Compiler::Emit(const noise::module::Module& module, std::uint32_t coords) -> std::uint32_t {
+	namespace K = NoiseLang::Kernels;
+	using namespace noise::module;
+
+	// A module reached twice at the same coordinates is only lowered once, every consumer reads
+	// the one register it writes. This is what a `cache` module asks for, so caches lower to nothing.
+	auto key = std::make_pair(&module, coords);
+	if (auto it = this->lowered.find(key); it != this->lowered.end()){
+		auto& subtree = this->subtrees[key];
+		this->walked += subtree.evaluations;
+		this->walkedCost += subtree.cost;
+
+		auto optimization = NoiseLang::Optimization();
+		optimization.action = NoiseLang::Optimization::Action::Shared;
+		optimization.op = OpCode::External;
+		for (auto& instruction : this->program.code)
+			if (!NoiseLang::IsTransform(instruction.op) && instruction.out == it->second)
+				optimization.op = instruction.op;
+		optimization.module = &module;
+		optimization.into = nullptr;
+		optimization.saved = subtree.cost;
+		this->shared.push_back(optimization);
+		return it->second;
+	}
+
+	size_t walked = this->walked;
+	double walkedCost = this->walkedCost;
+
+	std::uint32_t params = static_cast<std::uint32_t>(this->program.params.size());
+	std::uint32_t result;
+
+	switch (NoiseLang::GetModuleKind(module)){
+
+		// {{{ Generators
+		case ModuleKind::Billow: {
+			auto& m = static_cast<const Billow&>(module);
+			this->Param(m.GetFrequency());
+			this->Param(m.GetLacunarity());
+			this->Param(m.GetPersistence());
+			this->Param(m.GetOctaveCount());
+			this->Param(m.GetSeed());
+			this->Param(m.GetNoiseQuality());
+			result = this->Push(OpCode::Billow, module, coords, params);
+			break;
+		}
+		case ModuleKind::Checkerboard:
+			result = this->Push(OpCode::Checkerboard, module, coords, params);
+			break;
+		case ModuleKind::Const:
+			this->Param(static_cast<const noise::module::Const&>(module).GetConstValue());
+			result = this->Push(OpCode::Const, module, coords, params);
+			break;
+		case ModuleKind::Cylinders:
+			this->Param(static_cast<const Cylinders&>(module).GetFrequency());
+			result = this->Push(OpCode::Cylinders, module, coords, params);
+			break;
+		case ModuleKind::Perlin:
+			this->EmitPerlinParams(static_cast<const Perlin&>(module));
+			result = this->Push(OpCode::Perlin, module, coords, params);
+			break;
+		case ModuleKind::RidgedMulti: {
+			auto& m = static_cast<const RidgedMulti&>(module);
+			this->Param(m.GetFrequency());
+			this->Param(m.GetLacunarity());
+			this->Param(m.GetOctaveCount());
+			this->Param(m.GetSeed());
+			this->Param(m.GetNoiseQuality());
+			const double* weights = K::RidgedMultiAccess::SpectralWeights(m);
+			for (int octave = 0; octave < m.GetOctaveCount(); octave++)
+				this->Param(weights[octave]);
+			result = this->Push(OpCode::RidgedMulti, module, coords, params);
+			break;
+		}
+		case ModuleKind::Spheres:
+			this->Param(static_cast<const Spheres&>(module).GetFrequency());
+			result = this->Push(OpCode::Spheres, module, coords, params);
+			break;
+		case ModuleKind::Voronoi: {
+			auto& m = static_cast<const Voronoi&>(module);
+			this->Param(m.GetFrequency());
+			this->Param(m.GetDisplacement());
+			this->Param(m.IsDistanceEnabled() ? 1.0 : 0.0);
+			this->Param(m.GetSeed());
+			result = this->Push(OpCode::Voronoi, module, coords, params);
+			break;
+		}
+		// }}}
+
+		// {{{ Single source modifiers
+		case ModuleKind::Cache:
+			// Shared nodes are only lowered once, so a cache has nothing left to do
+			result = this->Emit(module.GetSourceModule(0), coords);
+			break;
+		case ModuleKind::Abs:
+			result = this->Push(OpCode::Abs, module, coords, params, this->Emit(module.GetSourceModule(0), coords));
+			break;
+		case ModuleKind::Invert:
+			result = this->Push(OpCode::Invert, module, coords, params, this->Emit(module.GetSourceModule(0), coords));
+			break;
+		case ModuleKind::Clamp: {
+			auto& m = static_cast<const Clamp&>(module);
+			std::uint32_t a = this->Emit(m.GetSourceModule(0), coords);
+			params = static_cast<std::uint32_t>(this->program.params.size());
+			this->Param(m.GetLowerBound());
+			this->Param(m.GetUpperBound());
+			result = this->Push(OpCode::Clamp, module, coords, params, a);
+			break;
+		}
+		case ModuleKind::Curve: {
+			auto& m = static_cast<const Curve&>(module);
+			if (m.GetControlPointCount() < 4)
+				throw noise::ExceptionInvalidParam();
+
+			std::uint32_t a = this->Emit(m.GetSourceModule(0), coords);
+			params = static_cast<std::uint32_t>(this->program.params.size());
+			this->Param(static_cast<double>(this->program.controlPoints.size()));
+			this->Param(m.GetControlPointCount());
+			for (int i = 0; i < m.GetControlPointCount(); i++)
+				this->program.controlPoints.push_back(m.GetControlPointArray()[i]);
+			result = this->Push(OpCode::Curve, module, coords, params, a);
+			break;
+		}
+		case ModuleKind::Exponent: {
+			auto& m = static_cast<const Exponent&>(module);
+			std::uint32_t a = this->Emit(m.GetSourceModule(0), coords);
+			params = static_cast<std::uint32_t>(this->program.params.size());
+			this->Param(m.GetExponent());
+			result = this->Push(OpCode::Exponent, module, coords, params, a);
+			break;
+		}
+		case ModuleKind::ScaleBias: {
+			auto& m = static_cast<const ScaleBias&>(module);
+			std::uint32_t a = this->Emit(m.GetSourceModule(0), coords);
+			params = static_cast<std::uint32_t>(this->program.params.size());
+			this->Param(m.GetScale());
+			this->Param(m.GetBias());
+			result = this->Push(OpCode::ScaleBias, module, coords, params, a);
+			break;
+		}
+		case ModuleKind::Terrace: {
+			auto& m = static_cast<const Terrace&>(module);
+			if (m.GetControlPointCount() < 2)
+				throw noise::ExceptionInvalidParam();
+
+			std::uint32_t a = this->Emit(m.GetSourceModule(0), coords);
+			params = static_cast<std::uint32_t>(this->program.params.size());
+			this->Param(m.GetControlPointCount());
+			this->Param(m.IsTerracesInverted() ? 1.0 : 0.0);
+			for (int i = 0; i < m.GetControlPointCount(); i++)
+				this->Param(m.GetControlPointArray()[i]);
+			result = this->Push(OpCode::Terrace, module, coords, params, a);
+			break;
+		}
+		// }}}
+
+		// {{{ Combiners
+		case ModuleKind::Add:
+		case ModuleKind::Max:
+		case ModuleKind::Min:
+		case ModuleKind::Multiply:
+		case ModuleKind::Power: {
+			static const std::map<ModuleKind, OpCode> ops = {
+				{ModuleKind::Add, OpCode::Add}, {ModuleKind::Max, OpCode::Max}, {ModuleKind::Min, OpCode::Min},
+				{ModuleKind::Multiply, OpCode::Multiply}, {ModuleKind::Power, OpCode::Power}
+			};
+			std::uint32_t a = this->Emit(module.GetSourceModule(0), coords);
+			std::uint32_t b = this->Emit(module.GetSourceModule(1), coords);
+			result = this->Push(ops.at(NoiseLang::GetModuleKind(module)), module, coords, params, a, b);
+			break;
+		}
+		case ModuleKind::Blend: {
+			std::uint32_t a = this->Emit(module.GetSourceModule(0), coords);
+			std::uint32_t b = this->Emit(module.GetSourceModule(1), coords);
+			std::uint32_t control = this->Emit(module.GetSourceModule(2), coords);
+			result = this->Push(OpCode::Blend, module, coords, params, a, b, control);
+			break;
+		}
+		case ModuleKind::Select: {
+			auto& m = static_cast<const Select&>(module);
+			std::uint32_t a = this->Emit(m.GetSourceModule(0), coords);
+			std::uint32_t b = this->Emit(m.GetSourceModule(1), coords);
+			std::uint32_t control = this->Emit(m.GetSourceModule(2), coords);
+			params = static_cast<std::uint32_t>(this->program.params.size());
+			this->Param(m.GetLowerBound());
+			this->Param(m.GetUpperBound());
+			this->Param(m.GetEdgeFalloff());
+			result = this->Push(OpCode::Select, module, coords, params, a, b, control);
+			break;
+		}
+		// }}}
+
+		// {{{ Point transformers, lower the source module again at the new coordinates
+		case ModuleKind::Displace: {
+			std::uint32_t dx = this->Emit(module.GetSourceModule(1), coords);
+			std::uint32_t dy = this->Emit(module.GetSourceModule(2), coords);
+			std::uint32_t dz = this->Emit(module.GetSourceModule(3), coords);
+			std::uint32_t displaced = this->Push(OpCode::Displace, module, coords, params, dx, dy, dz);
+			result = this->Emit(module.GetSourceModule(0), displaced);
+			break;
+		}
+		case ModuleKind::RotatePoint: {
+			double matrix[9];
+			K::RotatePointAccess::Matrix(static_cast<const RotatePoint&>(module), matrix);
+			for (double v : matrix)
+				this->Param(v);
+			result = this->Emit(module.GetSourceModule(0), this->Push(OpCode::RotatePoint, module, coords, params));
+			break;
+		}
+		case ModuleKind::ScalePoint: {
+			auto& m = static_cast<const ScalePoint&>(module);
+			this->Param(m.GetXScale());
+			this->Param(m.GetYScale());
+			this->Param(m.GetZScale());
+			result = this->Emit(m.GetSourceModule(0), this->Push(OpCode::ScalePoint, module, coords, params));
+			break;
+		}
+		case ModuleKind::TranslatePoint: {
+			auto& m = static_cast<const TranslatePoint&>(module);
+			this->Param(m.GetXTranslation());
+			this->Param(m.GetYTranslation());
+			this->Param(m.GetZTranslation());
+			result = this->Emit(m.GetSourceModule(0), this->Push(OpCode::TranslatePoint, module, coords, params));
+			break;
+		}
+		case ModuleKind::Turbulence: {
+			auto& m = static_cast<const Turbulence&>(module);
+			this->Param(m.GetPower());
+			for (int axis = 0; axis < 3; axis++)
+				this->EmitPerlinParams(K::TurbulenceAccess::DistortModule(m, axis));
+			result = this->Emit(m.GetSourceModule(0), this->Push(OpCode::Turbulence, module, coords, params));
+			break;
+		}
+		// }}}
+
+		default:
+			this->Param(static_cast<double>(this->program.externals.size()));
+			this->program.externals.push_back(&module);
+			result = this->Push(OpCode::External, module, coords, params);
+			break;
+	}
+
+	this->lowered[key] = result;
+	this->moduleValues.push_back({&module, result});
+	this->subtrees[key] = {this->walked - walked, this->walkedCost - walkedCost};
+	return result;
+}
+
+auto NoiseLang::Compiler::Optimize(NoiseLang::OptimizerReport& report) -> void {
+	// One pass in topological order: point inputs at the copies that survived, fold
+	// instructions whose inputs are all constant, then merge identical instructions
+	auto& code = this->program.code;
+
+	std::vector<std::uint32_t> valueAlias(this->values);
+	std::vector<std::uint32_t> coordAlias(this->coords);
+	for (std::uint32_t v = 0; v < this->values; v++)
+		valueAlias[v] = v;
+	for (std::uint32_t c = 0; c < this->coords; c++)
+		coordAlias[c] = c;
+
+	std::map<std::uint32_t, double> constants;
+	std::map<std::vector<double>, size_t> seen;
+	std::vector<bool> merged(code.size(), false);
+
+	for (size_t i = 0; i < code.size(); i++){
+		auto& instruction = code[i];
+		int inputCount = NoiseLang::GetInputCount(instruction.op);
+
+		for (int j = 0; j < inputCount; j++)
+			instruction.in[j] = valueAlias[instruction.in[j]];
+		instruction.coords = coordAlias[instruction.coords];
+
+		// Only generators and transforms read their coordinates, so a modifier is the same
+		// instruction whichever frame it was lowered in
+		if (!NoiseLang::IsGenerator(instruction.op) && !NoiseLang::IsTransform(instruction.op))
+			instruction.coords = 0;
+
+		double inputs[3];
+		bool foldable = inputCount > 0 && !NoiseLang::IsTransform(instruction.op);
+		for (int j = 0; j < inputCount && foldable; j++){
+			if (auto it = constants.find(instruction.in[j]); it != constants.end())
+				inputs[j] = it->second;
+			else
+				foldable = false;
+		}
+
+		if (foldable){
+			auto optimization = NoiseLang::Optimization();
+			optimization.action = NoiseLang::Optimization::Action::Folded;
+			optimization.op = instruction.op;
+			optimization.module = this->program.origins[i];
+			optimization.into = nullptr;
+			optimization.saved = this->program.GetCost(instruction);
+
+			double value = this->Fold(instruction, inputs);
+			instruction.op = OpCode::Const;
+			instruction.params = static_cast<std::uint32_t>(this->program.params.size());
+			instruction.in[0] = instruction.in[1] = instruction.in[2] = 0;
+			this->Param(value);
+
+			optimization.saved -= this->program.GetCost(instruction);
+			report.optimizations.push_back(optimization);
+		}
+
+		if (instruction.op == OpCode::Const)
+			constants[instruction.out] = this->program.params[instruction.params];
+
+		// The key is everything the instruction computes from, so equal keys mean equal outputs
+		std::vector<double> key = {static_cast<double>(instruction.op), static_cast<double>(instruction.coords)};
+		for (int j = 0; j < inputCount; j++)
+			key.push_back(instruction.in[j]);
+
+		const double* p = this->program.params.data() + instruction.params;
+		if (instruction.op == OpCode::Curve){
+			auto* points = this->program.controlPoints.data() + static_cast<size_t>(p[0]);
+			for (int point = 0; point < static_cast<int>(p[1]); point++){
+				key.push_back(points[point].inputValue);
+				key.push_back(points[point].outputValue);
+			}
+		} else {
+			key.insert(key.end(), p, p + this->program.GetParamCount(instruction));
+		}
+
+		auto [it, inserted] = seen.emplace(std::move(key), i);
+		if (!inserted){
+			auto& kept = code[it->second];
+			if (NoiseLang::IsTransform(instruction.op))
+				coordAlias[instruction.out] = kept.out;
+			else
+				valueAlias[instruction.out] = kept.out;
+			merged[i] = true;
+
+			auto optimization = NoiseLang::Optimization();
+			optimization.action = NoiseLang::Optimization::Action::Merged;
+			optimization.op = instruction.op;
+			optimization.module = this->program.origins[i];
+			optimization.into = this->program.origins[it->second];
+			optimization.saved = this->program.GetCost(instruction);
+			report.optimizations.push_back(optimization);
+		}
+	}
+
+	this->program.result = valueAlias[this->program.result];
+	for (auto& value : this->moduleValues)
+		value.second = valueAlias[value.second];
+	this->Remove(merged);
+}
+
+auto NoiseLang::Compiler::Prune(NoiseLang::OptimizerReport& report) -> void {
+	// Walk back from the result, anything no live instruction reads is dropped. Emit only
+	// reaches what `out` uses, so this is what folding left behind (e.g. the consts it ate)
+	auto& code = this->program.code;
+
+	std::vector<bool> liveValues(this->values, false);
+	std::vector<bool> liveCoords(this->coords, false);
+	std::vector<bool> dead(code.size(), false);
+	liveValues[this->program.result] = true;
+
+	for (size_t i = code.size(); i-- > 0;){
+		auto& instruction = code[i];
+
+		if (NoiseLang::IsTransform(instruction.op) ? !liveCoords[instruction.out] : !liveValues[instruction.out]){
+			dead[i] = true;
+
+			auto optimization = NoiseLang::Optimization();
+			optimization.action = NoiseLang::Optimization::Action::Pruned;
+			optimization.op = instruction.op;
+			optimization.module = this->program.origins[i];
+			optimization.into = nullptr;
+			optimization.saved = this->program.GetCost(instruction);
+			report.optimizations.push_back(optimization);
+			continue;
+		}
+
+		liveCoords[instruction.coords] = true;
+		for (int j = 0; j < NoiseLang::GetInputCount(instruction.op); j++)
+			liveValues[instruction.in[j]] = true;
+	}
+
+	this->Remove(dead);
+}
+
+auto NoiseLang::Compiler::Fold(const NoiseLang::Instruction& instruction, const double* inputs) -> double {
+	// Run the instruction once on its constant inputs, as a program of its own
+	auto fold = NoiseLang::Program();
+	int inputCount = NoiseLang::GetInputCount(instruction.op);
+
+	for (int j = 0; j < inputCount; j++){
+		auto input = NoiseLang::Instruction();
+		input.op = OpCode::Const;
+		input.params = static_cast<std::uint32_t>(j);
+		input.coords = 0;
+		input.out = static_cast<std::uint32_t>(j);
+		input.in[0] = input.in[1] = input.in[2] = 0;
+		fold.code.push_back(input);
+		fold.params.push_back(inputs[j]);
+	}
+
+	auto folded = instruction;
+	folded.params = static_cast<std::uint32_t>(fold.params.size());
+	folded.coords = 0;
+	folded.out = static_cast<std::uint32_t>(inputCount);
+	for (int j = 0; j < inputCount; j++)
+		folded.in[j] = static_cast<std::uint32_t>(j);
+
+	const double* p = this->program.params.data() + instruction.params;
+	fold.params.insert(fold.params.end(), p, p + this->program.GetParamCount(instruction));
+	if (instruction.op == OpCode::Curve){
+		auto* points = this->program.controlPoints.data() + static_cast<size_t>(p[0]);
+		fold.controlPoints.assign(points, points + static_cast<size_t>(p[1]));
+		fold.params[folded.params] = 0.0;
+	}
+
+	fold.code.push_back(folded);
+	fold.valueRegisters = static_cast<std::uint32_t>(inputCount + 1);
+	fold.result = folded.out;
+
+	return NoiseLang::ProgramEvaluator(1).GetValue(fold, 0.0, 0.0, 0.0);
+}
+
+auto NoiseLang::Compiler::Tabulate(NoiseLang::OptimizerReport& report, double maxError) -> void {
+	// Each curve and terrace becomes the smallest table within `maxError` of it. The error is
+	// measured at 8 points per entry and at every control point, where both may bend sharply.
+	namespace K = NoiseLang::Kernels;
+	auto& code = this->program.code;
+
+	for (size_t i = 0; i < code.size(); i++){
+		auto& instruction = code[i];
+		if (instruction.op != OpCode::Curve && instruction.op != OpCode::Terrace)
+			continue;
+
+		// Both are constant outside their first and last control points
+		auto step = NoiseLang::ChainStep{instruction.op, this->program.params.data() + instruction.params};
+		std::vector<double> knots;
+		if (instruction.op == OpCode::Curve){
+			auto* points = this->program.controlPoints.data() + static_cast<size_t>(step.params[0]);
+			for (int point = 0; point < static_cast<int>(step.params[1]); point++)
+				knots.push_back(points[point].inputValue);
+		} else {
+			knots.assign(step.params + 2, step.params + 2 + static_cast<size_t>(step.params[0]));
+		}
+		double low = knots.front(), high = knots.back();
+
+		auto optimization = NoiseLang::Optimization();
+		optimization.action = NoiseLang::Optimization::Action::Tabulated;
+		optimization.op = instruction.op;
+		optimization.module = this->program.origins[i];
+		optimization.into = nullptr;
+		optimization.saved = 0.0;
+
+		std::vector<double> table;
+		for (size_t entries = MinTableEntries; entries <= MaxTableEntries; entries *= 2){
+			double spacing = (high - low) / static_cast<double>(entries - 1);
+			std::vector<double> inputs(entries);
+			for (size_t j = 0; j < entries; j++)
+				inputs[j] = j + 1 < entries ? low + spacing * static_cast<double>(j) : high;
+			table.resize(entries);
+			NoiseLang::ProgramEvaluator::RunStep(this->program, step, inputs.data(), table.data(), entries);
+
+			std::vector<double> checks = knots;
+			for (size_t j = 0; j + 1 < entries; j++)
+				for (int k = 1; k < 8; k++)
+					checks.push_back(low + spacing * (static_cast<double>(j) + k / 8.0));
+			std::vector<double> exact(checks.size()), tabulated(checks.size());
+			NoiseLang::ProgramEvaluator::RunStep(this->program, step, checks.data(), exact.data(), checks.size());
+			K::Table(checks.data(), tabulated.data(), checks.size(), table.data(), entries, low, high);
+
+			optimization.error = 0.0;
+			for (size_t j = 0; j < checks.size(); j++)
+				optimization.error = std::max(optimization.error, std::fabs(exact[j] - tabulated[j]));
+			if (optimization.error <= maxError){
+				optimization.entries = entries;
+				break;
+			}
+		}
+
+		if (optimization.entries > 0){
+			optimization.saved = this->program.GetCost(instruction);
+			instruction.op = OpCode::Table;
+			instruction.params = static_cast<std::uint32_t>(this->program.params.size());
+			this->Param(static_cast<double>(table.size()));
+			this->Param(low);
+			this->Param(high);
+			this->program.params.insert(this->program.params.end(), table.begin(), table.end());
+			optimization.saved -= this->program.GetCost(instruction);
+		}
+		report.optimizations.push_back(optimization);
+	}
+}
+
+auto NoiseLang::Compiler::Fuse(NoiseLang::OptimizerReport& report) -> void {
+	// A pointwise instruction whose input only it reads, written by another pointwise instruction,
+	// takes that instruction's steps in front of its own. Registers are still unique here.
+	auto& code = this->program.code;
+
+	std::vector<size_t> readers(this->values, 0);
+	std::vector<std::int64_t> writers(this->values, -1);
+	readers[this->program.result]++;
+	for (size_t i = 0; i < code.size(); i++){
+		for (int j = 0; j < NoiseLang::GetInputCount(code[i].op); j++)
+			readers[code[i].in[j]]++;
+		if (!NoiseLang::IsTransform(code[i].op))
+			writers[code[i].out] = static_cast<std::int64_t>(i);
+	}
+
+	std::vector<bool> fused(code.size(), false);
+	for (size_t i = 0; i < code.size(); i++){
+		auto& instruction = code[i];
+		if (!NoiseLang::IsPointwise(instruction.op) || readers[instruction.in[0]] != 1 || writers[instruction.in[0]] < 0)
+			continue;
+		size_t w = static_cast<size_t>(writers[instruction.in[0]]);
+		auto& source = code[w];
+		if (!NoiseLang::IsPointwise(source.op))
+			continue;
+
+		NoiseLang::ChainStep steps[NoiseLang::Program::MaxChainSteps * 2];
+		size_t sourceSteps = this->program.GetSteps(source, steps);
+		size_t count = sourceSteps + this->program.GetSteps(instruction, steps + sourceSteps);
+		if (count > NoiseLang::Program::MaxChainSteps)
+			continue;
+
+		// The steps point into `params`, so the block is put together before it grows
+		std::vector<double> block = {0.0, static_cast<double>(count)};
+		for (size_t k = 0; k < count; k++){
+			block.push_back(static_cast<double>(steps[k].op));
+			block.insert(block.end(), steps[k].params, steps[k].params + NoiseLang::Program::GetParamCount(steps[k].op, steps[k].params));
+		}
+		block[0] = static_cast<double>(block.size());
+
+		auto optimization = NoiseLang::Optimization();
+		optimization.action = NoiseLang::Optimization::Action::Fused;
+		optimization.op = steps[sourceSteps - 1].op;
+		optimization.module = this->program.origins[w];
+		optimization.into = this->program.origins[i];
+		optimization.saved = this->program.GetCost(source) + this->program.GetCost(instruction);
+
+		instruction.op = OpCode::Chain;
+		instruction.params = static_cast<std::uint32_t>(this->program.params.size());
+		instruction.in[0] = source.in[0];
+		this->program.params.insert(this->program.params.end(), block.begin(), block.end());
+		optimization.saved -= this->program.GetCost(instruction);
+		fused[w] = true;
+
+		// Modules fused into the source end up in this chain too
+		for (auto& o : report.optimizations)
+			if (o.action == NoiseLang::Optimization::Action::Fused && o.into == optimization.module)
+				o.into = optimization.into;
+		report.optimizations.push_back(optimization);
+	}
+
+	this->Remove(fused);
+}
+
+auto NoiseLang::Compiler::Remove(const std::vector<bool>& removed) -> void {
+	auto& code = this->program.code;
+	auto& origins = this->program.origins;
+
+	size_t kept = 0;
+	for (size_t i = 0; i < code.size(); i++){
+		if (removed[i])
+			continue;
+		code[kept] = code[i];
+		origins[kept] = origins[i];
+		kept++;
+	}
+
+	code.resize(kept);
+	origins.resize(kept);
+}
+
+auto NoiseLang::Compiler::HashNodes() -> void {
+	// Registers are still unique here, so a register's hash is that of the one instruction writing it
+	auto& code = this->program.code;
+	std::vector<std::uint64_t> valueHashes(this->values, 0);
+	std::vector<std::uint64_t> coordHashes(this->coords, 0);
+	coordHashes[0] = 14695981039346656037ull;
+
+	this->program.nodeHashes.resize(code.size());
+	for (size_t i = 0; i < code.size(); i++){
+		auto& instruction = code[i];
+		int inputCount = NoiseLang::GetInputCount(instruction.op);
+
+		std::uint64_t hash = 14695981039346656037ull;
+		auto mix = [&hash](std::uint64_t value){
+			hash = (hash ^ value) * 1099511628211ull;
+			hash ^= hash >> 31;
+		};
+		auto mixDouble = [&mix](double value){
+			std::uint64_t bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			mix(bits);
+		};
+
+		bool external = instruction.op == OpCode::External;
+		mix(static_cast<std::uint64_t>(instruction.op));
+		// Only the gradient noise generators change with precision, what reads them changes through their hash
+		bool gradient = instruction.op == OpCode::Billow || instruction.op == OpCode::Perlin || instruction.op == OpCode::RidgedMulti;
+		if (gradient && this->program.precision != NoiseLang::Precision::Double)
+			mix(static_cast<std::uint64_t>(this->program.precision));
+		// Nor with level of detail, along with turbulence, tagged apart from any precision. The
+		// spacing it depends on is part of every cache key.
+		if ((gradient || instruction.op == OpCode::Turbulence) && this->program.lod)
+			mix(0x10d);
+		if (NoiseLang::IsGenerator(instruction.op) || NoiseLang::IsTransform(instruction.op)){
+			mix(coordHashes[instruction.coords]);
+			external = external || coordHashes[instruction.coords] == 0;
+		}
+		for (int j = 0; j < inputCount; j++){
+			mix(valueHashes[instruction.in[j]]);
+			external = external || valueHashes[instruction.in[j]] == 0;
+		}
+
+		// Curves hash their points rather than where they sit in `controlPoints`, in chains too
+		auto mixParams = [&](OpCode op, const double* p){
+			if (op == OpCode::Curve){
+				auto* points = this->program.controlPoints.data() + static_cast<size_t>(p[0]);
+				for (int point = 0; point < static_cast<int>(p[1]); point++){
+					mixDouble(points[point].inputValue);
+					mixDouble(points[point].outputValue);
+				}
+			} else {
+				for (size_t j = 0; j < NoiseLang::Program::GetParamCount(op, p); j++)
+					mixDouble(p[j]);
+			}
+		};
+		if (instruction.op == OpCode::Chain){
+			NoiseLang::ChainStep steps[NoiseLang::Program::MaxChainSteps];
+			size_t count = this->program.GetSteps(instruction, steps);
+			for (size_t k = 0; k < count; k++){
+				mix(static_cast<std::uint64_t>(steps[k].op));
+				mixParams(steps[k].op, steps[k].params);
+			}
+		} else {
+			mixParams(instruction.op, this->program.params.data() + instruction.params);
+		}
+
+		hash = external ? 0 : std::max<std::uint64_t>(hash, 1);
+		this->program.nodeHashes[i] = hash;
+		(NoiseLang::IsTransform(instruction.op) ? coordHashes : valueHashes)[instruction.out] = hash;
+	}
+}
+
+auto NoiseLang::Compiler::FindOutputs() -> void {
+	// Registers are still unique here, so each names the one instruction writing it
+	const std::uint32_t none = UINT32_MAX;
+	std::vector<std::uint32_t> writers(this->values, none);
+	for (size_t i = 0; i < this->program.code.size(); i++)
+		if (!NoiseLang::IsTransform(this->program.code[i].op))
+			writers[this->program.code[i].out] = static_cast<std::uint32_t>(i);
+
+	// Modules folded into their consumers have nothing left to point at
+	for (auto& [module, value] : this->moduleValues)
+		if (writers[value] != none)
+			this->program.outputs.push_back({module, writers[value]});
+}
+
+auto NoiseLang::Compiler::Allocate() -> void {
+	// Map the compiler's virtual registers onto as few physical registers as possible,
+	// reusing a register as soon as the last instruction reading it has run
+	auto& code = this->program.code;
+	const std::uint32_t none = UINT32_MAX;
+
+	const std::uint32_t result = this->program.result;
+
+	std::vector<size_t> lastValueUse(this->values, 0);
+	std::vector<size_t> lastCoordUse(this->coords, 0);
+	for (size_t i = 0; i < code.size(); i++){
+		lastCoordUse[code[i].coords] = i;
+		for (int j = 0; j < NoiseLang::GetInputCount(code[i].op); j++)
+			lastValueUse[code[i].in[j]] = i;
+	}
+
+	std::vector<std::uint32_t> valueMap(this->values, none);
+	std::vector<std::uint32_t> coordMap(this->coords, none);
+	std::vector<std::uint32_t> freeValues, freeCoords;
+	coordMap[0] = 0;
+
+	for (size_t i = 0; i < code.size(); i++){
+		auto& instruction = code[i];
+
+		// Every kernel reads element i before writing element i, so the output may reuse an input register
+		// The same value may feed several inputs, so map them all before freeing any
+		std::uint32_t inputs[3] = {0, 0, 0};
+		int inputCount = NoiseLang::GetInputCount(instruction.op);
+		for (int j = 0; j < inputCount; j++){
+			inputs[j] = instruction.in[j];
+			instruction.in[j] = valueMap[inputs[j]];
+		}
+		for (int j = 0; j < inputCount; j++){
+			std::uint32_t v = inputs[j];
+			if (lastValueUse[v] == i && v != result && valueMap[v] != none){
+				freeValues.push_back(valueMap[v]);
+				valueMap[v] = none;
+			}
+		}
+
+		std::uint32_t c = instruction.coords;
+		instruction.coords = coordMap[c];
+		if (c != 0 && lastCoordUse[c] == i && coordMap[c] != none){
+			freeCoords.push_back(coordMap[c]);
+			coordMap[c] = none;
+		}
+
+		if (NoiseLang::IsTransform(instruction.op)){
+			if (freeCoords.empty())
+				freeCoords.push_back(this->program.coordRegisters++);
+			coordMap[instruction.out] = freeCoords.back();
+			freeCoords.pop_back();
+			instruction.out = coordMap[instruction.out];
+		} else {
+			if (freeValues.empty())
+				freeValues.push_back(this->program.valueRegisters++);
+			std::uint32_t v = instruction.out;
+			valueMap[v] = freeValues.back();
+			freeValues.pop_back();
+			instruction.out = valueMap[v];
+			if (v == result)
+				this->program.result = instruction.out;
+		}
+	}
+}
+
+NoiseLang::ProgramEvaluator::ProgramEvaluator(size_t blockSize) {
+	this->blockSize = blockSize > 0 ? blockSize : DefaultBlockSize;
+}
+
+#ifdef NOISELANG_PROFILE
+auto NoiseLang::ProgramEvaluator::SetProfile(NoiseLang::ProgramProfile* profile) -> void {
+	this->profile = profile;
+}
+#endif
+
+auto NoiseLang::ProgramEvaluator::Prepare(const NoiseLang::Program& program, double spacing) -> void {
+	if (this->values.size() < program.valueRegisters)
+		this->values.resize(program.valueRegisters, std::vector<double>(this->blockSize));
+	if (this->coords.size() < program.coordRegisters * 3)
+		this->coords.resize(program.coordRegisters * 3, std::vector<double>(this->blockSize));
+	if (this->temp.size() < this->blockSize * 6)
+		this->temp.resize(this->blockSize * 6);
+
+	this->cx.resize(program.coordRegisters);
+	this->cy.resize(program.coordRegisters);
+	this->cz.resize(program.coordRegisters);
+	for (std::uint32_t c = 1; c < program.coordRegisters; c++){
+		this->cx[c] = this->coords[c * 3].data();
+		this->cy[c] = this->coords[c * 3 + 1].data();
+		this->cz[c] = this->coords[c * 3 + 2].data();
+	}
+
+	program.GetDetail(spacing, this->detail);
+}
+
+auto NoiseLang::ProgramEvaluator::Evaluate(const NoiseLang::Program& program, const double* x, const double* y, const double* z, double* out, size_t count, double spacing) -> void {
+	this->Prepare(program, spacing);
+
+	for (size_t offset = 0; offset < count; offset += this->blockSize){
+		size_t n = std::min(this->blockSize, count - offset);
+		this->EvaluateBlock(program, x + offset, y + offset, z + offset, out + offset, n);
+	}
+}
+
+auto NoiseLang::ProgramEvaluator::Evaluate(const NoiseLang::Program& program, const double* x, const double* y, const double* z, double* out, size_t count, NoiseLang::NodeBuffers& nodes, double spacing) -> void {
+	this->Prepare(program, spacing);
+	this->Plan(program, nodes);
+
+	for (size_t offset = 0; offset < count; offset += this->blockSize){
+		size_t n = std::min(this->blockSize, count - offset);
+		this->EvaluateBlock(program, x + offset, y + offset, z + offset, out + offset, n, &nodes, offset, count);
+	}
+}
+
+auto NoiseLang::ProgramEvaluator::Plan(const NoiseLang::Program& program, NoiseLang::NodeBuffers& nodes) -> void {
+	// Registers are shared once allocated, so first find which instruction each input was written by
+	auto& code = program.code;
+	nodes.reuse.resize(code.size(), nullptr);
+	nodes.record.resize(code.size(), nullptr);
+
+	this->lastValue.assign(program.valueRegisters, -1);
+	this->lastCoord.assign(program.coordRegisters, -1);
+	std::vector<std::int64_t> producers(code.size() * 4, -1);
+	for (size_t i = 0; i < code.size(); i++){
+		for (int j = 0; j < NoiseLang::GetInputCount(code[i].op); j++)
+			producers[i * 4 + j] = this->lastValue[code[i].in[j]];
+		producers[i * 4 + 3] = this->lastCoord[code[i].coords];
+		(NoiseLang::IsTransform(code[i].op) ? this->lastCoord : this->lastValue)[code[i].out] = static_cast<std::int64_t>(i);
+	}
+
+	// Then walk back from the result, stopping at anything that can be read back
+	this->needed.assign(code.size(), false);
+	if (std::int64_t result = this->lastValue[program.result]; result >= 0)
+		this->needed[static_cast<size_t>(result)] = true;
+	for (size_t i = code.size(); i-- > 0;){
+		if (!this->needed[i] || nodes.reuse[i] != nullptr)
+			continue;
+		for (int j = 0; j < 4; j++){
+			if (producers[i * 4 + j] >= 0)
+				this->needed[static_cast<size_t>(producers[i * 4 + j])] = true;
+		}
+	}
+
+	for (size_t i = 0; i < code.size(); i++){
+		if (!this->needed[i] || nodes.reuse[i] != nullptr)
+			nodes.record[i] = nullptr;
+	}
+}
+
+auto NoiseLang::ProgramEvaluator::EvaluateGrid(const NoiseLang::Program& program, const NoiseLang::PointGrid& grid, double* out) -> void {
+	this->Prepare(program, std::max(std::fabs(grid.stepX), std::fabs(grid.stepY)));
+
+	auto& x = this->gx;
+	auto& y = this->gy;
+	auto& z = this->gz;
+	x.resize(this->blockSize);
+	y.resize(this->blockSize);
+	z.assign(this->blockSize, grid.z);
+
+	size_t total = static_cast<size_t>(grid.width) * grid.height;
+	for (size_t offset = 0; offset < total; offset += this->blockSize){
+		size_t n = std::min(this->blockSize, total - offset);
+
+		for (size_t i = 0; i < n; i++){
+			size_t index = offset + i;
+			x[i] = grid.originX + static_cast<double>(index % grid.width) * grid.stepX;
+			y[i] = grid.originY + static_cast<double>(index / grid.width) * grid.stepY;
+		}
+
+		this->EvaluateBlock(program, x.data(), y.data(), z.data(), out + offset, n);
+	}
+}
+
+auto NoiseLang::ProgramEvaluator::GetValue(const NoiseLang::Program& program, double x, double y, double z) -> double {
+	double value;
+	this->Prepare(program);
+	this->EvaluateBlock(program, &x, &y, &z, &value, 1);
+	return value;
+}
+
+auto NoiseLang::ProgramEvaluator::RunStep(const NoiseLang::Program& program, const NoiseLang::ChainStep& step, const double* a, double* out, size_t count) -> void {
+	namespace K = NoiseLang::Kernels;
+	const double* p = step.params;
+
+	switch (step.op){
+		case OpCode::Abs: K::Abs(a, out, count); break;
+		case OpCode::Invert: K::Invert(a, out, count); break;
+		case OpCode::Clamp: K::Clamp(a, out, count, p[0], p[1]); break;
+		case OpCode::Curve: K::Curve(a, out, count, program.controlPoints.data() + static_cast<size_t>(p[0]), static_cast<int>(p[1])); break;
+		case OpCode::Exponent: K::Exponent(a, out, count, p[0]); break;
+		case OpCode::ScaleBias: K::ScaleBias(a, out, count, p[0], p[1]); break;
+		case OpCode::Terrace: K::Terrace(a, out, count, p + 2, static_cast<int>(p[0]), p[1] != 0.0); break;
+		case OpCode::Table: K::Table(a, out, count, p + 3, static_cast<size_t>(p[0]), p[1], p[2]); break;
+		default: break;
+	}
+}
+
+auto NoiseLang::ProgramEvaluator::EvaluateBlock(const NoiseLang::Program& program, const double* x, const double* y, const double* z, double* out, size_t count, const NoiseLang::NodeBuffers* nodes, size_t offset, size_t total) -> void {
+	namespace K = NoiseLang::Kernels;
+	bool single = program.precision == NoiseLang::Precision::Single;
+
+	this->cx[0] = x;
+	this->cy[0] = y;
+	this->cz[0] = z;
+
+	for (size_t n = 0; n < program.code.size(); n++){
+		auto& i = program.code[n];
+		int planes = NoiseLang::IsTransform(i.op) ? 3 : 1;
+
+		if (nodes != nullptr && !this->needed[n])
+			continue;
+		if (nodes != nullptr && nodes->reuse[n] != nullptr){
+			for (int plane = 0; plane < planes; plane++){
+				const double* source = nodes->reuse[n] + plane * total + offset;
+				std::copy(source, source + count, planes == 3 ? this->coords[i.out * 3 + plane].data() : this->values[i.out].data());
+			}
+			continue;
+		}
+
+#ifdef NOISELANG_PROFILE
+		auto start = std::chrono::steady_clock::now();
+#endif
+
+		const double* p = program.params.data() + i.params;
+		const double* px = this->cx[i.coords];
+		const double* py = this->cy[i.coords];
+		const double* pz = this->cz[i.coords];
+
+		double* o = nullptr;
+		double *ox = nullptr, *oy = nullptr, *oz = nullptr;
+		if (NoiseLang::IsTransform(i.op)){
+			ox = this->coords[i.out * 3].data();
+			oy = this->coords[i.out * 3 + 1].data();
+			oz = this->coords[i.out * 3 + 2].data();
+		} else {
+			o = this->values[i.out].data();
+		}
+
+		// Unused inputs are left at register 0, so these are always valid
+		const double* a = this->values[i.in[0]].data();
+		const double* b = this->values[i.in[1]].data();
+		const double* c = this->values[i.in[2]].data();
+
+		switch (i.op){
+			case OpCode::Billow:
+				(single ? K::Single::Billow : K::Billow)(px, py, pz, o, count, p[0], p[1], p[2], this->detail[n].octaves, static_cast<int>(p[4]), static_cast<noise::NoiseQuality>(static_cast<int>(p[5])), this->detail[n].fade);
+				break;
+			case OpCode::Checkerboard:
+				K::Checkerboard(px, py, pz, o, count);
+				break;
+			case OpCode::Const:
+				K::Const(o, count, p[0]);
+				break;
+			case OpCode::Cylinders:
+				K::Cylinders(px, pz, o, count, p[0]);
+				break;
+			case OpCode::Perlin:
+				(single ? K::Single::Perlin : K::Perlin)(px, py, pz, o, count, p[0], p[1], p[2], this->detail[n].octaves, static_cast<int>(p[4]), static_cast<noise::NoiseQuality>(static_cast<int>(p[5])), this->detail[n].fade);
+				break;
+			case OpCode::RidgedMulti:
+				(single ? K::Single::RidgedMulti : K::RidgedMulti)(px, py, pz, o, count, p[0], p[1], this->detail[n].octaves, static_cast<int>(p[3]), static_cast<noise::NoiseQuality>(static_cast<int>(p[4])), p + 5, this->detail[n].fade);
+				break;
+			case OpCode::Spheres:
+				K::Spheres(px, py, pz, o, count, p[0]);
+				break;
+			case OpCode::Voronoi:
+				K::Voronoi(px, py, pz, o, count, p[0], p[1], p[2] != 0.0, static_cast<int>(p[3]));
+				break;
+
+			case OpCode::Abs: case OpCode::Invert: case OpCode::Clamp: case OpCode::Curve: case OpCode::Exponent: case OpCode::ScaleBias: case OpCode::Terrace: case OpCode::Table:
+				RunStep(program, NoiseLang::ChainStep{i.op, p}, a, o, count);
+				break;
+			case OpCode::Chain: {
+				// A slice at a time through every step, so the block is read and written once
+				NoiseLang::ChainStep steps[NoiseLang::Program::MaxChainSteps];
+				size_t stepCount = program.GetSteps(i, steps);
+				double slice[ChainSlice];
+				for (size_t start = 0; start < count; start += ChainSlice){
+					size_t n = std::min(static_cast<size_t>(ChainSlice), count - start);
+					RunStep(program, steps[0], a + start, slice, n);
+					for (size_t k = 1; k < stepCount; k++)
+						RunStep(program, steps[k], slice, slice, n);
+					std::copy(slice, slice + n, o + start);
+				}
+				break;
+			}
+			case OpCode::Add: K::Add(a, b, o, count); break;
+			case OpCode::Max: K::Max(a, b, o, count); break;
+			case OpCode::Min: K::Min(a, b, o, count); break;
+			case OpCode::Multiply: K::Multiply(a, b, o, count); break;
+			case OpCode::Power: K::Power(a, b, o, count); break;
+			case OpCode::Blend: K::Blend(a, b, c, o, count); break;
+			case OpCode::Select: K::Select(a, b, c, o, count, p[0], p[1], p[2]); break;
+
+			case OpCode::Displace:
+				for (size_t j = 0; j < count; j++){
+					ox[j] = px[j] + a[j];
+					oy[j] = py[j] + b[j];
+					oz[j] = pz[j] + c[j];
+				}
+				break;
+			case OpCode::RotatePoint:
+				K::RotatePoint(px, py, pz, ox, oy, oz, count, p);
+				break;
+			case OpCode::ScalePoint:
+				K::ScalePoint(px, py, pz, ox, oy, oz, count, p[0], p[1], p[2]);
+				break;
+			case OpCode::TranslatePoint:
+				K::TranslatePoint(px, py, pz, ox, oy, oz, count, p[0], p[1], p[2]);
+				break;
+			case OpCode::Turbulence: {
+				// Distortions go to temporaries first, the output may share a register with the input
+				double* offset[3] = {&this->temp[0], &this->temp[this->blockSize], &this->temp[this->blockSize * 2]};
+				double* distort[3] = {&this->temp[this->blockSize * 3], &this->temp[this->blockSize * 4], &this->temp[this->blockSize * 5]};
+				for (int axis = 0; axis < 3; axis++){
+					const double* q = p + 1 + axis * 6;
+					K::TranslatePoint(px, py, pz, offset[0], offset[1], offset[2], count, K::TurbulenceOffsets[axis][0], K::TurbulenceOffsets[axis][1], K::TurbulenceOffsets[axis][2]);
+					K::Perlin(offset[0], offset[1], offset[2], distort[axis], count, q[0], q[1], q[2], this->detail[n].octaves, static_cast<int>(q[4]), static_cast<noise::NoiseQuality>(static_cast<int>(q[5])), this->detail[n].fade);
+				}
+				for (size_t j = 0; j < count; j++){
+					ox[j] = px[j] + (distort[0][j] * p[0]);
+					oy[j] = py[j] + (distort[1][j] * p[0]);
+					oz[j] = pz[j] + (distort[2][j] * p[0]);
+				}
+				break;
+			}
+
+			case OpCode::External: {
+				auto* module = program.externals[static_cast<size_t>(p[0])];
+				for (size_t j = 0; j < count; j++)
+					o[j] = module->GetValue(px[j], py[j], pz[j]);
+				break;
+			}
+		}
+
+		// What the octaves level of detail dropped would have added on average
+		if (double bias = this->detail[n].bias; bias != 0.0){
+			for (size_t j = 0; j < count; j++)
+				o[j] += bias;
+		}
+
+#ifdef NOISELANG_PROFILE
+		if (this->profile != nullptr){
+			auto& profile = *this->profile;
+			if (profile.seconds.size() < program.code.size()){
+				profile.seconds.resize(program.code.size(), 0.0);
+				profile.calls.resize(program.code.size(), 0);
+				profile.samples.resize(program.code.size(), 0);
+			}
+			profile.seconds[n] += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			profile.calls[n]++;
+			profile.samples[n] += count;
+		}
+#endif
+
+		if (nodes != nullptr && nodes->record[n] != nullptr){
+			for (int plane = 0; plane < planes; plane++){
+				const double* source = planes == 3 ? this->coords[i.out * 3 + plane].data() : o;
+				std::copy(source, source + count, nodes->record[n] + plane * total + offset);
+			}
+		}
+	}
+
+	const double* result = this->values[program.result].data();
+	std::copy(result, result + count, out);
+}
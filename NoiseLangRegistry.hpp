@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vendor/include/noise/noise.h"
+
+namespace NoiseLang {
+
+	enum class ArgumentType {Number, Identifier};
+
+	// A method call's arguments once the interpreter has checked them against the signature,
+	// identifiers are already looked up so handlers never touch the module map
+	class MethodArguments {
+		public:
+			static const unsigned int Max = 3;
+
+			double numbers[Max];
+			noise::module::Module* modules[Max];
+	};
+
+	class MethodSpec {
+		public:
+			std::string name;
+			std::vector<NoiseLang::ArgumentType> signature;
+
+			// Only ever called with the module kind the spec was registered under
+			void (*handler)(noise::module::Module& module, const NoiseLang::MethodArguments& arguments);
+	};
+
+	class ModuleSpec {
+		public:
+			std::string name;
+
+			// Source modules given in the assignment, `a = add(b, c)` takes two
+			unsigned int sourceCount;
+			std::shared_ptr<noise::module::Module> (*create)();
+
+			std::vector<NoiseLang::MethodSpec> methods;
+
+			// Indexed by method id, nullptr where this kind has no method of that name
+			std::vector<const NoiseLang::MethodSpec*> dispatch;
+	};
+
+	// Every module kind the language knows and the methods each one takes. Names are resolved
+	// to a kind or a method id once, by the parser, so running a line is a table lookup.
+	class Registry {
+		private:
+			std::vector<NoiseLang::ModuleSpec> kinds;
+			std::vector<std::string> methodNames;
+
+			Registry();
+
+			auto Register(const std::string& name, unsigned int sourceCount, std::shared_ptr<noise::module::Module> (*create)(), std::vector<NoiseLang::MethodSpec> methods) -> void;
+
+		public:
+			static auto Get() -> const NoiseLang::Registry&;
+
+			auto FindKind(std::string_view name) const -> const NoiseLang::ModuleSpec*;
+			auto GetKinds() const -> const std::vector<NoiseLang::ModuleSpec>&;
+
+			// -1 when no module kind has a method of that name
+			auto FindMethod(std::string_view name) const -> int;
+			auto GetMethodName(int method) const -> const std::string&;
+	};
+
+	namespace Methods {
+
+		using ArgumentType = NoiseLang::ArgumentType;
+		using Module = noise::module::Module;
+		using Arguments = NoiseLang::MethodArguments;
+
+		template <typename T>
+		auto Create() -> std::shared_ptr<noise::module::Module> {
+			return std::make_shared<T>();
+		}
+
+		template <typename T>
+		auto As(noise::module::Module& module) -> T& {
+			return static_cast<T&>(module);
+		}
+
+		// libnoise asserts rather than checks the index, so out of range is reported like any bad parameter
+		inline auto SetSourceModule() -> NoiseLang::MethodSpec {
+			return {"SetSourceModule", {ArgumentType::Number, ArgumentType::Identifier}, [](Module& m, const Arguments& a){
+				int index = static_cast<int>(a.numbers[0]);
+				if (index < 0 || index >= m.GetSourceModuleCount())
+					throw noise::ExceptionInvalidParam();
+				m.SetSourceModule(index, *a.modules[1]);
+			}};
+		}
+
+		template <typename T>
+		auto SetFrequency() -> NoiseLang::MethodSpec {
+			return {"SetFrequency", {ArgumentType::Number}, [](Module& m, const Arguments& a){ As<T>(m).SetFrequency(a.numbers[0]); }};
+		}
+
+		template <typename T>
+		auto SetSeed() -> NoiseLang::MethodSpec {
+			return {"SetSeed", {ArgumentType::Number}, [](Module& m, const Arguments& a){ As<T>(m).SetSeed(static_cast<int>(a.numbers[0])); }};
+		}
+
+		// Perlin, Billow and RidgedMulti
+		template <typename T>
+		auto Fractal() -> std::vector<NoiseLang::MethodSpec> {
+			return {
+				SetFrequency<T>(),
+				{"SetLacunarity", {ArgumentType::Number}, [](Module& m, const Arguments& a){ As<T>(m).SetLacunarity(a.numbers[0]); }},
+				{"SetNoiseQuality", {ArgumentType::Number}, [](Module& m, const Arguments& a){
+					int quality = static_cast<int>(a.numbers[0]);
+					if (quality < noise::QUALITY_FAST || quality > noise::QUALITY_BEST)
+						throw noise::ExceptionInvalidParam();
+					As<T>(m).SetNoiseQuality(static_cast<noise::NoiseQuality>(quality));
+				}},
+				{"SetOctaveCount", {ArgumentType::Number}, [](Module& m, const Arguments& a){ As<T>(m).SetOctaveCount(static_cast<int>(a.numbers[0])); }},
+				SetSeed<T>(),
+			};
+		}
+
+		// RidgedMulti derives its persistence from the lacunarity, the other two take one
+		template <typename T>
+		auto PersistentFractal() -> std::vector<NoiseLang::MethodSpec> {
+			auto methods = Fractal<T>();
+			methods.push_back({"SetPersistence", {ArgumentType::Number}, [](Module& m, const Arguments& a){ As<T>(m).SetPersistence(a.numbers[0]); }});
+			return methods;
+		}
+
+	}
+
+}
+
+NoiseLang::Registry::Registry() {
+	using namespace noise::module;
+	using namespace NoiseLang::Methods;
+
+	const auto N = ArgumentType::Number;
+	const auto I = ArgumentType::Identifier;
+
+	// Kept in alphabetical order, FindKind searches it
+	this->Register("abs", 1, Create<Abs>, {SetSourceModule()});
+	this->Register("add", 2, Create<Add>, {SetSourceModule()});
+	this->Register("billow", 0, Create<Billow>, PersistentFractal<Billow>());
+	this->Register("blend", 3, Create<Blend>, {
+		SetSourceModule(),
+		{"SetControlModule", {I}, [](Module& m, const Arguments& a){ As<Blend>(m).SetControlModule(*a.modules[0]); }},
+	});
+	this->Register("cache", 1, Create<Cache>, {SetSourceModule()});
+	this->Register("checkerboard", 0, Create<Checkerboard>, {});
+	this->Register("clamp", 1, Create<Clamp>, {
+		SetSourceModule(),
+		{"SetBounds", {N, N}, [](Module& m, const Arguments& a){ As<Clamp>(m).SetBounds(a.numbers[0], a.numbers[1]); }},
+	});
+	this->Register("const", 0, Create<Const>, {
+		{"SetConstValue", {N}, [](Module& m, const Arguments& a){ As<Const>(m).SetConstValue(a.numbers[0]); }},
+	});
+	this->Register("curve", 1, Create<Curve>, {
+		SetSourceModule(),
+		{"AddControlPoint", {N, N}, [](Module& m, const Arguments& a){ As<Curve>(m).AddControlPoint(a.numbers[0], a.numbers[1]); }},
+		{"ClearAllControlPoints", {}, [](Module& m, const Arguments&){ As<Curve>(m).ClearAllControlPoints(); }},
+	});
+	this->Register("cylinders", 0, Create<Cylinders>, {SetFrequency<Cylinders>()});
+	this->Register("displace", 4, Create<Displace>, {
+		SetSourceModule(),
+		{"SetDisplaceModules", {I, I, I}, [](Module& m, const Arguments& a){ As<Displace>(m).SetDisplaceModules(*a.modules[0], *a.modules[1], *a.modules[2]); }},
+		{"SetXDisplaceModule", {I}, [](Module& m, const Arguments& a){ As<Displace>(m).SetXDisplaceModule(*a.modules[0]); }},
+		{"SetYDisplaceModule", {I}, [](Module& m, const Arguments& a){ As<Displace>(m).SetYDisplaceModule(*a.modules[0]); }},
+		{"SetZDisplaceModule", {I}, [](Module& m, const Arguments& a){ As<Displace>(m).SetZDisplaceModule(*a.modules[0]); }},
+	});
+	this->Register("exponent", 1, Create<Exponent>, {
+		SetSourceModule(),
+		{"SetExponent", {N}, [](Module& m, const Arguments& a){ As<Exponent>(m).SetExponent(a.numbers[0]); }},
+	});
+	this->Register("invert", 1, Create<Invert>, {SetSourceModule()});
+	this->Register("max", 2, Create<Max>, {SetSourceModule()});
+	this->Register("min", 2, Create<Min>, {SetSourceModule()});
+	this->Register("multiply", 2, Create<Multiply>, {SetSourceModule()});
+	this->Register("perlin", 0, Create<Perlin>, PersistentFractal<Perlin>());
+	this->Register("power", 2, Create<Power>, {SetSourceModule()});
+	this->Register("ridgedmulti", 0, Create<RidgedMulti>, Fractal<RidgedMulti>());
+	this->Register("rotatepoint", 1, Create<RotatePoint>, {
+		SetSourceModule(),
+		{"SetAngles", {N, N, N}, [](Module& m, const Arguments& a){ As<RotatePoint>(m).SetAngles(a.numbers[0], a.numbers[1], a.numbers[2]); }},
+		{"SetXAngle", {N}, [](Module& m, const Arguments& a){ As<RotatePoint>(m).SetXAngle(a.numbers[0]); }},
+		{"SetYAngle", {N}, [](Module& m, const Arguments& a){ As<RotatePoint>(m).SetYAngle(a.numbers[0]); }},
+		{"SetZAngle", {N}, [](Module& m, const Arguments& a){ As<RotatePoint>(m).SetZAngle(a.numbers[0]); }},
+	});
+	this->Register("scalebias", 1, Create<ScaleBias>, {
+		SetSourceModule(),
+		{"SetBias", {N}, [](Module& m, const Arguments& a){ As<ScaleBias>(m).SetBias(a.numbers[0]); }},
+		{"SetScale", {N}, [](Module& m, const Arguments& a){ As<ScaleBias>(m).SetScale(a.numbers[0]); }},
+	});
+	this->Register("scalepoint", 1, Create<ScalePoint>, {
+		SetSourceModule(),
+		{"SetScale", {N, N, N}, [](Module& m, const Arguments& a){ As<ScalePoint>(m).SetScale(a.numbers[0], a.numbers[1], a.numbers[2]); }},
+		{"SetXScale", {N}, [](Module& m, const Arguments& a){ As<ScalePoint>(m).SetXScale(a.numbers[0]); }},
+		{"SetYScale", {N}, [](Module& m, const Arguments& a){ As<ScalePoint>(m).SetYScale(a.numbers[0]); }},
+		{"SetZScale", {N}, [](Module& m, const Arguments& a){ As<ScalePoint>(m).SetZScale(a.numbers[0]); }},
+	});
+	this->Register("select", 3, Create<Select>, {
+		SetSourceModule(),
+		{"SetControlModule", {I}, [](Module& m, const Arguments& a){ As<Select>(m).SetControlModule(*a.modules[0]); }},
+		{"SetBounds", {N, N}, [](Module& m, const Arguments& a){ As<Select>(m).SetBounds(a.numbers[0], a.numbers[1]); }},
+		{"SetEdgeFalloff", {N}, [](Module& m, const Arguments& a){ As<Select>(m).SetEdgeFalloff(a.numbers[0]); }},
+	});
+	this->Register("spheres", 0, Create<Spheres>, {SetFrequency<Spheres>()});
+	this->Register("terrace", 1, Create<Terrace>, {
+		SetSourceModule(),
+		{"InvertTerraces", {}, [](Module& m, const Arguments&){ As<Terrace>(m).InvertTerraces(!As<Terrace>(m).IsTerracesInverted()); }},
+		{"MakeControlPoints", {N}, [](Module& m, const Arguments& a){ As<Terrace>(m).MakeControlPoints(static_cast<int>(a.numbers[0])); }},
+		{"AddControlPoint", {N}, [](Module& m, const Arguments& a){ As<Terrace>(m).AddControlPoint(a.numbers[0]); }},
+		{"ClearAllControlPoints", {}, [](Module& m, const Arguments&){ As<Terrace>(m).ClearAllControlPoints(); }},
+	});
+	this->Register("translatepoint", 1, Create<TranslatePoint>, {
+		SetSourceModule(),
+		{"SetTranslation", {N, N, N}, [](Module& m, const Arguments& a){ As<TranslatePoint>(m).SetTranslation(a.numbers[0], a.numbers[1], a.numbers[2]); }},
+		{"SetXTranslation", {N}, [](Module& m, const Arguments& a){ As<TranslatePoint>(m).SetXTranslation(a.numbers[0]); }},
+		{"SetYTranslation", {N}, [](Module& m, const Arguments& a){ As<TranslatePoint>(m).SetYTranslation(a.numbers[0]); }},
+		{"SetZTranslation", {N}, [](Module& m, const Arguments& a){ As<TranslatePoint>(m).SetZTranslation(a.numbers[0]); }},
+	});
+	this->Register("turbulence", 1, Create<Turbulence>, {
+		SetSourceModule(),
+		SetFrequency<Turbulence>(),
+		{"SetPower", {N}, [](Module& m, const Arguments& a){ As<Turbulence>(m).SetPower(a.numbers[0]); }},
+		{"SetRoughness", {N}, [](Module& m, const Arguments& a){ As<Turbulence>(m).SetRoughness(static_cast<int>(a.numbers[0])); }},
+		SetSeed<Turbulence>(),
+	});
+	this->Register("voronoi", 0, Create<Voronoi>, {
+		{"EnableDistance", {}, [](Module& m, const Arguments&){ As<Voronoi>(m).EnableDistance(true); }},
+		{"DisableDistance", {}, [](Module& m, const Arguments&){ As<Voronoi>(m).EnableDistance(false); }},
+		SetFrequency<Voronoi>(),
+		{"SetDisplacement", {N}, [](Module& m, const Arguments& a){ As<Voronoi>(m).SetDisplacement(a.numbers[0]); }},
+		SetSeed<Voronoi>(),
+	});
+
+	// Every method name gets an id, then each kind gets a table from id to its spec
+	for (auto& kind : this->kinds)
+		for (auto& method : kind.methods)
+			this->methodNames.push_back(method.name);
+	std::sort(this->methodNames.begin(), this->methodNames.end());
+	this->methodNames.erase(std::unique(this->methodNames.begin(), this->methodNames.end()), this->methodNames.end());
+
+	for (auto& kind : this->kinds){
+		kind.dispatch.assign(this->methodNames.size(), nullptr);
+		for (auto& method : kind.methods)
+			kind.dispatch[this->FindMethod(method.name)] = &method;
+	}
+}
+
+auto NoiseLang::Registry::Register(const std::string& name, unsigned int sourceCount, std::shared_ptr<noise::module::Module> (*create)(), std::vector<NoiseLang::MethodSpec> methods) -> void {
+	auto kind = NoiseLang::ModuleSpec();
+	kind.name = name;
+	kind.sourceCount = sourceCount;
+	kind.create = create;
+	kind.methods = std::move(methods);
+	this->kinds.push_back(std::move(kind));
+}
+
+auto NoiseLang::Registry::Get() -> const NoiseLang::Registry& {
+	static const NoiseLang::Registry registry;
+	return registry;
+}
+
+auto NoiseLang::Registry::FindKind(std::string_view name) const -> const NoiseLang::ModuleSpec* {
+	auto it = std::lower_bound(this->kinds.begin(), this->kinds.end(), name, [](const NoiseLang::ModuleSpec& kind, std::string_view name){ return kind.name < name; });
+	return it != this->kinds.end() && it->name == name ? &*it : nullptr;
+}
+
+auto NoiseLang::Registry::GetKinds() const -> const std::vector<NoiseLang::ModuleSpec>& {
+	return this->kinds;
+}
+
+auto NoiseLang::Registry::FindMethod(std::string_view name) const -> int {
+	auto it = std::lower_bound(this->methodNames.begin(), this->methodNames.end(), name);
+	return it != this->methodNames.end() && *it == name ? static_cast<int>(it - this->methodNames.begin()) : -1;
+}
+
+auto NoiseLang::Registry::GetMethodName(int method) const -> const std::string& {
+	return this->methodNames[method];
+}
@@ -0,0 +1,411 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "vendor/include/noise/noise.h"
+
+#include "NoiseLangBlock.hpp"
+
+// The AVX2 and SSE4.1 builds of the float32 kernels are compiled alongside the baseline one with
+// target attributes, and picked at runtime. Elsewhere only the baseline build exists.
+#if defined(__x86_64__) || defined(__i386__)
+#define NOISELANG_SIMD_X86
+#endif
+
+namespace NoiseLang {
+
+	// Instruction sets the float32 kernels are built for. Baseline is the same code built for
+	// whatever the compiler targets by default (SSE2 on x86-64, NEON on arm64).
+	enum class SimdLevel {Baseline, SSE41, AVX2};
+
+	class Simd {
+		private:
+			static auto Selected() -> std::atomic<int>&;
+
+		public:
+			// The best level this CPU runs, detected once
+			static auto GetSupported() -> NoiseLang::SimdLevel;
+			static auto Get() -> NoiseLang::SimdLevel;
+			// Anything above what the CPU runs is capped to it, returns the level now in use
+			static auto Set(NoiseLang::SimdLevel level) -> NoiseLang::SimdLevel;
+
+			static auto GetName(NoiseLang::SimdLevel level) -> std::string;
+			// float lanes per instruction
+			static auto GetLanes(NoiseLang::SimdLevel level) -> int;
+	};
+
+	namespace Kernels {
+
+		// {{{ Single precision
+		// float32 versions of the fractal generators, for programs compiled with Precision::Single.
+		// Each octave's coordinates are still scaled and split into lattice cells in double, so a
+		// sample lands in the same cell with the same gradients as in the double kernels however far
+		// out it is. Only the fractions, curves, gradients and octave sums are float, with twice the
+		// lanes per instruction of the double kernels.
+		namespace Single {
+
+			// The most a float32 sample may differ from the double kernel's. `make bench-precision`
+			// checks it at every supported level, for every quality, 1 to 16 octaves and 64 seeds, on
+			// points near the origin and beyond 10^6. The worst seen there is 4.8e-6 (ridgedmulti, the
+			// mean is under 2e-7), and all of it is under half a step of the 16-bit heightmaps that
+			// `tiles ... u16` writes.
+			const double MaxError = 1.5e-5;
+
+			auto Perlin(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, double persistence, int octaves, int seed, noise::NoiseQuality quality, double fade = 1.0) -> void;
+			auto Billow(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, double persistence, int octaves, int seed, noise::NoiseQuality quality, double fade = 1.0) -> void;
+			auto RidgedMulti(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, int octaves, int seed, noise::NoiseQuality quality, const double* spectralWeights, double fade = 1.0) -> void;
+
+			enum class Fractal {Perlin, Billow, RidgedMulti};
+
+			class Params {
+				public:
+					double frequency, lacunarity, persistence;
+					int octaves, seed;
+					noise::NoiseQuality quality;
+					const double* spectralWeights;
+					double fade;
+			};
+
+			// Vector types per lane count, with GCC/Clang vector extensions so one body builds for every level
+			template <int N> class Lanes;
+
+			template <> class Lanes<4> {
+				public:
+					typedef float F __attribute__((vector_size(16)));
+					typedef double D __attribute__((vector_size(32)));
+					typedef std::int32_t I __attribute__((vector_size(16)));
+					typedef std::uint32_t U __attribute__((vector_size(16)));
+					typedef std::int64_t L __attribute__((vector_size(32)));
+			};
+
+			template <> class Lanes<8> {
+				public:
+					typedef float F __attribute__((vector_size(32)));
+					typedef double D __attribute__((vector_size(64)));
+					typedef std::int32_t I __attribute__((vector_size(32)));
+					typedef std::uint32_t U __attribute__((vector_size(32)));
+					typedef std::int64_t L __attribute__((vector_size(64)));
+			};
+
+			// libnoise's gradient table as floats
+			auto GetGradients() -> const float*;
+
+		}
+		// }}}
+
+	}
+
+}
+
+// {{{ Level selection
+auto NoiseLang::Simd::Selected() -> std::atomic<int>& {
+	static std::atomic<int> selected(static_cast<int>(NoiseLang::Simd::GetSupported()));
+	return selected;
+}
+
+auto NoiseLang::Simd::GetSupported() -> NoiseLang::SimdLevel {
+#ifdef NOISELANG_SIMD_X86
+	static const NoiseLang::SimdLevel supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? NoiseLang::SimdLevel::AVX2
+		: __builtin_cpu_supports("sse4.1") ? NoiseLang::SimdLevel::SSE41 : NoiseLang::SimdLevel::Baseline;
+	return supported;
+#else
+	return NoiseLang::SimdLevel::Baseline;
+#endif
+}
+
+auto NoiseLang::Simd::Get() -> NoiseLang::SimdLevel {
+	return static_cast<NoiseLang::SimdLevel>(NoiseLang::Simd::Selected().load(std::memory_order_relaxed));
+}
+
+auto NoiseLang::Simd::Set(NoiseLang::SimdLevel level) -> NoiseLang::SimdLevel {
+	level = std::min(level, NoiseLang::Simd::GetSupported());
+	NoiseLang::Simd::Selected() = static_cast<int>(level);
+	return level;
+}
+
+auto NoiseLang::Simd::GetName(NoiseLang::SimdLevel level) -> std::string {
+	switch (level){
+		case NoiseLang::SimdLevel::AVX2: return "AVX2";
+		case NoiseLang::SimdLevel::SSE41: return "SSE4.1";
+		default: return "baseline";
+	}
+}
+
+auto NoiseLang::Simd::GetLanes(NoiseLang::SimdLevel level) -> int {
+	return level == NoiseLang::SimdLevel::AVX2 ? 8 : 4;
+}
+// }}}
+
+// {{{ Kernels
+auto NoiseLang::Kernels::Single::GetGradients() -> const float* {
+	static const auto gradients = []{
+		alignas(16) static float table[256 * 4];
+		for (int i = 0; i < 256 * 4; i++)
+			table[i] = static_cast<float>(noise::g_randomVectors[i]);
+		return table;
+	}();
+	return gradients;
+}
+
+namespace NoiseLang {
+	namespace Kernels {
+		namespace Single {
+
+			// Everything below is always inlined into the per level entry points, which is what
+			// builds it for their instruction set. Vectors are taken and handed back by reference
+			// rather than by value: GCC warns that an 8 lane one crossing a call without AVX changes
+			// the ABI, even though none ever does, and gives the warning at the end of the
+			// translation unit, where no pragma around this code would still turn it off.
+#define NOISELANG_SIMD_INLINE inline __attribute__((always_inline))
+
+			// `a` where `mask` is set, `b` elsewhere, into `out`
+			template <typename V>
+			NOISELANG_SIMD_INLINE auto Select(const typename Lanes<sizeof(V) / 4>::I& mask, const V& a, const V& b, V& out) -> void {
+				typedef typename Lanes<sizeof(V) / 4>::I I;
+				out = reinterpret_cast<V>((reinterpret_cast<I>(a) & mask) | (reinterpret_cast<I>(b) & ~mask));
+			}
+
+			template <int N>
+			NOISELANG_SIMD_INLINE auto Abs(const typename Lanes<N>::F& a, typename Lanes<N>::F& out) -> void {
+				typedef typename Lanes<N>::U U;
+				out = reinterpret_cast<typename Lanes<N>::F>(reinterpret_cast<U>(a) & 0x7fffffffu);
+			}
+
+			// libnoise's LinearInterp, in the same order of operations
+			template <int N>
+			NOISELANG_SIMD_INLINE auto Lerp(const typename Lanes<N>::F& n0, const typename Lanes<N>::F& n1, const typename Lanes<N>::F& a, typename Lanes<N>::F& out) -> void {
+				out = ((1.0f - a) * n0) + (a * n1);
+			}
+
+			// Each lane's gradient is one aligned 16 byte row of the table, so rather than gathering
+			// x, y and z one lane at a time the rows are loaded whole and transposed
+			template <int N>
+			class Gradients;
+
+			template <>
+			class Gradients<4> {
+				public:
+					NOISELANG_SIMD_INLINE static auto Load(const Lanes<4>::U& index, const float* table, Lanes<4>::F& gx, Lanes<4>::F& gy, Lanes<4>::F& gz) -> void {
+						typedef Lanes<4>::F F;
+						F g0, g1, g2, g3;
+						std::memcpy(&g0, &table[index[0]], sizeof(F));
+						std::memcpy(&g1, &table[index[1]], sizeof(F));
+						std::memcpy(&g2, &table[index[2]], sizeof(F));
+						std::memcpy(&g3, &table[index[3]], sizeof(F));
+						F t0 = __builtin_shufflevector(g0, g1, 0, 4, 1, 5);
+						F t1 = __builtin_shufflevector(g2, g3, 0, 4, 1, 5);
+						F t2 = __builtin_shufflevector(g0, g1, 2, 6, 3, 7);
+						F t3 = __builtin_shufflevector(g2, g3, 2, 6, 3, 7);
+						gx = __builtin_shufflevector(t0, t1, 0, 1, 4, 5);
+						gy = __builtin_shufflevector(t0, t1, 2, 3, 6, 7);
+						gz = __builtin_shufflevector(t2, t3, 0, 1, 4, 5);
+					}
+			};
+
+			template <>
+			class Gradients<8> {
+				public:
+					NOISELANG_SIMD_INLINE static auto Load(const Lanes<8>::U& index, const float* table, Lanes<8>::F& gx, Lanes<8>::F& gy, Lanes<8>::F& gz) -> void {
+						Lanes<4>::F lx, ly, lz, hx, hy, hz;
+						Gradients<4>::Load(__builtin_shufflevector(index, index, 0, 1, 2, 3), table, lx, ly, lz);
+						Gradients<4>::Load(__builtin_shufflevector(index, index, 4, 5, 6, 7), table, hx, hy, hz);
+						gx = __builtin_shufflevector(lx, hx, 0, 1, 2, 3, 4, 5, 6, 7);
+						gy = __builtin_shufflevector(ly, hy, 0, 1, 2, 3, 4, 5, 6, 7);
+						gz = __builtin_shufflevector(lz, hz, 0, 1, 2, 3, 4, 5, 6, 7);
+					}
+			};
+
+			// One corner's gradient dotted with the offset to it, GradientNoise3D() with the hash already mixed
+			template <int N>
+			NOISELANG_SIMD_INLINE auto Corner(const typename Lanes<N>::U& hash, const typename Lanes<N>::F& dx, const typename Lanes<N>::F& dy, const typename Lanes<N>::F& dz, const float* gradients, typename Lanes<N>::F& out) -> void {
+				typename Lanes<N>::F gx, gy, gz;
+				Gradients<N>::Load(((hash ^ (hash >> 8)) & 0xffu) << 2, gradients, gx, gy, gz);
+				out = ((gx * dx) + (gy * dy) + (gz * dz)) * 2.12f;
+			}
+
+			template <int N>
+			NOISELANG_SIMD_INLINE auto Coherent(const typename Lanes<N>::D& x, const typename Lanes<N>::D& y, const typename Lanes<N>::D& z, int seed, noise::NoiseQuality quality, const float* gradients, typename Lanes<N>::F& out) -> void {
+				typedef typename Lanes<N>::F F;
+				typedef typename Lanes<N>::D D;
+				typedef typename Lanes<N>::I I;
+				typedef typename Lanes<N>::U U;
+
+				// (x > 0.0 ? (int)x : (int)x - 1). The sign is tested on the float copy, a compare of doubles
+				// is wider than the registers at 8 lanes and the compilers fall back to one lane at a time.
+				// Only a positive x under 1e-45 tests differently, and at the edge of a cell the noise is
+				// the same from either side.
+				I x0 = __builtin_convertvector(x, I) + (__builtin_convertvector(x, F) <= 0.0f);
+				I y0 = __builtin_convertvector(y, I) + (__builtin_convertvector(y, F) <= 0.0f);
+				I z0 = __builtin_convertvector(z, I) + (__builtin_convertvector(z, F) <= 0.0f);
+
+				// The fractions are exact in double and at most 1, so float loses nothing that matters
+				F fx = __builtin_convertvector(x - __builtin_convertvector(x0, D), F);
+				F fy = __builtin_convertvector(y - __builtin_convertvector(y0, D), F);
+				F fz = __builtin_convertvector(z - __builtin_convertvector(z0, D), F);
+
+				F xs = fx, ys = fy, zs = fz;
+				if (quality == noise::QUALITY_STD){
+					xs = fx * fx * (3.0f - 2.0f * fx);
+					ys = fy * fy * (3.0f - 2.0f * fy);
+					zs = fz * fz * (3.0f - 2.0f * fz);
+				} else if (quality == noise::QUALITY_BEST){
+					xs = fx * fx * fx * (fx * (fx * 6.0f - 15.0f) + 10.0f);
+					ys = fy * fy * fy * (fy * (fy * 6.0f - 15.0f) + 10.0f);
+					zs = fz * fz * fz * (fz * (fz * 6.0f - 15.0f) + 10.0f);
+				}
+
+				// The corners' hashes only differ by a constant, the same wrapping arithmetic as GradientNoise3D()
+				U h = 1619u * reinterpret_cast<U>(x0) + 31337u * reinterpret_cast<U>(y0) + 6971u * reinterpret_cast<U>(z0) + 1013u * static_cast<std::uint32_t>(seed);
+				F gx = fx - 1.0f, gy = fy - 1.0f, gz = fz - 1.0f;
+
+				F n0, n1, ix0, ix1, iy0, iy1;
+				Corner<N>(h, fx, fy, fz, gradients, n0);
+				Corner<N>(h + 1619u, gx, fy, fz, gradients, n1);
+				Lerp<N>(n0, n1, xs, ix0);
+				Corner<N>(h + 31337u, fx, gy, fz, gradients, n0);
+				Corner<N>(h + 1619u + 31337u, gx, gy, fz, gradients, n1);
+				Lerp<N>(n0, n1, xs, ix1);
+				Lerp<N>(ix0, ix1, ys, iy0);
+				Corner<N>(h + 6971u, fx, fy, gz, gradients, n0);
+				Corner<N>(h + 1619u + 6971u, gx, fy, gz, gradients, n1);
+				Lerp<N>(n0, n1, xs, ix0);
+				Corner<N>(h + 31337u + 6971u, fx, gy, gz, gradients, n0);
+				Corner<N>(h + 1619u + 31337u + 6971u, gx, gy, gz, gradients, n1);
+				Lerp<N>(n0, n1, xs, ix1);
+				Lerp<N>(ix0, ix1, ys, iy1);
+
+				Lerp<N>(iy0, iy1, zs, out);
+			}
+
+			template <int N, Fractal kind>
+			NOISELANG_SIMD_INLINE auto Octaves(const double* x, const double* y, const double* z, double* out, size_t count, const Params& p, const float* gradients) -> void {
+				typedef typename Lanes<N>::F F;
+				typedef typename Lanes<N>::D D;
+
+				// MakeInt32Range() only does anything beyond 2^30, which most blocks never get near
+				double reach = 0.0;
+				for (size_t i = 0; i < count; i++)
+					reach = std::max({reach, std::fabs(x[i]), std::fabs(y[i]), std::fabs(z[i])});
+				reach *= std::fabs(p.frequency);
+
+				for (size_t i = 0; i < count; i += N){
+					size_t n = std::min<size_t>(N, count - i);
+
+					D px, py, pz;
+					for (int k = 0; k < N; k++){
+						size_t j = i + std::min<size_t>(static_cast<size_t>(k), n - 1);
+						px[k] = x[j] * p.frequency;
+						py[k] = y[j] * p.frequency;
+						pz[k] = z[j] * p.frequency;
+					}
+
+					F value = F{} + 0.0f;
+					F weight = F{} + 1.0f;
+					float persistence = 1.0f;
+					double bound = reach;
+
+					for (int octave = 0; octave < p.octaves; octave++){
+						D nx = px, ny = py, nz = pz;
+						if (bound >= 1073741824.0){
+							for (int k = 0; k < N; k++){
+								nx[k] = noise::MakeInt32Range(nx[k]);
+								ny[k] = noise::MakeInt32Range(ny[k]);
+								nz[k] = noise::MakeInt32Range(nz[k]);
+							}
+						}
+
+						int octaveSeed = (p.seed + octave) & (kind == Fractal::RidgedMulti ? 0x7fffffff : 0xffffffff);
+						F signal, magnitude;
+						Coherent<N>(nx, ny, nz, octaveSeed, p.quality, gradients, signal);
+
+						if (kind == Fractal::RidgedMulti){
+							Abs<N>(signal, magnitude);
+							signal = 1.0f - magnitude;
+							signal *= signal;
+							signal *= weight;
+
+							weight = signal * 2.0f;
+							Select<F>(weight > 1.0f, F{} + 1.0f, weight, weight);
+							Select<F>(weight < 0.0f, F{} + 0.0f, weight, weight);
+
+							value += signal * static_cast<float>(octave == p.octaves - 1 ? p.spectralWeights[octave] * p.fade : p.spectralWeights[octave]);
+						} else {
+							if (kind == Fractal::Billow){
+								Abs<N>(signal, magnitude);
+								signal = 2.0f * magnitude - 1.0f;
+							}
+							value += signal * (octave == p.octaves - 1 ? persistence * static_cast<float>(p.fade) : persistence);
+							persistence *= static_cast<float>(p.persistence);
+						}
+
+						px *= p.lacunarity;
+						py *= p.lacunarity;
+						pz *= p.lacunarity;
+						bound *= std::fabs(p.lacunarity);
+					}
+
+					if (kind == Fractal::Billow)
+						value += 0.5f;
+					if (kind == Fractal::RidgedMulti)
+						value = (value * 1.25f) - 1.0f;
+
+					for (size_t k = 0; k < n; k++)
+						out[i + k] = static_cast<double>(value[k]);
+				}
+			}
+
+#undef NOISELANG_SIMD_INLINE
+
+			// {{{ Per level entry points
+#ifdef NOISELANG_SIMD_X86
+			template <Fractal kind>
+			__attribute__((target("avx2,fma"))) auto RunAVX2(const double* x, const double* y, const double* z, double* out, size_t count, const Params& p, const float* gradients) -> void {
+				Octaves<8, kind>(x, y, z, out, count, p, gradients);
+			}
+
+			template <Fractal kind>
+			__attribute__((target("sse4.1"))) auto RunSSE41(const double* x, const double* y, const double* z, double* out, size_t count, const Params& p, const float* gradients) -> void {
+				Octaves<4, kind>(x, y, z, out, count, p, gradients);
+			}
+#endif
+
+			template <Fractal kind>
+			auto RunBaseline(const double* x, const double* y, const double* z, double* out, size_t count, const Params& p, const float* gradients) -> void {
+				Octaves<4, kind>(x, y, z, out, count, p, gradients);
+			}
+
+			template <Fractal kind>
+			auto Run(const double* x, const double* y, const double* z, double* out, size_t count, const Params& p) -> void {
+				const float* gradients = GetGradients();
+				switch (NoiseLang::Simd::Get()){
+#ifdef NOISELANG_SIMD_X86
+					case NoiseLang::SimdLevel::AVX2: RunAVX2<kind>(x, y, z, out, count, p, gradients); break;
+					case NoiseLang::SimdLevel::SSE41: RunSSE41<kind>(x, y, z, out, count, p, gradients); break;
+#endif
+					default: RunBaseline<kind>(x, y, z, out, count, p, gradients); break;
+				}
+			}
+			// }}}
+
+		}
+	}
+}
+
+auto NoiseLang::Kernels::Single::Perlin(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, double persistence, int octaves, int seed, noise::NoiseQuality quality, double fade) -> void {
+	Run<Fractal::Perlin>(x, y, z, out, count, {frequency, lacunarity, persistence, octaves, seed, quality, nullptr, fade});
+}
+
+auto NoiseLang::Kernels::Single::Billow(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, double persistence, int octaves, int seed, noise::NoiseQuality quality, double fade) -> void {
+	Run<Fractal::Billow>(x, y, z, out, count, {frequency, lacunarity, persistence, octaves, seed, quality, nullptr, fade});
+}
+
+auto NoiseLang::Kernels::Single::RidgedMulti(const double* x, const double* y, const double* z, double* out, size_t count, double frequency, double lacunarity, int octaves, int seed, noise::NoiseQuality quality, const double* spectralWeights, double fade) -> void {
+	Run<Fractal::RidgedMulti>(x, y, z, out, count, {frequency, lacunarity, 1.0, octaves, seed, quality, spectralWeights, fade});
+}
+// }}}
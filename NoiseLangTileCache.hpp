@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "NoiseLangProgram.hpp"
+
+namespace NoiseLang {
+
+	// Identifies an evaluated tile: which program, which rectangle of the world and which z-slice
+	class TileKey {
+		public:
+			std::uint64_t program;
+			double x0, x1, y0, y1, z;
+			std::uint32_t width, height;
+
+			// Programs are keyed by their hash, so an edit that changes nothing still hits and any
+			// real change misses. Modules the compiler couldn't lower read their parameters from the
+			// live graph, so those programs are keyed by identity instead; every edit compiles a new one.
+			static auto GetProgramKey(const NoiseLang::Program& program) -> std::uint64_t;
+
+			auto operator==(const NoiseLang::TileKey& other) const -> bool;
+	};
+
+	class TileKeyHash {
+		public:
+			auto operator()(const NoiseLang::TileKey& key) const -> size_t;
+	};
+
+	class TileCacheStats {
+		public:
+			size_t hits, misses, evictions;
+			size_t tiles, bytes, capacity;
+	};
+
+	// A bounded LRU of tiles of samples, shared by every worker. Tiles are handed out as shared
+	// pointers, so an eviction never pulls a tile out from under the worker reading it.
+	template <typename Sample>
+	class BasicTileCache {
+		public:
+			using Tile = std::shared_ptr<const std::vector<Sample>>;
+
+			static const size_t DefaultCapacity = 64 * 1024 * 1024;
+
+		private:
+			class Entry {
+				public:
+					NoiseLang::TileKey key;
+					Tile tile;
+					// Keeps a program keyed by identity alive, so its address can't be reused by another
+					std::shared_ptr<const NoiseLang::Program> program;
+			};
+
+			std::mutex mutex;
+			std::list<Entry> entries;
+			std::unordered_map<NoiseLang::TileKey, typename std::list<Entry>::iterator, NoiseLang::TileKeyHash> index;
+			size_t capacity;
+			size_t bytes;
+			size_t hits, misses, evictions;
+
+			auto Evict() -> void;
+
+		public:
+			BasicTileCache(size_t capacity = DefaultCapacity);
+
+			// nullptr on a miss
+			auto Find(const NoiseLang::TileKey& key) -> Tile;
+			// `program` may be nullptr when the key doesn't name a program by identity
+			auto Insert(const NoiseLang::TileKey& key, std::vector<Sample> values, std::shared_ptr<const NoiseLang::Program> program = nullptr) -> void;
+
+			// A capacity of 0 turns the cache off
+			auto SetCapacity(size_t capacity) -> void;
+			auto GetCapacity() -> size_t;
+			auto Clear() -> void;
+			auto GetStats() -> NoiseLang::TileCacheStats;
+	};
+
+	// Finished tiles for the viewer
+	using TileCache = BasicTileCache<float>;
+
+	// Per instruction outputs for the viewer's tiles, keyed by node hash rather than program,
+	// so instructions an edit didn't touch are read back instead of evaluated again
+	using NodeCache = BasicTileCache<double>;
+
+}
+
+auto NoiseLang::TileKey::GetProgramKey(const NoiseLang::Program& program) -> std::uint64_t {
+	if (program.externals.empty())
+		return program.GetHash();
+	return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(&program));
+}
+
+auto NoiseLang::TileKey::operator==(const NoiseLang::TileKey& other) const -> bool {
+	return this->program == other.program && this->x0 == other.x0 && this->x1 == other.x1 && this->y0 == other.y0 && this->y1 == other.y1 && this->z == other.z && this->width == other.width && this->height == other.height;
+}
+
+auto NoiseLang::TileKeyHash::operator()(const NoiseLang::TileKey& key) const -> size_t {
+	std::uint64_t hash = key.program;
+	auto mix = [&hash](double value){
+		std::uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		hash = (hash ^ bits) * 1099511628211ull;
+		hash ^= hash >> 29;
+	};
+	mix(key.x0);
+	mix(key.x1);
+	mix(key.y0);
+	mix(key.y1);
+	mix(key.z);
+	hash = (hash ^ (static_cast<std::uint64_t>(key.width) << 32 | key.height)) * 1099511628211ull;
+	return static_cast<size_t>(hash ^ (hash >> 32));
+}
+
+template <typename Sample>
+NoiseLang::BasicTileCache<Sample>::BasicTileCache(size_t capacity) {
+	this->capacity = capacity;
+	this->bytes = 0;
+	this->hits = 0;
+	this->misses = 0;
+	this->evictions = 0;
+}
+
+template <typename Sample>
+auto NoiseLang::BasicTileCache<Sample>::Find(const NoiseLang::TileKey& key) -> typename NoiseLang::BasicTileCache<Sample>::Tile {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (this->capacity == 0)
+		return nullptr;
+
+	auto it = this->index.find(key);
+	if (it == this->index.end()){
+		this->misses++;
+		return nullptr;
+	}
+
+	// Most recently used at the front
+	this->entries.splice(this->entries.begin(), this->entries, it->second);
+	this->hits++;
+	return it->second->tile;
+}
+
+template <typename Sample>
+auto NoiseLang::BasicTileCache<Sample>::Insert(const NoiseLang::TileKey& key, std::vector<Sample> values, std::shared_ptr<const NoiseLang::Program> program) -> void {
+	size_t size = values.size() * sizeof(Sample);
+
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (size > this->capacity || this->index.count(key) > 0)
+		return;
+
+	auto entry = Entry();
+	entry.key = key;
+	entry.tile = std::make_shared<const std::vector<Sample>>(std::move(values));
+	if (program != nullptr && !program->externals.empty())
+		entry.program = std::move(program);
+
+	this->entries.push_front(std::move(entry));
+	this->index[key] = this->entries.begin();
+	this->bytes += size;
+	this->Evict();
+}
+
+template <typename Sample>
+auto NoiseLang::BasicTileCache<Sample>::Evict() -> void {
+	while (this->bytes > this->capacity && !this->entries.empty()){
+		auto& last = this->entries.back();
+		this->bytes -= last.tile->size() * sizeof(Sample);
+		this->index.erase(last.key);
+		this->entries.pop_back();
+		this->evictions++;
+	}
+}
+
+template <typename Sample>
+auto NoiseLang::BasicTileCache<Sample>::SetCapacity(size_t capacity) -> void {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->capacity = capacity;
+	this->Evict();
+}
+
+template <typename Sample>
+auto NoiseLang::BasicTileCache<Sample>::GetCapacity() -> size_t {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return this->capacity;
+}
+
+template <typename Sample>
+auto NoiseLang::BasicTileCache<Sample>::Clear() -> void {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->entries.clear();
+	this->index.clear();
+	this->bytes = 0;
+}
+
+template <typename Sample>
+auto NoiseLang::BasicTileCache<Sample>::GetStats() -> NoiseLang::TileCacheStats {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	return {this->hits, this->misses, this->evictions, this->entries.size(), this->bytes, this->capacity};
+}
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace NoiseLang {
+
+	// A tiled heightmap file, little-endian throughout:
+	//
+	//   offset 0                 TileFileHeader
+	//   header.indexOffset       TileIndexEntry per tile, row-major from the top left tile
+	//   header.dataOffset        the tiles, each header.tileBytes long and page aligned
+	//
+	// Every tile is tileSize x tileSize samples, row-major; tiles on the right and bottom edges
+	// are padded out to full size. Samples are float32 or uint16 mapping 0..65535 onto
+	// [minValue, maxValue]. Tile offsets are multiples of the page size, so a reader can mmap
+	// the file and use a tile in place.
+	enum class TileFormat : std::uint32_t {Float32 = 0, UInt16 = 1};
+
+	class TileFileHeader {
+		public:
+			char magic[8];
+			std::uint32_t version;
+			NoiseLang::TileFormat format;
+			std::uint32_t width, height;
+			std::uint32_t tileSize;
+			std::uint32_t tilesX, tilesY;
+			std::uint32_t tileBytes;
+			double minValue, maxValue;
+			// x0 x1 y0 y1 of the region sampled, for tools that place tiles in the world
+			double bounds[4];
+			std::uint64_t indexOffset;
+			std::uint64_t dataOffset;
+	};
+
+	class TileIndexEntry {
+		public:
+			std::uint64_t offset;
+			std::uint32_t bytes;
+			// 0 until the tile's samples are on disk, a reader can tell an unfinished file apart
+			std::uint32_t written;
+	};
+
+	static_assert(sizeof(TileFileHeader) == 104, "the tile file header is a fixed on-disk layout");
+	static_assert(sizeof(TileIndexEntry) == 16, "the tile index is a fixed on-disk layout");
+
+	// Lays a file out up front, then takes tiles from any number of threads at once. Each tile
+	// is its own pwrite to its own offset, so writers never wait on each other.
+	class TileWriter {
+		public:
+			static const std::uint32_t Version = 1;
+			static const std::uint32_t PageSize = 4096;
+			static const std::uint32_t DefaultTileSize = 256;
+
+		private:
+			int file;
+			NoiseLang::TileFileHeader header;
+
+			static auto WriteAt(int file, const void* data, size_t size, size_t offset) -> bool;
+
+		public:
+			TileWriter();
+			~TileWriter();
+
+			auto Open(const std::string& filename, unsigned int width, unsigned int height, unsigned int tileSize, NoiseLang::TileFormat format, double minValue, double maxValue, const double bounds[4]) -> bool;
+
+			// `samples` is a full tileSize x tileSize tile, converted to the file's format here.
+			// Returns how many samples fell outside [minValue, maxValue] and were clamped (UInt16 only).
+			auto WriteTile(unsigned int tileX, unsigned int tileY, const float* samples, bool& ok) -> size_t;
+
+			// Flushes the file to disk
+			auto Close() -> bool;
+
+			auto GetHeader() const -> const NoiseLang::TileFileHeader&;
+			auto GetFileSize() const -> size_t;
+	};
+
+	// Maps a tile file read-only; tiles are handed out as pointers into the mapping
+	class TileReader {
+		private:
+			const unsigned char* data;
+			size_t size;
+			std::string error;
+
+			auto Fail(const std::string& message) -> bool;
+
+		public:
+			TileReader();
+			~TileReader();
+
+			auto Open(const std::string& filename) -> bool;
+			auto Close() -> void;
+			auto GetError() -> std::string;
+
+			auto GetHeader() const -> const NoiseLang::TileFileHeader&;
+			// `tileX` and `tileY` must be inside the header's tile grid
+			auto GetEntry(unsigned int tileX, unsigned int tileY) const -> const NoiseLang::TileIndexEntry&;
+
+			// The tile's samples in place, nullptr if it was never written or is outside the grid.
+			// Cast to const float* or const std::uint16_t* by the header's format.
+			auto GetTile(unsigned int tileX, unsigned int tileY) const -> const void*;
+
+			// One sample decoded to a float, for spot checks rather than bulk reads. 0 outside the
+			// map and in tiles never written.
+			auto GetValue(unsigned int x, unsigned int y) const -> float;
+	};
+
+}
+
+// {{{ TileWriter
+NoiseLang::TileWriter::TileWriter() {
+	this->file = -1;
+	std::memset(&this->header, 0, sizeof(this->header));
+}
+
+NoiseLang::TileWriter::~TileWriter() {
+	this->Close();
+}
+
+auto NoiseLang::TileWriter::WriteAt(int file, const void* data, size_t size, size_t offset) -> bool {
+	auto bytes = static_cast<const char*>(data);
+	while (size > 0){
+		ssize_t written = pwrite(file, bytes, size, static_cast<off_t>(offset));
+		if (written <= 0)
+			return false;
+		bytes += written;
+		offset += static_cast<size_t>(written);
+		size -= static_cast<size_t>(written);
+	}
+	return true;
+}
+
+auto NoiseLang::TileWriter::Open(const std::string& filename, unsigned int width, unsigned int height, unsigned int tileSize, NoiseLang::TileFormat format, double minValue, double maxValue, const double bounds[4]) -> bool {
+	auto align = [](std::uint64_t size){ return (size + PageSize - 1) / PageSize * PageSize; };
+
+	auto& h = this->header;
+	std::memcpy(h.magic, "NLTILES\0", 8);
+	h.version = Version;
+	h.format = format;
+	h.width = width;
+	h.height = height;
+	h.tileSize = tileSize;
+	h.tilesX = (width + tileSize - 1) / tileSize;
+	h.tilesY = (height + tileSize - 1) / tileSize;
+	h.tileBytes = static_cast<std::uint32_t>(align(static_cast<std::uint64_t>(tileSize) * tileSize * (format == TileFormat::Float32 ? sizeof(float) : sizeof(std::uint16_t))));
+	h.minValue = minValue;
+	h.maxValue = maxValue;
+	std::copy(bounds, bounds + 4, h.bounds);
+	h.indexOffset = align(sizeof(NoiseLang::TileFileHeader));
+	h.dataOffset = align(h.indexOffset + static_cast<std::uint64_t>(h.tilesX) * h.tilesY * sizeof(NoiseLang::TileIndexEntry));
+
+	std::vector<NoiseLang::TileIndexEntry> index(static_cast<size_t>(h.tilesX) * h.tilesY);
+	for (size_t i = 0; i < index.size(); i++)
+		index[i] = {h.dataOffset + i * h.tileBytes, h.tileBytes, 0};
+
+	this->file = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (this->file < 0)
+		return false;
+
+	return ftruncate(this->file, static_cast<off_t>(this->GetFileSize())) == 0
+		&& WriteAt(this->file, &h, sizeof(h), 0)
+		&& WriteAt(this->file, index.data(), index.size() * sizeof(NoiseLang::TileIndexEntry), h.indexOffset);
+}
+
+auto NoiseLang::TileWriter::WriteTile(unsigned int tileX, unsigned int tileY, const float* samples, bool& ok) -> size_t {
+	auto& h = this->header;
+	size_t tile = static_cast<size_t>(tileY) * h.tilesX + tileX;
+	size_t count = static_cast<size_t>(h.tileSize) * h.tileSize;
+	size_t clamped = 0;
+
+	if (h.format == TileFormat::Float32){
+		ok = WriteAt(this->file, samples, count * sizeof(float), h.dataOffset + tile * h.tileBytes);
+	} else {
+		std::vector<std::uint16_t> quantized(count);
+		double scale = 65535.0 / (h.maxValue - h.minValue);
+		for (size_t i = 0; i < count; i++){
+			// NaN gets through the clamp below, so it's written as 0 and counted as clamped
+			if (std::isnan(samples[i])){
+				quantized[i] = 0;
+				clamped++;
+				continue;
+			}
+			if (samples[i] < h.minValue || samples[i] > h.maxValue)
+				clamped++;
+			double q = (samples[i] - h.minValue) * scale + 0.5;
+			quantized[i] = static_cast<std::uint16_t>(std::min(std::max(q, 0.0), 65535.0));
+		}
+		ok = WriteAt(this->file, quantized.data(), count * sizeof(std::uint16_t), h.dataOffset + tile * h.tileBytes);
+	}
+
+	// The index entry is only marked once its data is in the file
+	std::uint32_t written = 1;
+	ok = ok && WriteAt(this->file, &written, sizeof(written), h.indexOffset + tile * sizeof(NoiseLang::TileIndexEntry) + offsetof(NoiseLang::TileIndexEntry, written));
+	return clamped;
+}
+
+auto NoiseLang::TileWriter::Close() -> bool {
+	if (this->file < 0)
+		return true;
+	bool ok = fsync(this->file) == 0;
+	ok = close(this->file) == 0 && ok;
+	this->file = -1;
+	return ok;
+}
+
+auto NoiseLang::TileWriter::GetHeader() const -> const NoiseLang::TileFileHeader& {
+	return this->header;
+}
+
+auto NoiseLang::TileWriter::GetFileSize() const -> size_t {
+	return this->header.dataOffset + static_cast<size_t>(this->header.tilesX) * this->header.tilesY * this->header.tileBytes;
+}
+// }}}
+
+// {{{ TileReader
+NoiseLang::TileReader::TileReader() {
+	this->data = nullptr;
+	this->size = 0;
+}
+
+NoiseLang::TileReader::~TileReader() {
+	this->Close();
+}
+
+auto NoiseLang::TileReader::Fail(const std::string& message) -> bool {
+	this->Close();
+	this->error = message;
+	return false;
+}
+
+auto NoiseLang::TileReader::GetError() -> std::string {
+	return this->error;
+}
+
+auto NoiseLang::TileReader::Open(const std::string& filename) -> bool {
+	this->Close();
+
+	int file = open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+		return this->Fail("Couldn't open " + filename);
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(NoiseLang::TileFileHeader)){
+		close(file);
+		return this->Fail(filename + " is too small to be a tile file");
+	}
+
+	// The mapping outlives the descriptor
+	void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (mapping == MAP_FAILED)
+		return this->Fail("Couldn't map " + filename);
+
+	this->data = static_cast<const unsigned char*>(mapping);
+	this->size = static_cast<size_t>(info.st_size);
+
+	auto& h = this->GetHeader();
+	if (std::memcmp(h.magic, "NLTILES\0", 8) != 0 || h.version != NoiseLang::TileWriter::Version)
+		return this->Fail(filename + " is not a version " + std::to_string(NoiseLang::TileWriter::Version) + " tile file");
+	// Nothing below is trusted until it's known to stay inside the mapping, divisions keep the
+	// size checks from overflowing
+	std::uint64_t tiles = static_cast<std::uint64_t>(h.tilesX) * h.tilesY;
+	if (h.format != TileFormat::Float32 && h.format != TileFormat::UInt16)
+		return this->Fail(filename + " has an unknown sample format");
+	std::uint64_t sampleBytes = h.format == TileFormat::Float32 ? sizeof(float) : sizeof(std::uint16_t);
+	if (h.tileSize == 0 || h.tilesX != (static_cast<std::uint64_t>(h.width) + h.tileSize - 1) / h.tileSize || h.tilesY != (static_cast<std::uint64_t>(h.height) + h.tileSize - 1) / h.tileSize)
+		return this->Fail(filename + " has a tile grid that doesn't cover its size");
+	if (h.tileBytes < static_cast<std::uint64_t>(h.tileSize) * h.tileSize * sampleBytes)
+		return this->Fail(filename + " has tiles too small for their samples");
+	if (h.indexOffset % alignof(NoiseLang::TileIndexEntry) != 0 || h.indexOffset > this->size || tiles > (this->size - h.indexOffset) / sizeof(NoiseLang::TileIndexEntry))
+		return this->Fail(filename + " is shorter than its tile index");
+	if (h.dataOffset > this->size || (tiles > 0 && h.tileBytes > (this->size - h.dataOffset) / tiles))
+		return this->Fail(filename + " is shorter than its header says");
+
+	auto index = reinterpret_cast<const NoiseLang::TileIndexEntry*>(this->data + h.indexOffset);
+	for (std::uint64_t i = 0; i < tiles; i++){
+		auto& entry = index[i];
+		if (entry.written && (entry.offset % sampleBytes != 0 || entry.offset > this->size || h.tileBytes > this->size - entry.offset))
+			return this->Fail(filename + " has tile " + std::to_string(i) + " outside the file");
+	}
+
+	return true;
+}
+
+auto NoiseLang::TileReader::Close() -> void {
+	if (this->data != nullptr)
+		munmap(const_cast<unsigned char*>(this->data), this->size);
+	this->data = nullptr;
+	this->size = 0;
+}
+
+auto NoiseLang::TileReader::GetHeader() const -> const NoiseLang::TileFileHeader& {
+	return *reinterpret_cast<const NoiseLang::TileFileHeader*>(this->data);
+}
+
+auto NoiseLang::TileReader::GetEntry(unsigned int tileX, unsigned int tileY) const -> const NoiseLang::TileIndexEntry& {
+	auto& h = this->GetHeader();
+	auto index = reinterpret_cast<const NoiseLang::TileIndexEntry*>(this->data + h.indexOffset);
+	return index[static_cast<size_t>(tileY) * h.tilesX + tileX];
+}
+
+auto NoiseLang::TileReader::GetTile(unsigned int tileX, unsigned int tileY) const -> const void* {
+	auto& h = this->GetHeader();
+	if (tileX >= h.tilesX || tileY >= h.tilesY)
+		return nullptr;
+	auto& entry = this->GetEntry(tileX, tileY);
+	return entry.written ? this->data + entry.offset : nullptr;
+}
+
+auto NoiseLang::TileReader::GetValue(unsigned int x, unsigned int y) const -> float {
+	auto& h = this->GetHeader();
+	if (x >= h.width || y >= h.height)
+		return 0.0f;
+	const void* tile = this->GetTile(x / h.tileSize, y / h.tileSize);
+	if (tile == nullptr)
+		return 0.0f;
+
+	size_t i = static_cast<size_t>(y % h.tileSize) * h.tileSize + x % h.tileSize;
+	if (h.format == TileFormat::Float32)
+		return static_cast<const float*>(tile)[i];
+	return static_cast<float>(h.minValue + static_cast<const std::uint16_t*>(tile)[i] * (h.maxValue - h.minValue) / 65535.0);
+}
+// }}}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cmath>
+
+namespace NoiseLang {
+
+	// Where the viewer looks: pixel (px, py) samples the world at (x + px * scale, y + py * scale, z).
+	// Axis aligned, so every pixel of a column shares its x and every pixel of a row its y.
+	class View {
+		public:
+			double x = 0.0, y = 0.0, z = 0.0;
+			// World units per pixel, 100 pixels to the unit by default
+			double scale = 0.01;
+
+			auto GetX(double px) const -> double;
+			auto GetY(double py) const -> double;
+
+			// Moves what is shown by (dx, dy) pixels, the way a dragged map follows the mouse
+			auto Pan(double dx, double dy) -> void;
+			// Magnifies by `factor` around pixel (px, py), which keeps showing the same point
+			auto Zoom(double factor, double px, double py) -> void;
+
+			// True if `next` is this view moved by whole pixels at the same scale and depth, pixel
+			// (px, py) of `next` then showing pixel (px + dx, py + dy) of this one. Pans accumulate
+			// rounding, so a shift within 1e-6 of a pixel counts as whole.
+			auto GetShift(const NoiseLang::View& next, long& dx, long& dy) const -> bool;
+	};
+
+}
+
+auto NoiseLang::View::GetX(double px) const -> double {
+	return this->x + px * this->scale;
+}
+
+auto NoiseLang::View::GetY(double py) const -> double {
+	return this->y + py * this->scale;
+}
+
+auto NoiseLang::View::Pan(double dx, double dy) -> void {
+	this->x -= dx * this->scale;
+	this->y -= dy * this->scale;
+}
+
+auto NoiseLang::View::Zoom(double factor, double px, double py) -> void {
+	double worldX = this->GetX(px), worldY = this->GetY(py);
+	this->scale /= factor;
+	this->x = worldX - px * this->scale;
+	this->y = worldY - py * this->scale;
+}
+
+auto NoiseLang::View::GetShift(const NoiseLang::View& next, long& dx, long& dy) const -> bool {
+	if (next.scale != this->scale || next.z != this->z)
+		return false;
+
+	double shiftX = (next.x - this->x) / this->scale;
+	double shiftY = (next.y - this->y) / this->scale;
+	if (!(std::fabs(shiftX) < 1e9 && std::fabs(shiftY) < 1e9))
+		return false;
+
+	dx = std::lround(shiftX);
+	dy = std::lround(shiftY);
+	return std::fabs(shiftX - static_cast<double>(dx)) < 1e-6 && std::fabs(shiftY - static_cast<double>(dy)) < 1e-6;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace NoiseLang {
+
+	// A persistent pool of threads that runs batches of independent tasks. Each worker
+	// owns a deque of task indices; idle workers steal from the back of other deques,
+	// so uneven tasks (voronoi tiles next to const tiles) still keep every core busy.
+	class WorkerPool {
+		public:
+			using Job = std::function<void(size_t task, unsigned int worker)>;
+
+		private:
+			class Worker {
+				public:
+					std::deque<size_t> tasks;
+					std::mutex mutex;
+					std::thread thread;
+			};
+
+			std::vector<std::unique_ptr<NoiseLang::WorkerPool::Worker>> workers;
+			std::mutex mutex;
+			std::mutex run_mutex;
+			std::condition_variable wake;
+			std::condition_variable done;
+			unsigned long generation;
+			bool stopping;
+			const Job* job;
+			std::atomic<size_t> remaining;
+
+			auto WorkerLoop(unsigned int index) -> void;
+			auto TakeTask(unsigned int index, size_t& task) -> bool;
+
+		public:
+			// A thread count of 0 uses one thread per hardware thread
+			WorkerPool(unsigned int threadCount = 0);
+			~WorkerPool();
+
+			// Runs job(task, worker) for every task in [0, taskCount) and blocks until all are done
+			auto Run(size_t taskCount, const Job& job) -> void;
+
+			auto GetThreadCount() -> unsigned int;
+	};
+
+}
+
+NoiseLang::WorkerPool::WorkerPool(unsigned int threadCount) {
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	this->generation = 0;
+	this->stopping = false;
+	this->job = nullptr;
+	this->remaining = 0;
+
+	for (unsigned int i = 0; i < threadCount; i++)
+		this->workers.push_back(std::make_unique<NoiseLang::WorkerPool::Worker>());
+
+	// Only start the threads once every worker exists, since they may try to steal immediately
+	for (unsigned int i = 0; i < threadCount; i++)
+		this->workers[i]->thread = std::thread(&NoiseLang::WorkerPool::WorkerLoop, this, i);
+}
+
+NoiseLang::WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+
+	for (auto& worker : this->workers)
+		worker->thread.join();
+}
+
+auto NoiseLang::WorkerPool::GetThreadCount() -> unsigned int {
+	return static_cast<unsigned int>(this->workers.size());
+}
+
+auto NoiseLang::WorkerPool::Run(size_t taskCount, const Job& job) -> void {
+	if (taskCount == 0)
+		return;
+
+	// One batch at a time, the viewer and exports may share a pool
+	std::lock_guard<std::mutex> run_lock(this->run_mutex);
+
+	this->job = &job;
+	this->remaining = taskCount;
+
+	// Hand out contiguous runs of tasks so neighbouring tiles stay on the same core
+	size_t workerCount = this->workers.size();
+	for (size_t w = 0; w < workerCount; w++){
+		size_t begin = taskCount * w / workerCount;
+		size_t end = taskCount * (w + 1) / workerCount;
+
+		std::lock_guard<std::mutex> lock(this->workers[w]->mutex);
+		for (size_t task = begin; task < end; task++)
+			this->workers[w]->tasks.push_back(task);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->generation++;
+	}
+	this->wake.notify_all();
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->done.wait(lock, [this]{ return this->remaining == 0; });
+	this->job = nullptr;
+}
+
+auto NoiseLang::WorkerPool::TakeTask(unsigned int index, size_t& task) -> bool {
+	// Own tasks come off the front, in the order they were handed out
+	{
+		auto& own = *this->workers[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()){
+			task = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	// Steal from the back of the other deques, furthest from where their owner is working
+	size_t workerCount = this->workers.size();
+	for (size_t offset = 1; offset < workerCount; offset++){
+		auto& victim = *this->workers[(index + offset) % workerCount];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()){
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+auto NoiseLang::WorkerPool::WorkerLoop(unsigned int index) -> void {
+	unsigned long seen = 0;
+
+	while (true){
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wake.wait(lock, [this, seen]{ return this->stopping || this->generation != seen; });
+			if (this->stopping)
+				return;
+			seen = this->generation;
+		}
+
+		size_t task;
+		while (this->TakeTask(index, task)){
+			(*this->job)(task, index);
+
+			if (--this->remaining == 0){
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->done.notify_all();
+			}
+		}
+	}
+}
@@ -0,0 +1,17 @@
+mountains = ridgedmulti()
+mountains->SetFrequency(0.5)
+mountains->SetOctaveCount(6.0)
+hills = billow()
+hills->SetFrequency(2.0)
+hillsScaled = scalebias(hills)
+hillsScaled->SetScale(0.125)
+hillsScaled->SetBias(-0.75)
+selector = perlin()
+selector->SetFrequency(0.5)
+selector->SetPersistence(0.25)
+terrain = select(hillsScaled, mountains, selector)
+terrain->SetBounds(0.0, 1000.0)
+final = turbulence(terrain)
+final->SetFrequency(4.0)
+final->SetPower(0.125)
+out final
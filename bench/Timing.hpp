@@ -0,0 +1,24 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+// Seconds each of several runs took
+inline auto Times(const std::function<void()>& run, int repetitions) -> std::vector<double> {
+	std::vector<double> times;
+	for (int repetition = 0; repetition < repetitions; repetition++){
+		auto start = std::chrono::high_resolution_clock::now();
+		run();
+		auto stop = std::chrono::high_resolution_clock::now();
+		times.push_back(std::chrono::duration<double>(stop - start).count());
+	}
+	return times;
+}
+
+// Best of several runs, in seconds
+inline auto Time(const std::function<void()>& run, int repetitions) -> double {
+	auto times = Times(run, repetitions);
+	return times.empty() ? 1e30 : *std::min_element(times.begin(), times.end());
+}
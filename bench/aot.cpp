@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "NoiseLang.hpp"
+#include "Timing.hpp"
+
+// Generated from Terrain.nl by `make aot`
+#include "Terrain.hpp"
+
+auto main(int argc, char** argv) -> int {
+	std::string script = argc > 1 ? argv[1] : "bench/Terrain.nl";
+	const unsigned int width = 512, height = 512;
+
+	auto interpreter = NoiseLang::Interpreter();
+	interpreter.Run(script, false);
+	auto module = interpreter.GetOutModule();
+	auto program = interpreter.GetProgram();
+
+	size_t count = static_cast<size_t>(width) * height;
+	std::vector<double> x(count), y(count), z(count, 0.5);
+	for (size_t i = 0; i < count; i++){
+		x[i] = static_cast<double>(i % width) / 100.0;
+		y[i] = static_cast<double>(i / width) / 100.0;
+	}
+
+	std::vector<double> graph(count), interpreted(count), compiled(count);
+	auto evaluator = NoiseLang::ProgramEvaluator();
+
+	double graphTime = Time([&]{
+		for (size_t i = 0; i < count; i++)
+			graph[i] = module->GetValue(x[i], y[i], z[i]);
+	}, 5);
+	double interpretedTime = Time([&]{
+		evaluator.Evaluate(*program, x.data(), y.data(), z.data(), interpreted.data(), count);
+	}, 5);
+	double compiledTime = Time([&]{
+		Terrain::Evaluate(x.data(), y.data(), z.data(), compiled.data(), count);
+	}, 5);
+
+	double error = 0.0;
+	for (size_t i = 0; i < count; i++)
+		error = std::max(error, std::abs(compiled[i] - graph[i]));
+
+	auto report = [count, graphTime](const std::string& name, double seconds){
+		std::cout << name << " " << seconds * 1000.0 << " ms, " << count / seconds / 1e6 << " Msamples/s, " << graphTime / seconds << "x the module graph" << std::endl;
+	};
+
+	std::cout << script << ", " << width << "x" << height << " samples, " << program->code.size() << " instructions" << std::endl;
+	report("module graph  ", graphTime);
+	report("program       ", interpretedTime);
+	report("compiled (AOT)", compiledTime);
+	std::cout << "max difference from the module graph " << error << std::endl;
+
+	return error == 0.0 ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "NoiseLang.hpp"
+
+// Checks that BlockEvaluator and the compiled program return exactly what GetValue() does, for
+// every module kind in the registry, near the origin and far out
+
+// Gives modules that need parameters to run at all, and a few that would otherwise only run
+// their defaults, something to do
+auto Configure(const std::string& kind, noise::module::Module& module) -> void {
+	using namespace noise::module;
+	if (kind == "curve"){
+		auto& m = static_cast<Curve&>(module);
+		m.AddControlPoint(-1.0, -0.8);
+		m.AddControlPoint(-0.2, 0.1);
+		m.AddControlPoint(0.4, 0.2);
+		m.AddControlPoint(1.0, 1.0);
+	} else if (kind == "terrace"){
+		auto& m = static_cast<Terrace&>(module);
+		m.AddControlPoint(-1.0);
+		m.AddControlPoint(0.0);
+		m.AddControlPoint(0.6);
+	} else if (kind == "select"){
+		auto& m = static_cast<Select&>(module);
+		m.SetBounds(-0.2, 0.3);
+		m.SetEdgeFalloff(0.1);
+	} else if (kind == "clamp"){
+		static_cast<Clamp&>(module).SetBounds(-0.5, 0.5);
+	} else if (kind == "exponent"){
+		static_cast<Exponent&>(module).SetExponent(1.7);
+	} else if (kind == "scalebias"){
+		static_cast<ScaleBias&>(module).SetScale(0.7);
+		static_cast<ScaleBias&>(module).SetBias(0.1);
+	} else if (kind == "rotatepoint"){
+		static_cast<RotatePoint&>(module).SetAngles(30.0, 40.0, 50.0);
+	} else if (kind == "scalepoint"){
+		static_cast<ScalePoint&>(module).SetScale(1.5, 0.5, 2.0);
+	} else if (kind == "translatepoint"){
+		static_cast<TranslatePoint&>(module).SetTranslation(0.3, -1.2, 4.5);
+	} else if (kind == "turbulence"){
+		auto& m = static_cast<Turbulence&>(module);
+		m.SetPower(0.5);
+		m.SetFrequency(2.0);
+		m.SetRoughness(4);
+	} else if (kind == "voronoi"){
+		static_cast<Voronoi&>(module).EnableDistance(true);
+	} else if (kind == "const"){
+		static_cast<Const&>(module).SetConstValue(0.25);
+	}
+}
+
+auto Same(double a, double b) -> bool {
+	return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+auto main() -> int {
+	// Points near the origin, where the viewer looks, and far out
+	std::vector<double> x, y, z;
+	for (double origin : {0.0, -3.75, 1234567.891}){
+		for (int j = 0; j < 32; j++){
+			for (int i = 0; i < 32; i++){
+				x.push_back(origin + i * 0.137);
+				y.push_back(origin - j * 0.291);
+				z.push_back(origin * 0.5 + (i ^ j) * 0.0625);
+			}
+		}
+	}
+	size_t count = x.size();
+
+	// Distinct sources, so a kind reading the wrong one shows up
+	auto perlin = noise::module::Perlin();
+	auto ridged = noise::module::RidgedMulti();
+	ridged.SetSeed(1);
+	auto billow = noise::module::Billow();
+	billow.SetSeed(2);
+	auto control = noise::module::Perlin();
+	control.SetSeed(3);
+	control.SetFrequency(0.5);
+	const noise::module::Module* sources[] = {&perlin, &ridged, &billow, &control};
+
+	int failures = 0;
+	for (auto& spec : NoiseLang::Registry::Get().GetKinds()){
+		auto module = spec.create();
+		for (int source = 0; source < module->GetSourceModuleCount(); source++)
+			module->SetSourceModule(source, *sources[source % 4]);
+		Configure(spec.name, *module);
+
+		std::vector<double> expected(count), block(count), compiled(count);
+		for (size_t i = 0; i < count; i++)
+			expected[i] = module->GetValue(x[i], y[i], z[i]);
+
+		auto evaluator = NoiseLang::BlockEvaluator();
+		evaluator.Evaluate(*module, x.data(), y.data(), z.data(), block.data(), count);
+
+		auto program = NoiseLang::Compiler::Compile(*module);
+		auto programEvaluator = NoiseLang::ProgramEvaluator();
+		programEvaluator.Evaluate(*program, x.data(), y.data(), z.data(), compiled.data(), count);
+
+		size_t blockMismatches = 0, compiledMismatches = 0;
+		for (size_t i = 0; i < count; i++){
+			if (!Same(block[i], expected[i]) && blockMismatches++ == 0)
+				std::cerr << spec.name << " block at (" << x[i] << ", " << y[i] << ", " << z[i] << ") is " << block[i] << ", GetValue says " << expected[i] << std::endl;
+			if (!Same(compiled[i], expected[i]) && compiledMismatches++ == 0)
+				std::cerr << spec.name << " program at (" << x[i] << ", " << y[i] << ", " << z[i] << ") is " << compiled[i] << ", GetValue says " << expected[i] << std::endl;
+		}
+
+		bool ok = blockMismatches == 0 && compiledMismatches == 0;
+		std::cout << spec.name << ": " << (ok ? "matches" : std::to_string(blockMismatches) + " block and " + std::to_string(compiledMismatches) + " program samples of " + std::to_string(count) + " differ  FAIL") << std::endl;
+		failures += ok ? 0 : 1;
+	}
+
+	std::cout << (failures == 0 ? "every kind matches GetValue" : "kinds differing from GetValue") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
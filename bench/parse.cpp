@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "NoiseLang.hpp"
+#include "Timing.hpp"
+
+// Counts heap allocations, so the parser's no allocation per token promise can be checked
+static size_t allocations = 0;
+
+auto operator new(size_t size) -> void* {
+	allocations++;
+	if (void* p = std::malloc(size))
+		return p;
+	throw std::bad_alloc();
+}
+
+auto operator delete(void* p) noexcept -> void {
+	std::free(p);
+}
+
+auto operator delete(void* p, size_t) noexcept -> void {
+	std::free(p);
+}
+
+// A long generated script in the style of our sweep scripts: chains of generators, their
+// parameters set one method call at a time, and combiners joining each chain to the last
+auto Synthesize(size_t lineCount) -> std::vector<std::string> {
+	static const char* generators[] = {"perlin", "billow", "ridgedmulti"};
+	std::vector<std::string> lines;
+
+	// gen0 takes 5 lines and every later generator 8, the first scaled module ends on line 13
+	lineCount = std::max(lineCount, static_cast<size_t>(13));
+	for (size_t n = 0; lines.size() < lineCount; n++){
+		std::string g = "gen" + std::to_string(n);
+		lines.push_back(g + " = " + generators[n % 3] + "()");
+		lines.push_back(g + "->SetFrequency(" + std::to_string(0.5 + n % 7 * 0.25) + ")");
+		lines.push_back(g + "->SetOctaveCount(" + std::to_string(2 + n % 5) + ")");
+		lines.push_back(g + "->SetSeed(" + std::to_string(n) + ")");
+		lines.push_back(g + "->SetLacunarity(2.0)");
+		if (n > 0){
+			std::string s = "sum" + std::to_string(n);
+			lines.push_back(s + " = add(" + g + ", gen" + std::to_string(n - 1) + ")");
+			lines.push_back("scaled" + std::to_string(n) + " = scalebias(" + s + ")");
+			lines.push_back("scaled" + std::to_string(n) + "->SetScale(-0.5)");
+		}
+	}
+
+	lines.resize(lineCount);
+	lines.push_back("out scaled" + std::to_string((lineCount - 5) / 8));
+	return lines;
+}
+
+auto main(int argc, char** argv) -> int {
+	size_t lineCount = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 50000;
+	auto lines = Synthesize(lineCount);
+
+	size_t bytes = 0;
+	for (auto& line : lines)
+		bytes += line.size() + 1;
+
+	auto parser = NoiseLang::Parser();
+	auto statement = NoiseLang::Statement();
+	size_t failures = 0;
+
+	// Warm the statement's buffers up once, after that parsing should barely allocate
+	for (auto& line : lines)
+		parser.Parse(line, statement);
+
+	size_t before = allocations;
+	double parseTime = Time([&]{
+		for (auto& line : lines)
+			failures += parser.Parse(line, statement) ? 0 : 1;
+	}, 3);
+	double allocationsPerLine = static_cast<double>(allocations - before) / 3.0 / static_cast<double>(lines.size());
+
+	// What every line used to cost: matching against the two statement regexes the old
+	// RunLine tried first (it tried up to seven, then iterated the match a second time)
+	auto assignment = std::regex("^([a-zA-z]{1}[a-zA-z0-9]*)([ \t]*)(=)([ \t]*)(abs|add|billow|blend|cache|checkerboard|clamp|const|curve|cylinders|displace|exponent|invert|max|min|multiply|perlin|power|ridgedmulti|rotatepoint|scalebias|scalepoint|select|spheres|terrace|translatepoint|turbulence|voronoi)(\\()(([a-zA-z]{1}[a-zA-z0-9]*([ \t]*),([ \t]*))*([a-zA-z]{1}[a-zA-z0-9]*([ \t]*)){1})?(\\))$");
+	auto method = std::regex("^([a-zA-Z]{1}[a-zA-Z0-9]*)(->)([A-Z]{1}[a-zA-z]*)(\\()((((-?\\d*\\.?\\d+)|([a-zA-Z]{1}[a-zA-Z0-9]*))([ \t]*),([ \t]*))*((-?\\d*\\.?\\d+)|([a-zA-Z]{1}[a-zA-Z0-9]*)){1})(\\))$");
+	size_t matched = 0;
+	double regexTime = Time([&]{
+		for (auto& line : lines)
+			matched += (std::regex_match(line, assignment) || std::regex_match(line, method)) ? 1 : 0;
+	}, 3);
+
+	// End to end, the way `load` runs a script
+	const char* path = "parse_bench.nl";
+	std::ofstream file(path);
+	for (auto& line : lines)
+		file << line << std::endl;
+	file.close();
+
+	double loadTime = Time([&]{
+		auto interpreter = NoiseLang::Interpreter();
+		interpreter.Run(path, false);
+	}, 3);
+	std::remove(path);
+
+	// A parameter sweep: the same few modules retuned over and over, all dispatch and no new modules
+	auto sweep = NoiseLang::Interpreter();
+	sweep.RunLine("sweepPerlin = perlin()", false);
+	sweep.RunLine("sweepVoronoi = voronoi()", false);
+	sweep.RunLine("sweepScale = scalebias(sweepPerlin)", false);
+
+	std::vector<std::string> calls;
+	for (size_t n = 0; n < 1000; n++){
+		calls.push_back("sweepPerlin->SetFrequency(" + std::to_string(1.0 + n * 0.001) + ")");
+		calls.push_back("sweepPerlin->SetSeed(" + std::to_string(n) + ")");
+		calls.push_back("sweepVoronoi->SetSeed(" + std::to_string(n) + ")");
+		calls.push_back("sweepScale->SetScale(0.5)");
+	}
+
+	const size_t sweepRepetitions = 250;
+	double sweepTime = Time([&]{
+		for (size_t repetition = 0; repetition < sweepRepetitions; repetition++)
+			for (auto& call : calls)
+				failures += sweep.RunLine(call, false) == NoiseLang::Ok ? 0 : 1;
+	}, 3);
+	double sweepCalls = static_cast<double>(calls.size() * sweepRepetitions);
+
+	std::cout << lines.size() << " lines, " << bytes / 1024 << " KiB" << std::endl;
+	std::cout << "parser      " << parseTime * 1000.0 << " ms, " << lines.size() / parseTime / 1e6 << " Mlines/s, " << bytes / parseTime / 1e6 << " MB/s, " << allocationsPerLine << " allocations per line" << std::endl;
+	std::cout << "regex match " << regexTime * 1000.0 << " ms, " << lines.size() / regexTime / 1e6 << " Mlines/s (" << regexTime / parseTime << "x slower)" << std::endl;
+	std::cout << "method call " << sweepTime / sweepCalls * 1e9 << " ns per call, " << sweepCalls / sweepTime / 1e6 << " Mcalls/s through RunLine" << std::endl;
+	std::cout << "load        " << loadTime * 1000.0 << " ms, " << lines.size() / loadTime / 1e6 << " Mlines/s including building the graph" << std::endl;
+
+	if (failures > 0)
+		std::cout << failures << " lines failed to parse" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
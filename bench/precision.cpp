@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "NoiseLang.hpp"
+
+// Checks the float32 kernels against the double ones at every SIMD level this CPU runs, and
+// fails if any sample is further off than Kernels::Single::MaxError
+
+class Worst {
+	public:
+		double error = 0.0;
+		double sum = 0.0;
+		size_t samples = 0;
+		int seed = 0, octaves = 0, quality = 0;
+		double x = 0.0, y = 0.0, z = 0.0;
+		double seconds = 0.0;
+		double doubleSeconds = 0.0;
+};
+
+// Points near the origin, where the viewer looks, and far out, where float coordinates would
+// already have lost their fractions. The far ones push 16 octaves past MakeInt32Range's 2^30.
+auto Points(std::vector<double>& x, std::vector<double>& y, std::vector<double>& z) -> void {
+	for (double origin : {0.0, -3.75, 1234567.891}){
+		for (int j = 0; j < 16; j++){
+			for (int i = 0; i < 16; i++){
+				x.push_back(origin + i * 0.137);
+				y.push_back(origin - j * 0.291);
+				z.push_back(origin * 0.5 + (i ^ j) * 0.0625);
+			}
+		}
+	}
+}
+
+auto main(int argc, char** argv) -> int {
+	int seeds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 64;
+	namespace K = NoiseLang::Kernels;
+
+	std::vector<double> x, y, z;
+	Points(x, y, z);
+	size_t count = x.size();
+	std::vector<double> exact(count), single(count);
+
+	// ridgedmulti's weights at the default exponent, lacunarity and 16 octaves
+	auto ridged = noise::module::RidgedMulti();
+	ridged.SetOctaveCount(noise::module::RIDGED_MAX_OCTAVE);
+	const double* weights = K::RidgedMultiAccess::SpectralWeights(ridged);
+
+	std::vector<NoiseLang::SimdLevel> levels;
+	for (auto level : {NoiseLang::SimdLevel::Baseline, NoiseLang::SimdLevel::SSE41, NoiseLang::SimdLevel::AVX2})
+		if (level <= NoiseLang::Simd::GetSupported())
+			levels.push_back(level);
+
+	int failures = 0;
+	std::cout << std::left << std::setw(14) << "kernel" << std::setw(10) << "level" << std::right << std::setw(12) << "max error" << std::setw(12) << "mean error"
+		<< std::setw(8) << "seed" << std::setw(9) << "octaves" << std::setw(9) << "quality" << std::setw(10) << "speedup" << std::endl;
+
+	for (std::string kernel : {"perlin", "billow", "ridgedmulti"}){
+		std::vector<Worst> worst(levels.size());
+
+		for (int seed = 0; seed < seeds; seed++){
+			for (int octaves = 1; octaves <= 16; octaves++){
+				for (int quality = noise::QUALITY_FAST; quality <= noise::QUALITY_BEST; quality++){
+					auto q = static_cast<noise::NoiseQuality>(quality);
+					// Seeds both sides of zero, libnoise's seed mixing wraps
+					int s = seed * 7919 - 100000;
+
+					auto run = [&](bool precise, double* out){
+						if (kernel == "perlin")
+							(precise ? K::Perlin : K::Single::Perlin)(x.data(), y.data(), z.data(), out, count, 1.0, 2.0, 0.5, octaves, s, q, 1.0);
+						else if (kernel == "billow")
+							(precise ? K::Billow : K::Single::Billow)(x.data(), y.data(), z.data(), out, count, 1.0, 2.0, 0.5, octaves, s, q, 1.0);
+						else
+							(precise ? K::RidgedMulti : K::Single::RidgedMulti)(x.data(), y.data(), z.data(), out, count, 1.0, 2.0, octaves, s, q, weights, 1.0);
+					};
+
+					auto start = std::chrono::steady_clock::now();
+					run(true, exact.data());
+					double doubleSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+					for (size_t l = 0; l < levels.size(); l++){
+						NoiseLang::Simd::Set(levels[l]);
+						start = std::chrono::steady_clock::now();
+						run(false, single.data());
+						worst[l].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+						worst[l].doubleSeconds += doubleSeconds;
+
+						for (size_t i = 0; i < count; i++){
+							double error = std::fabs(single[i] - exact[i]);
+							worst[l].sum += error;
+							worst[l].samples++;
+							if (error > worst[l].error || std::isnan(error)){
+								worst[l] = Worst{error, worst[l].sum, worst[l].samples, s, octaves, quality, x[i], y[i], z[i], worst[l].seconds, worst[l].doubleSeconds};
+							}
+						}
+					}
+				}
+			}
+		}
+
+		for (size_t l = 0; l < levels.size(); l++){
+			auto& w = worst[l];
+			bool ok = w.error <= K::Single::MaxError;
+			std::cout << std::left << std::setw(14) << kernel << std::setw(10) << NoiseLang::Simd::GetName(levels[l]) << std::right << std::scientific << std::setprecision(2)
+				<< std::setw(12) << w.error << std::setw(12) << w.sum / static_cast<double>(w.samples) << std::defaultfloat
+				<< std::setw(8) << w.seed << std::setw(9) << w.octaves << std::setw(9) << w.quality << std::fixed << std::setw(9) << w.doubleSeconds / w.seconds << "x" << std::defaultfloat
+				<< (ok ? "" : "  FAIL") << std::endl;
+			if (!ok){
+				std::cerr << kernel << " at " << NoiseLang::Simd::GetName(levels[l]) << " is off by " << w.error << " at (" << w.x << ", " << w.y << ", " << w.z << "), more than " << K::Single::MaxError << std::endl;
+				failures++;
+			}
+		}
+	}
+
+	NoiseLang::Simd::Set(NoiseLang::Simd::GetSupported());
+	std::cout << (failures == 0 ? "every kernel within " : "kernels outside ") << K::Single::MaxError << " of double" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,300 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "NoiseLang.hpp"
+#include "Timing.hpp"
+
+// One measured configuration: a module kind with its sources, or a whole script at a size and thread count
+class Case {
+	public:
+		std::string name;
+		std::vector<std::string> script;
+		unsigned int size;
+		unsigned int threads;
+		// Module cases time one evaluator on one thread, script cases time the exporter on the pool
+		bool exporter;
+};
+
+class Result {
+	public:
+		std::string name;
+		size_t samples;
+		unsigned int threads;
+		int repetitions;
+		double mean, stddev, min;
+};
+
+class Options {
+	public:
+		std::string format = "csv";
+		std::string baseline;
+		std::string save;
+		double threshold = 10.0;
+		int warmup = 1;
+		int repetitions = 5;
+		unsigned int size = 256;
+		std::string filter;
+};
+
+// Every kind gets a case, its sources are cheap generators so the kind itself dominates
+auto ModuleCases(const Options& options) -> std::vector<Case> {
+	static const char* sources[] = {"checkerboard", "spheres", "cylinders", "spheres"};
+	std::vector<Case> cases;
+
+	auto add = [&](const std::string& name, std::vector<std::string> script){
+		script.push_back("out m");
+		cases.push_back({"module/" + name, std::move(script), options.size, 1, false});
+	};
+
+	for (auto& kind : NoiseLang::Registry::Get().GetKinds()){
+		std::vector<std::string> script;
+		std::string arguments;
+		for (unsigned int i = 0; i < kind.sourceCount; i++){
+			script.push_back("s" + std::to_string(i) + " = " + sources[i] + "()");
+			arguments += (i > 0 ? ", s" : "s") + std::to_string(i);
+		}
+		script.push_back("m = " + kind.name + "(" + arguments + ")");
+
+		if (kind.name == "perlin" || kind.name == "billow" || kind.name == "ridgedmulti"){
+			for (int octaves : {1, 4, 8}){
+				for (int quality : {noise::QUALITY_FAST, noise::QUALITY_STD, noise::QUALITY_BEST}){
+					auto fractal = script;
+					fractal.push_back("m->SetOctaveCount(" + std::to_string(octaves) + ")");
+					fractal.push_back("m->SetNoiseQuality(" + std::to_string(quality) + ")");
+					add(kind.name + "/o" + std::to_string(octaves) + "/q" + std::to_string(quality), fractal);
+				}
+			}
+			continue;
+		}
+
+		if (kind.name == "curve")
+			for (double point : {-1.0, -0.25, 0.5, 1.0})
+				script.push_back("m->AddControlPoint(" + std::to_string(point) + ", " + std::to_string(point * point) + ")");
+		if (kind.name == "terrace")
+			script.push_back("m->MakeControlPoints(8)");
+		if (kind.name == "select")
+			script.push_back("m->SetEdgeFalloff(0.125)");
+		if (kind.name == "turbulence"){
+			for (int roughness : {1, 3, 6}){
+				auto turbulence = script;
+				turbulence.push_back("m->SetRoughness(" + std::to_string(roughness) + ")");
+				add(kind.name + "/r" + std::to_string(roughness), turbulence);
+			}
+			continue;
+		}
+		if (kind.name == "voronoi"){
+			auto distance = script;
+			distance.push_back("m->EnableDistance()");
+			add(kind.name + "/distance", distance);
+			// Cells a couple of samples wide, so each cell's samples are searched together far less
+			auto fine = script;
+			fine.push_back("m->SetFrequency(64)");
+			add(kind.name + "/f64", fine);
+		}
+
+		add(kind.name, script);
+	}
+	return cases;
+}
+
+// The scripts we actually run, at viewer and export sizes, on one thread and on all of them
+auto ScriptCases() -> std::vector<Case> {
+	std::vector<Case> cases;
+	unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+
+	for (std::string path : {"Program.nl", "bench/Terrain.nl"}){
+		std::ifstream file(path);
+		std::vector<std::string> script;
+		std::string line;
+		while (std::getline(file, line))
+			if (line.rfind("show", 0) != 0)
+				script.push_back(line);
+		if (script.empty()){
+			std::cerr << "skipping " << path << ", it can't be read" << std::endl;
+			continue;
+		}
+
+		for (unsigned int size : {256u, 512u, 1024u}){
+			for (unsigned int threads : {1u, hardware}){
+				cases.push_back({"script/" + path + "/" + std::to_string(size) + "/t" + std::to_string(threads), script, size, threads, true});
+				if (threads == hardware)
+					break;
+			}
+		}
+	}
+	return cases;
+}
+
+auto Measure(const Case& c, const Options& options, std::string& error) -> Result {
+	auto interpreter = NoiseLang::Interpreter();
+	for (auto& line : c.script){
+		if (interpreter.RunLine(line, false) == NoiseLang::Error){
+			error = line + ": " + interpreter.GetError();
+			return {};
+		}
+	}
+
+	std::shared_ptr<const NoiseLang::Program> program;
+	try {
+		program = interpreter.GetProgram();
+	} catch (noise::Exception&){
+		error = "doesn't compile";
+		return {};
+	}
+
+	size_t samples = static_cast<size_t>(c.size) * c.size;
+	auto workers = NoiseLang::WorkerPool(c.threads);
+	auto evaluator = NoiseLang::ProgramEvaluator();
+	auto grid = NoiseLang::PointGrid(0.0, 0.0, 0.5, 0.01, 0.01, c.size, c.size);
+	std::vector<double> out(c.exporter ? 0 : samples);
+
+	auto run = [&]{
+		if (c.exporter)
+			NoiseLang::Exporter::Render(*program, workers, c.size, c.size, NoiseLang::Bounds{0.0, c.size / 100.0, 0.0, c.size / 100.0}, 0.5);
+		else
+			evaluator.EvaluateGrid(*program, grid, out.data());
+	};
+
+	for (int i = 0; i < options.warmup; i++)
+		run();
+
+	// Nanoseconds per sample
+	auto times = Times(run, options.repetitions);
+	for (double& t : times)
+		t = t * 1e9 / static_cast<double>(samples);
+
+	auto result = Result();
+	result.name = c.name;
+	result.samples = samples;
+	result.threads = workers.GetThreadCount();
+	result.repetitions = options.repetitions;
+	result.mean = 0.0;
+	for (double t : times)
+		result.mean += t / static_cast<double>(times.size());
+	double variance = 0.0;
+	for (double t : times)
+		variance += (t - result.mean) * (t - result.mean) / static_cast<double>(std::max<size_t>(times.size() - 1, 1));
+	result.stddev = std::sqrt(variance);
+	result.min = *std::min_element(times.begin(), times.end());
+	return result;
+}
+
+auto WriteCSV(std::ostream& stream, const std::vector<Result>& results) -> void {
+	stream << "name,samples,threads,repetitions,mean_ns,stddev_ns,min_ns" << std::endl;
+	for (auto& r : results)
+		stream << r.name << "," << r.samples << "," << r.threads << "," << r.repetitions << "," << r.mean << "," << r.stddev << "," << r.min << std::endl;
+}
+
+auto WriteJSON(std::ostream& stream, const std::vector<Result>& results) -> void {
+	stream << "[" << std::endl;
+	for (size_t i = 0; i < results.size(); i++){
+		auto& r = results[i];
+		stream << "  {\"name\": \"" << r.name << "\", \"samples\": " << r.samples << ", \"threads\": " << r.threads << ", \"repetitions\": " << r.repetitions
+			<< ", \"mean_ns\": " << r.mean << ", \"stddev_ns\": " << r.stddev << ", \"min_ns\": " << r.min << "}" << (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+	stream << "]" << std::endl;
+}
+
+// Baselines are the CSV this writes, only the name and the best time are compared
+auto ReadBaseline(const std::string& path, std::map<std::string, double>& baseline) -> bool {
+	std::ifstream file(path);
+	if (!file)
+		return false;
+
+	std::string line;
+	std::getline(file, line);
+	while (std::getline(file, line)){
+		std::vector<std::string> fields;
+		std::stringstream row(line);
+		for (std::string field; std::getline(row, field, ',');)
+			fields.push_back(field);
+		if (fields.size() == 7)
+			baseline[fields[0]] = std::strtod(fields[6].c_str(), nullptr);
+	}
+	return true;
+}
+
+auto main(int argc, char** argv) -> int {
+	auto options = Options();
+	for (int i = 1; i < argc; i++){
+		std::string arg = argv[i];
+		std::string value = i + 1 < argc ? argv[i + 1] : "";
+		if (arg == "--format") options.format = value;
+		else if (arg == "--baseline") options.baseline = value;
+		else if (arg == "--save") options.save = value;
+		else if (arg == "--threshold") options.threshold = std::strtod(value.c_str(), nullptr);
+		else if (arg == "--warmup") options.warmup = std::atoi(value.c_str());
+		else if (arg == "--repetitions") options.repetitions = std::max(1, std::atoi(value.c_str()));
+		else if (arg == "--size") options.size = static_cast<unsigned int>(std::max(1, std::atoi(value.c_str())));
+		else if (arg == "--filter") options.filter = value;
+		else {
+			std::cerr << "usage: " << argv[0] << " [--format csv|json] [--baseline file] [--threshold percent] [--save file]" << std::endl;
+			std::cerr << "       [--warmup n] [--repetitions n] [--size n] [--filter substring]" << std::endl;
+			return 2;
+		}
+		i++;
+	}
+
+	auto cases = ModuleCases(options);
+	auto scripts = ScriptCases();
+	cases.insert(cases.end(), scripts.begin(), scripts.end());
+
+	std::vector<Result> results;
+	int failures = 0;
+	for (auto& c : cases){
+		if (c.name.find(options.filter) == std::string::npos)
+			continue;
+		std::string error;
+		auto result = Measure(c, options, error);
+		if (error != ""){
+			std::cerr << c.name << " failed: " << error << std::endl;
+			failures++;
+			continue;
+		}
+		results.push_back(result);
+	}
+
+	if (options.format == "json")
+		WriteJSON(std::cout, results);
+	else
+		WriteCSV(std::cout, results);
+
+	if (options.save != ""){
+		std::ofstream file(options.save);
+		WriteCSV(file, results);
+		std::cerr << "saved " << results.size() << " results to " << options.save << std::endl;
+	}
+
+	if (options.baseline != ""){
+		std::map<std::string, double> baseline;
+		if (!ReadBaseline(options.baseline, baseline)){
+			// A missing baseline fails rather than passing a gate that compared nothing
+			std::cerr << "no baseline at " << options.baseline << ", nothing compared (--save writes one)" << std::endl;
+			failures++;
+		} else {
+			int regressions = 0;
+			for (auto& r : results){
+				auto it = baseline.find(r.name);
+				if (it == baseline.end() || it->second <= 0.0)
+					continue;
+				double change = 100.0 * (r.min - it->second) / it->second;
+				if (change > options.threshold){
+					std::cerr << "regression: " << r.name << " " << it->second << " -> " << r.min << " ns/sample (+" << change << "%)" << std::endl;
+					regressions++;
+				}
+			}
+			std::cerr << regressions << " of " << results.size() << " cases regressed more than " << options.threshold << "% against " << options.baseline << std::endl;
+			failures += regressions;
+		}
+	}
+
+	return failures == 0 ? 0 : 1;
+}
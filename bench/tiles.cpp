@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "NoiseLang.hpp"
+
+// Writes tile files with Exporter::RenderTiles in both formats, reads them back through
+// TileReader and checks every sample against the program evaluated directly. Then damages
+// the file's header and index a field at a time and checks the reader refuses each one.
+
+auto ReadFile(const std::string& filename) -> std::vector<char> {
+	std::ifstream file(filename, std::ios::binary);
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+auto WriteFile(const std::string& filename, const std::vector<char>& bytes) -> void {
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+auto main() -> int {
+	// Not a multiple of the tile size either way, so the edge tiles are padded
+	const unsigned int width = 300, height = 170, tileSize = 64;
+	const double bounds[4] = {-2.0, 3.0, -1.0, 1.5};
+
+	// Ridged noise goes past -1 to 1, so 16-bit tiles clamp some of it
+	auto perlin = noise::module::Perlin();
+	auto ridged = noise::module::RidgedMulti();
+	auto out = noise::module::Add();
+	out.SetSourceModule(0, perlin);
+	out.SetSourceModule(1, ridged);
+	auto program = NoiseLang::Compiler::Compile(out);
+	auto workers = NoiseLang::WorkerPool();
+
+	std::vector<double> expected(static_cast<size_t>(width) * height);
+	auto evaluator = NoiseLang::ProgramEvaluator();
+	double stepX = (bounds[1] - bounds[0]) / width, stepY = (bounds[3] - bounds[2]) / height;
+	evaluator.EvaluateGrid(*program, NoiseLang::PointGrid(bounds[0], bounds[2], 0.0, stepX, stepY, width, height), expected.data());
+
+	int failures = 0;
+	std::string filename = "bench/tiles.check.nlt";
+	for (auto format : {NoiseLang::TileFormat::Float32, NoiseLang::TileFormat::UInt16}){
+		std::string name = format == NoiseLang::TileFormat::Float32 ? "float" : "u16";
+
+		auto writer = NoiseLang::TileWriter();
+		bool ok = writer.Open(filename, width, height, tileSize, format, -1.0, 1.0, bounds);
+		size_t clamped = ok ? NoiseLang::Exporter::RenderTiles(*program, workers, writer, 0.0, ok) : 0;
+		if (!writer.Close() || !ok){
+			std::cerr << "Couldn't write " << filename << std::endl;
+			return 1;
+		}
+
+		auto reader = NoiseLang::TileReader();
+		if (!reader.Open(filename)){
+			std::cout << name << ": " << reader.GetError() << "  FAIL" << std::endl;
+			failures++;
+			continue;
+		}
+
+		// 16-bit samples are within half a step of the value clamped to the range
+		double step = 2.0 / 65535.0;
+		size_t mismatches = 0, outside = 0;
+		for (unsigned int y = 0; y < height; y++){
+			for (unsigned int x = 0; x < width; x++){
+				double e = expected[static_cast<size_t>(y) * width + x];
+				float value = reader.GetValue(x, y);
+				bool same;
+				if (format == NoiseLang::TileFormat::Float32){
+					same = value == static_cast<float>(e);
+				} else {
+					outside += (e < -1.0 || e > 1.0) ? 1 : 0;
+					same = std::fabs(value - std::min(std::max(e, -1.0), 1.0)) <= step * 0.5 + 1e-6;
+				}
+				if (!same && mismatches++ == 0)
+					std::cerr << name << " at (" << x << ", " << y << ") reads " << value << ", the program says " << e << std::endl;
+			}
+		}
+
+		// Past the edge and inside the padding reads 0, and the padding tiles stay in the grid
+		auto& h = reader.GetHeader();
+		bool edges = reader.GetValue(width, 0) == 0.0f && reader.GetValue(0, height) == 0.0f && reader.GetTile(h.tilesX, 0) == nullptr && reader.GetTile(h.tilesX - 1, h.tilesY - 1) != nullptr;
+		bool counted = format == NoiseLang::TileFormat::Float32 || clamped == outside;
+
+		bool passed = mismatches == 0 && edges && counted;
+		std::cout << name << ": " << h.tilesX * h.tilesY << " tiles, " << (passed ? "every sample matches" : std::to_string(mismatches) + " samples differ" + (edges ? "" : ", reads past the edge") + (counted ? "" : ", clamped count off") + "  FAIL");
+		if (format == NoiseLang::TileFormat::UInt16)
+			std::cout << ", " << clamped << " clamped";
+		std::cout << std::endl;
+		failures += passed ? 0 : 1;
+	}
+
+	// The u16 file damaged one field at a time, each must be refused rather than trusted
+	auto bytes = ReadFile(filename);
+	NoiseLang::TileFileHeader header;
+	std::memcpy(&header, bytes.data(), sizeof(header));
+	auto damage = [&](const std::string& what, auto change){
+		auto damaged = bytes;
+		change(damaged);
+		std::string damagedName = "bench/tiles.damaged.nlt";
+		WriteFile(damagedName, damaged);
+		auto reader = NoiseLang::TileReader();
+		bool refused = !reader.Open(damagedName);
+		std::cout << what << ": " << (refused ? reader.GetError() : "opened  FAIL") << std::endl;
+		failures += refused ? 0 : 1;
+		std::remove(damagedName.c_str());
+	};
+	auto set = [](std::vector<char>& b, size_t offset, auto value){ std::memcpy(b.data() + offset, &value, sizeof(value)); };
+
+	damage("truncated", [](std::vector<char>& b){ b.resize(b.size() - 100); });
+	damage("tile size 0", [&](std::vector<char>& b){ set(b, offsetof(NoiseLang::TileFileHeader, tileSize), std::uint32_t(0)); });
+	damage("more tiles than the size needs", [&](std::vector<char>& b){ set(b, offsetof(NoiseLang::TileFileHeader, tilesX), header.tilesX + 1000); });
+	damage("tiles smaller than their samples", [&](std::vector<char>& b){ set(b, offsetof(NoiseLang::TileFileHeader, tileBytes), std::uint32_t(16)); });
+	damage("index past the end", [&](std::vector<char>& b){ set(b, offsetof(NoiseLang::TileFileHeader, indexOffset), std::uint64_t(b.size())); });
+	damage("unknown format", [&](std::vector<char>& b){ set(b, offsetof(NoiseLang::TileFileHeader, format), std::uint32_t(7)); });
+	damage("tile past the end", [&](std::vector<char>& b){ set(b, header.indexOffset + sizeof(NoiseLang::TileIndexEntry), std::uint64_t(b.size() - 16)); });
+
+	std::remove(filename.c_str());
+	std::cout << (failures == 0 ? "tiles read back as written" : "tile files read back wrong") << std::endl;
+	return failures == 0 ? 0 : 1;
+}
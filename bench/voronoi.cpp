@@ -0,0 +1,83 @@
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "NoiseLang.hpp"
+
+// Checks that Kernels::Voronoi returns exactly what libnoise's Voronoi::GetValue() does, on
+// blocks it batches and on blocks spread too wide for it to, down to ones billions of cells
+// across, where the box of cells they reach no longer fits in 64 bits
+
+class Block {
+	public:
+		std::string name;
+		std::vector<double> x, y, z;
+};
+
+// A width by height grid of samples from (x0, y0) stepping (stepX, stepY), at depth z
+auto Grid(const std::string& name, double x0, double y0, double z, double stepX, double stepY, int width, int height) -> Block {
+	Block block{name, {}, {}, {}};
+	for (int j = 0; j < height; j++){
+		for (int i = 0; i < width; i++){
+			block.x.push_back(x0 + i * stepX);
+			block.y.push_back(y0 + j * stepY);
+			block.z.push_back(z);
+		}
+	}
+	return block;
+}
+
+auto main() -> int {
+	std::vector<Block> blocks;
+	// A viewer tile near the origin, batched
+	blocks.push_back(Grid("dense", -1.6, -1.6, 0.5, 0.05, 0.05, 64, 64));
+	// More cells per sample than batching pays for
+	blocks.push_back(Grid("sparse", -64.0, -64.0, 0.5, 2.0, 2.0, 64, 64));
+	// A 64x64 tile after `view 0 0 3e7`, about 2e9 cells wide on x and y
+	blocks.push_back(Grid("huge", -1.05e9, -1.05e9, 0.5, 2.1e9 / 63, 2.1e9 / 63, 64, 64));
+	// What a rotatepoint in front of voronoi makes of huge bounds, wide on all three axes
+	Block rotated{"rotated", {}, {}, {}};
+	for (int i = 0; i < 4096; i++){
+		double t = -1.0e9 + i * (2.0e9 / 4095);
+		rotated.x.push_back(t * 0.8);
+		rotated.y.push_back(t * -0.6);
+		rotated.z.push_back(t * 0.5 + 0.25);
+	}
+	blocks.push_back(rotated);
+
+	int failures = 0;
+	for (auto& block : blocks){
+		for (double frequency : {1.0, 0.37}){
+			for (bool enableDistance : {false, true}){
+				auto voronoi = noise::module::Voronoi();
+				voronoi.SetFrequency(frequency);
+				voronoi.SetDisplacement(1.0);
+				voronoi.SetSeed(17);
+				voronoi.EnableDistance(enableDistance);
+
+				size_t count = block.x.size();
+				std::vector<double> out(count);
+				NoiseLang::Kernels::Voronoi(block.x.data(), block.y.data(), block.z.data(), out.data(), count, frequency, 1.0, enableDistance, 17);
+
+				size_t mismatches = 0;
+				for (size_t i = 0; i < count; i++){
+					double expected = voronoi.GetValue(block.x[i], block.y[i], block.z[i]);
+					if (out[i] != expected && !(std::isnan(out[i]) && std::isnan(expected))){
+						if (mismatches == 0)
+							std::cerr << block.name << " at (" << block.x[i] << ", " << block.y[i] << ", " << block.z[i] << ") is " << out[i] << ", libnoise says " << expected << std::endl;
+						mismatches++;
+					}
+				}
+
+				std::cout << block.name << " frequency " << frequency << (enableDistance ? " with distance" : "") << ": "
+					<< (mismatches == 0 ? "matches" : std::to_string(mismatches) + " of " + std::to_string(count) + " samples differ  FAIL") << std::endl;
+				failures += mismatches > 0 ? 1 : 0;
+			}
+		}
+	}
+
+	std::cout << (failures == 0 ? "every block matches libnoise" : "blocks differing from libnoise") << std::endl;
+	return failures == 0 ? 0 : 1;
+}